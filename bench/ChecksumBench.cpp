@@ -0,0 +1,89 @@
+// Cost of the per-chunk checksum of "get": CryptHelper::createHash (CryptoAPI on Windows),
+// single and multi-buffer SHA-256, CRC32C and XXH3.
+//
+//   checksumbench [chunk bytes] [chunks]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "ChecksumHelper.h"
+#include "CryptHelper.h"
+#include "HashHelper.h"
+
+namespace {
+    template <typename F>
+    double measure(const size_t bytes, F&& f) {
+        const auto start = std::chrono::steady_clock::now();
+        f();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        return static_cast<double>(bytes) / elapsed.count() / 1e9;
+    }
+}
+
+int main(const int argc, char* argv[]) {
+    const size_t chunkSize = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 512;
+    const size_t chunkCount = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max<size_t>((size_t{256} << 20) / std::max<size_t>(chunkSize, 1), 8);
+    const size_t totalBytes = chunkSize * chunkCount;
+
+    std::vector<std::vector<BYTE>> chunks(chunkCount, std::vector<BYTE>(chunkSize));
+    std::mt19937 gen(42);
+    for (auto& chunk : chunks)
+        for (BYTE& b : chunk)
+            b = static_cast<BYTE>(gen());
+
+    std::vector<std::vector<BYTE>> digests(chunkCount);
+    CryptHelper cryptHelper;
+    size_t sink = 0;
+
+    printf("%zu chunks of %zu bytes, GB/s\n", chunkCount, chunkSize);
+
+    const double crypt = measure(totalBytes, [&] {
+        for (size_t i = 0; i < chunkCount; ++i)
+            digests[i] = cryptHelper.createHash(chunks[i]);
+    });
+    printf("%-20s %8.3f\n", "createHash", crypt);
+    const auto reference = digests;
+
+    const double single = measure(totalBytes, [&] {
+        for (size_t i = 0; i < chunkCount; ++i)
+            digests[i] = HashHelper::sha256(chunks[i].data(), chunks[i].size());
+    });
+    printf("%-20s %8.3f\n", "sha256", single);
+
+    const double many = measure(totalBytes, [&] {
+        const BYTE* data[HashHelper::SHA256_LANES];
+        size_t sizes[HashHelper::SHA256_LANES];
+        for (size_t i = 0; i < chunkCount; i += HashHelper::SHA256_LANES) {
+            const size_t count = std::min(HashHelper::SHA256_LANES, chunkCount - i);
+            for (size_t lane = 0; lane < count; ++lane) {
+                data[lane] = chunks[i + lane].data();
+                sizes[lane] = chunks[i + lane].size();
+            }
+            HashHelper::sha256Many(data, sizes, count, digests.data() + i);
+        }
+    });
+    printf("%-20s %8.3f\n", "sha256 multi-buffer", many);
+
+    if (digests != reference) {
+        printf("multi-buffer SHA-256 differs from createHash\n");
+        return 1;
+    }
+
+    const double crc = measure(totalBytes, [&] {
+        for (const auto& chunk : chunks)
+            sink += HashHelper::crc32c(chunk.data(), chunk.size());
+    });
+    printf("%-20s %8.3f\n", "crc32c", crc);
+
+    const double xxh = measure(totalBytes, [&] {
+        for (const auto& chunk : chunks)
+            sink += HashHelper::xxh3(chunk.data(), chunk.size());
+    });
+    printf("%-20s %8.3f\n", "xxh3", xxh);
+
+    return sink == 0;
+}
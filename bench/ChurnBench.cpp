@@ -0,0 +1,131 @@
+// Connection churn against a running server: every connection asks for a file or a batch of
+// listings and is reset, after reading a little of the answer or none of it, while its
+// responses are still being produced and sent. The server must keep answering afterwards.
+//
+//   churnbench [port] [file] [connections per thread] [threads]
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "PlatformHelper.h"
+
+namespace {
+    const std::string UUID = "0123456789abcdef0123456789abcdef";
+
+    std::string request(const std::string& id, const std::string& argument) {
+        return "START_PACKET\nID: " + id + "\nUUID: " + UUID + "\nARGUMENT: " + argument + "\nEND_PACKET";
+    }
+
+    SOCKET connectTo(const unsigned short port) {
+        const SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (s == INVALID_SOCKET)
+            return s;
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+        if (connect(s, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR) {
+            closesocket(s);
+            return INVALID_SOCKET;
+        }
+        return s;
+    }
+
+    bool sendAll(const SOCKET s, const std::string& data) {
+        for (size_t sent = 0; sent < data.size();) {
+            const int result = send(s, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+            if (result <= 0)
+                return false;
+            sent += static_cast<size_t>(result);
+        }
+        return true;
+    }
+
+    // Close with an RST rather than a FIN, so that the server sees the connection fail mid-send
+    void reset(const SOCKET s) {
+        linger option{};
+        option.l_onoff = 1;
+        option.l_linger = 0;
+        setsockopt(s, SOL_SOCKET, SO_LINGER, reinterpret_cast<const char*>(&option), sizeof(option));
+        closesocket(s);
+    }
+
+    // Whether a fresh connection still gets a whole listing back
+    bool answers(const unsigned short port) {
+        const SOCKET s = connectTo(port);
+        if (s == INVALID_SOCKET)
+            return false;
+
+        std::string received;
+        bool complete = sendAll(s, request("list", ""));
+        char buffer[4096];
+        while (complete && received.find("END_PACKET") == std::string::npos) {
+            const int result = recv(s, buffer, sizeof(buffer), 0);
+            complete = result > 0;
+            if (complete)
+                received.append(buffer, static_cast<size_t>(result));
+        }
+        closesocket(s);
+        return complete;
+    }
+}
+
+int main(const int argc, char* argv[]) {
+    const auto port = static_cast<unsigned short>(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 8080);
+    const std::string file = argc > 2 ? argv[2] : "a.bin";
+    const size_t connections = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 500;
+    const size_t threadCount = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 4;
+
+    if (!PlatformHelper::initSockets())
+        return 1;
+
+    // Responses that take several turns to send: a whole file, and a pipeline of listings
+    std::string listings;
+    for (int i = 0; i < 50; ++i)
+        listings += request("list", "");
+    const std::string requests[] = { request("get", file), listings, request("get", file) + request("list", "") };
+
+    std::atomic<size_t> failedConnects{0};
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t] {
+            std::mt19937 gen(static_cast<unsigned>(t));
+            std::vector<char> buffer(64 * 1024);
+
+            for (size_t i = 0; i < connections; ++i) {
+                const SOCKET s = connectTo(port);
+                if (s == INVALID_SOCKET) {
+                    ++failedConnects;
+                    continue;
+                }
+
+                sendAll(s, requests[(i + t) % std::size(requests)]);
+
+                // Half of them read part of the answer first, so the reset lands during a later turn
+                if (gen() % 2 == 0)
+                    recv(s, buffer.data(), static_cast<int>(1 + gen() % buffer.size()), 0);
+
+                reset(s);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const bool ok = answers(port);
+    printf("%zu connections reset in %.2f s, %zu failed to connect, server %s\n", connections * threadCount, elapsed.count(),
+           failedConnects.load(), ok ? "still answers" : "does NOT answer");
+
+    PlatformHelper::cleanupSockets();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+// Throughput of the text protocol hex codec: the original stringstream implementation
+// against every HexHelper kernel the CPU supports.
+//
+//   bench [payload bytes] [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "HexHelper.h"
+
+namespace {
+    // Implementation before HexHelper, kept as the baseline
+    std::string legacyEncode(const std::vector<BYTE>& bytes) {
+        std::stringstream ss;
+
+        ss << "[ ";
+        for (const BYTE b : bytes)
+            ss << "0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(b) << " ";
+        ss << "]";
+
+        return ss.str();
+    }
+
+    std::vector<BYTE> legacyDecode(const std::string& hexStr) {
+        std::vector<BYTE> bytes;
+        std::istringstream iss(hexStr);
+        std::string token;
+        iss.ignore(2);
+
+        while (iss >> token) {
+            if (!token.empty() && token.back() == ']') token.pop_back();
+            if (token.size() < 2 || token.substr(0, 2) != "0x") continue;
+
+            unsigned int byteValue;
+            std::stringstream converter;
+            converter << std::hex << token.substr(2);
+            converter >> byteValue;
+            bytes.push_back(static_cast<BYTE>(byteValue));
+        }
+
+        return bytes;
+    }
+
+    template <typename F>
+    double measure(const size_t bytes, const size_t iterations, F&& f) {
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; ++i)
+            f();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        return static_cast<double>(bytes) * iterations / elapsed.count() / 1e9;
+    }
+}
+
+int main(const int argc, char* argv[]) {
+    const size_t size = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 512;
+    const size_t iterations = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : std::max<size_t>((size_t{1} << 30) / std::max<size_t>(size, 1), 1);
+
+    std::vector<BYTE> payload(size);
+    std::mt19937 gen(42);
+    for (BYTE& b : payload)
+        b = static_cast<BYTE>(gen());
+
+    const std::string reference = legacyEncode(payload);
+    const size_t legacyIterations = std::max<size_t>(iterations / 50, 1);
+    size_t sink = 0;
+
+    printf("payload %zu bytes, %zu iterations (legacy %zu), GB/s of raw bytes\n", size, iterations, legacyIterations);
+    printf("%-8s %10s %10s\n", "codec", "encode", "decode");
+
+    const double legacyEnc = measure(size, legacyIterations, [&] { sink += legacyEncode(payload).size(); });
+    const double legacyDec = measure(size, legacyIterations, [&] { sink += legacyDecode(reference).size(); });
+    printf("%-8s %10.3f %10.3f\n", "legacy", legacyEnc, legacyDec);
+
+    for (const auto isa : { HexHelper::Isa::Scalar, HexHelper::Isa::Ssse3, HexHelper::Isa::Avx2 }) {
+        if (!HexHelper::isSupported(isa))
+            continue;
+
+        if (HexHelper::encode(payload.data(), payload.size(), isa) != reference ||
+            HexHelper::decode(reference, isa) != payload) {
+            printf("%-8s output differs from the legacy codec\n", HexHelper::isaName(isa));
+            return 1;
+        }
+
+        const double enc = measure(size, iterations, [&] { sink += HexHelper::encode(payload.data(), payload.size(), isa).size(); });
+        const double dec = measure(size, iterations, [&] { sink += HexHelper::decode(reference, isa).size(); });
+        printf("%-8s %10.3f %10.3f\n", HexHelper::isaName(isa), enc, dec);
+    }
+
+    return sink == 0;
+}
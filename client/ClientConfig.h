@@ -1,6 +1,12 @@
 #ifndef CLIENTCONFIG_H
 #define CLIENTCONFIG_H
 
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "ChecksumHelper.h"
+#include "CompressionHelper.h"
 #include "ConfigHelper.h"
 #include "FileHelper.h"
 
@@ -10,6 +16,12 @@ public:
     std::string serverIp;
     unsigned short serverPort;
     std::string filesDir;
+    size_t chunkSize;                // Requested bytes per "get" packet, 0 leaves it to the server
+    ChecksumHelper::Algorithm checksumAlgorithm; // Requested packet checksum, None leaves it to the server
+    CompressionHelper::Codec compression; // Codec "get" answers may come compressed with, None for raw file data
+    size_t connections;              // Connections a large "get" is split over, 1 disables splitting
+    uint64_t parallelMinSize;        // Files up to this size are fetched with a single request
+    bool resume;                     // Continue downloads from what an earlier attempt left on disk
 
     ClientConfig(ConfigHelper& config) {
         this->serverIp = config.readIni("Server", "ip");
@@ -19,6 +31,13 @@ public:
 
         this->filesDir = config.readIni("Files", "dir");
         FileHelper::createAllSubdirectories(filesDir);
+
+        this->chunkSize = std::stoull(config.readIni("Transfer", "chunk_size", "0"));
+        this->checksumAlgorithm = ChecksumHelper::fromName(config.readIni("Transfer", "checksum", ""));
+        this->compression = CompressionHelper::fromName(config.readIni("Transfer", "compression", ""));
+        this->connections = std::max<size_t>(std::stoull(config.readIni("Transfer", "connections", "1")), 1);
+        this->parallelMinSize = std::max<uint64_t>(std::stoull(config.readIni("Transfer", "parallel_min_size", "16777216")), 1);
+        this->resume = config.readIni("Transfer", "resume", "true") == "true";
     }
 
     std::string toString() const {
@@ -26,6 +45,11 @@ public:
         result += "serverIp: " + std::string(serverIp) + "\n";
         result += "serverPort: " + std::to_string(serverPort) + "\n";
         result += "filesDir: " + filesDir + "\n";
+        result += "chunkSize: " + (chunkSize ? std::to_string(chunkSize) : std::string("server default")) + "\n";
+        result += "checksum: " + std::string(checksumAlgorithm == ChecksumHelper::Algorithm::None ? "server default" : ChecksumHelper::name(checksumAlgorithm)) + "\n";
+        result += "compression: " + std::string(CompressionHelper::name(compression)) + "\n";
+        result += "connections: " + std::to_string(connections) + (connections > 1 ? " (files over " + std::to_string(parallelMinSize) + " bytes)" : "") + "\n";
+        result += "resume: " + std::string(resume ? "true" : "false") + "\n";
         return result;
     }
 };
@@ -3,27 +3,32 @@
 
 #include <winsock2.h>
 #include <windows.h>
+#include <iostream>
 #include <string>
+#include <string_view>
 #include <queue>
 #include <vector>
 #include <ws2tcpip.h>
 
+#include "FrameDecoder.h"
+#include "PacketHelper.h"
+
 class ClientRunner {
 private:
     SOCKET m_socket;
     std::queue<std::string> m_pendingCommands;
-    std::vector<std::string> m_receivedResponses;
+    std::string m_sendBuffer; // Commands being sent; all pending ones go out together
+    std::vector<std::string_view> m_receivedResponses; // Packets in m_decoder's buffer
     bool m_isConnected;
 
-    // Buffer for accumulating received data
-    std::string m_receiveBuffer;
-
-    // Constants for packet markers
-    const std::string START_MARKER = "START_PACKET";
-    const std::string END_MARKER = "END_PACKET";
+    // Received bytes, split into packets in place
+    FrameDecoder m_decoder;
 
 public:
-    ClientRunner() : m_socket(INVALID_SOCKET), m_isConnected(false) {
+    static constexpr size_t RECEIVE_SIZE = 256 * 1024;           // Bytes asked for per recv
+    static constexpr size_t MAX_RESPONSE_SIZE = 64 * 1024 * 1024; // Larger packets close the connection
+
+    ClientRunner() : m_socket(INVALID_SOCKET), m_isConnected(false), m_decoder(MAX_RESPONSE_SIZE) {
         // Initialize Winsock
         WSADATA wsaData;
         WSAStartup(MAKEWORD(2, 2), &wsaData);
@@ -74,8 +79,10 @@ public:
         }
 
         m_isConnected = false;
+        m_sendBuffer.clear();
         // Clear the receive buffer when disconnecting
-        m_receiveBuffer.clear();
+        m_receivedResponses.clear();
+        m_decoder.reset();
         WSACleanup();
     }
 
@@ -95,7 +102,7 @@ public:
         FD_SET(m_socket, &readSet);
 
         // Only add to write set if we have commands to send
-        if (!m_pendingCommands.empty()) {
+        if (!m_pendingCommands.empty() || !m_sendBuffer.empty()) {
             FD_SET(m_socket, &writeSet);
         }
 
@@ -105,8 +112,8 @@ public:
 
         if (ready > 0) {
             // Process outgoing commands
-            if (FD_ISSET(m_socket, &writeSet) && !m_pendingCommands.empty()) {
-                sendNextCommand();
+            if (FD_ISSET(m_socket, &writeSet)) {
+                sendPendingCommands();
             }
 
             // Process incoming responses
@@ -116,8 +123,9 @@ public:
         }
     }
 
-    // Get any responses that have been received
-    const std::vector<std::string>& getResponses() {
+    // Get any responses that have been received; they point into the receive buffer and
+    // stay valid until the next update()
+    const std::vector<std::string_view>& getResponses() {
         return m_receivedResponses;
     }
 
@@ -127,13 +135,18 @@ public:
     }
 
 private:
-    void sendNextCommand() {
-        const std::string cmd = m_pendingCommands.front();
-        const int result = send(m_socket, cmd.c_str(), cmd.length(), 0);
+    // The server handles pipelined requests, so there is no need to wait for one answer before the next request
+    void sendPendingCommands() {
+        while (!m_pendingCommands.empty()) {
+            m_sendBuffer += m_pendingCommands.front();
+            m_pendingCommands.pop();
+        }
+
+        const int result = send(m_socket, m_sendBuffer.data(), static_cast<int>(m_sendBuffer.size()), 0);
 
         if (result != SOCKET_ERROR) {
-            // Command sent successfully
-            m_pendingCommands.pop();
+            // Keep whatever did not fit for the next round
+            m_sendBuffer.erase(0, result);
         } else if (WSAGetLastError() != WSAEWOULDBLOCK) {
             // An error occurred
             disconnect();
@@ -141,61 +154,26 @@ private:
     }
 
     void receiveResponses() {
-        char buffer[4096];
-        const int bytesReceived = recv(m_socket, buffer, sizeof(buffer) - 1, 0);
+        // Receive straight into the decoder's buffer; the views of the last update are done with
+        m_receivedResponses.clear();
+        char* buffer = m_decoder.prepare(RECEIVE_SIZE);
+        const int bytesReceived = recv(m_socket, buffer, static_cast<int>(RECEIVE_SIZE), 0);
 
         if (bytesReceived > 0) {
-            // Append new data to existing buffer
-            buffer[bytesReceived] = '\0';
-            m_receiveBuffer.append(buffer, bytesReceived);
+            m_decoder.commit(bytesReceived);
 
-            // Process all complete packets in the buffer
-            processBuffer();
-        } else if (bytesReceived == 0 || WSAGetLastError() != WSAEWOULDBLOCK) {
-            // Connection closed or error
-            disconnect();
-        }
-    }
-
-    void processBuffer() {
-        // Process and extract all complete packets from the buffer
-        size_t startPos = 0;
-
-        // Continue as long as we can find a start marker in the remaining buffer
-        while ((startPos = m_receiveBuffer.find(START_MARKER, startPos)) != std::string::npos) {
-            // Look for an end marker after this start marker
-            size_t endPos = m_receiveBuffer.find(END_MARKER, startPos);
-
-            // If we found a complete packet
-            if (endPos != std::string::npos) {
-                // Extract the complete packet (including END_MARKER which is 10 chars long)
-                std::string packet = m_receiveBuffer.substr(
-                    startPos,
-                    endPos - startPos + END_MARKER.length()
-                );
-
-                // Add to our received responses
+            // Hand out all complete packets in the buffer
+            std::string_view packet;
+            while (m_decoder.next(packet))
                 m_receivedResponses.push_back(packet);
 
-                // Move start position to just after this packet
-                startPos = endPos + END_MARKER.length();
-            } else {
-                // We found a start but no end - this is a partial packet
-                // Leave it in the buffer and exit the loop to wait for more data
-                break;
+            if (m_decoder.failed()) {
+                std::cout << "Received a packet larger than " << MAX_RESPONSE_SIZE << " bytes, disconnecting" << std::endl;
+                disconnect();
             }
-        }
-
-        // Remove all processed data from the buffer
-        // If startPos is 0, no complete packets were found, so keep everything
-        // If startPos > 0, we've processed up to startPos, so remove that portion
-        if (startPos > 0) {
-            m_receiveBuffer.erase(0, startPos);
-        }
-
-        constexpr size_t MAX_BUFFER_SIZE = 10 * 1024 * 1024; // 10MB max buffer
-        if (m_receiveBuffer.size() > MAX_BUFFER_SIZE) {
-            m_receiveBuffer.clear();
+        } else if (bytesReceived == 0 || WSAGetLastError() != WSAEWOULDBLOCK) {
+            // Connection closed or error
+            disconnect();
         }
     }
 };
@@ -0,0 +1,367 @@
+#ifndef DOWNLOADSINK_H
+#define DOWNLOADSINK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ChecksumHelper.h"
+#include "FileHelper.h"
+#include "PacketHelper.h"
+
+// Files being received by "get". Each download keeps its file open, preallocated to the
+// size the server announced, and every chunk is written at the offset its packet names,
+// so chunks may arrive in any order and from several range requests of the same file.
+// The byte ranges written so far are kept, and saved now and then to a journal next to
+// the file; a download is complete once all of the file's bytes have been written. Chunks
+// that fail their checksum are not written, so they stay missing until fetched again.
+//
+// A download that was interrupted is resumed from what is on disk: the ranges its journal
+// names (or, without a journal, the whole existing file) are checked chunk by chunk against
+// the checksums of a "sums" answer, and only the chunks that do not match are fetched again.
+class DownloadSink {
+public:
+    enum class Progress {
+        InProgress,
+        Complete,
+        Failed,
+        NotFound, // The server has no such file; nothing on disk was touched
+        Damaged   // A transfer ended with chunks that failed their checksum; a resume gets them again
+    };
+
+    // Next to the file being downloaded; removed once the download is complete
+    static constexpr const char* JOURNAL_SUFFIX = ".download";
+    static constexpr const char* JOURNAL_HEADER = "WCS download 1";
+
+    // Bytes written between journal updates
+    static constexpr uint64_t JOURNAL_INTERVAL = 16 * 1024 * 1024;
+
+    explicit DownloadSink(std::string filesDir) : m_filesDir(std::move(filesDir)) {}
+
+    // Whether an earlier download of the file left data behind that a "get" could continue from
+    bool canResume(const std::string& fileName) const {
+        if (m_downloads.contains(fileName))
+            return false;
+
+        std::error_code ec;
+        if (std::filesystem::exists(journalPath(fileName), ec))
+            return true;
+
+        const auto size = std::filesystem::file_size(filePath(fileName), ec);
+        return !ec && size > 0;
+    }
+
+    // Opens the file of an interrupted download; its data is checked by the "sums" packets passed to verify()
+    bool beginResume(const std::string& fileName) {
+        auto file = std::make_unique<FileHelper::WritableFile>(filePath(fileName), false);
+        if (!file->isOpen())
+            return false;
+
+        Download download{std::move(file)};
+        download.verifying = true;
+
+        // The journal tells which bytes were written; a file without one may be a complete earlier download
+        const uint64_t size = download.file->size();
+        if (!loadJournal(fileName, size, download.candidates) && size > 0)
+            download.candidates.emplace(0, size);
+
+        m_downloads.insert_or_assign(fileName, std::move(download));
+        return true;
+    }
+
+    // Checks the data on disk against the chunk checksums of a "sums" packet. Once the last one has been
+    // checked, returns Complete with the ranges still to get in `missing`; none means the file is complete.
+    Progress verify(const PacketHelper::ServerPacket& packet, std::vector<PacketHelper::Range>& missing) {
+        missing.clear();
+        const auto& fileName = packet.getArgument();
+        const auto it = m_downloads.find(fileName);
+        if (it == m_downloads.end() || !it->second.verifying)
+            return Progress::Failed;
+
+        // Only a file the server has may size the local one; the data on disk stays for a later resume
+        if (packet.isNotFound()) {
+            fail(it);
+            return Progress::NotFound;
+        }
+
+        Download& download = it->second;
+        const auto algorithm = packet.getChecksumAlgorithm();
+        const uint64_t chunkSize = PacketHelper::sumsChunkSize(packet.getContent());
+        const size_t digestSize = ChecksumHelper::digestSize(algorithm);
+        if (chunkSize == 0 || digestSize == 0 || (packet.getContent().size() - sizeof(uint64_t)) % digestSize != 0) {
+            fail(it);
+            return Progress::Failed;
+        }
+
+        // The first packet tells the size of the file on the server, which the local one takes on
+        if (!download.sized) {
+            download.totalBytes = packet.getTotalBytes();
+            if (!download.file->preallocate(download.totalBytes)) {
+                fail(it);
+                return Progress::Failed;
+            }
+            clip(download.candidates, download.totalBytes);
+            download.sized = true;
+        }
+
+        // Chunks whose bytes were all written before are read back and hashed, several at a time
+        const BYTE* digests = packet.getContent().data() + sizeof(uint64_t);
+        const size_t count = (packet.getContent().size() - sizeof(uint64_t)) / digestSize;
+        const uint64_t offset = packet.getOffset().value_or(0);
+
+        std::vector<BYTE> buffer;
+        std::vector<size_t> pending; // Indexes of the chunks read into buffer
+        const auto checkPending = [&] {
+            std::vector<const BYTE*> data(pending.size());
+            std::vector<size_t> sizes(pending.size());
+            std::vector<std::vector<BYTE>> computed(pending.size());
+            uint64_t position = 0;
+            for (size_t i = 0; i < pending.size(); ++i) {
+                data[i] = buffer.data() + position;
+                sizes[i] = chunkLength(offset, pending[i], chunkSize, download.totalBytes);
+                position += sizes[i];
+            }
+            ChecksumHelper::computeMany(algorithm, data.data(), sizes.data(), pending.size(), computed.data());
+
+            for (size_t i = 0; i < pending.size(); ++i) {
+                if (std::equal(computed[i].begin(), computed[i].end(), digests + pending[i] * digestSize)) {
+                    const uint64_t start = offset + pending[i] * chunkSize;
+                    download.receivedBytes += addRange(download.received, start, start + sizes[i]);
+                }
+            }
+            buffer.clear();
+            pending.clear();
+        };
+
+        for (size_t i = 0; i < count; ++i) {
+            const uint64_t start = offset + i * chunkSize;
+            const size_t length = chunkLength(offset, i, chunkSize, download.totalBytes);
+            if (length == 0 || !covers(download.candidates, start, start + length))
+                continue;
+
+            const size_t position = buffer.size();
+            buffer.resize(position + length);
+            if (download.file->read(start, reinterpret_cast<char*>(buffer.data() + position), length) != length) {
+                buffer.resize(position);
+                continue;
+            }
+
+            pending.push_back(i);
+            if (pending.size() == HashHelper::SHA256_LANES)
+                checkPending();
+        }
+        checkPending();
+
+        if (packet.getPacketNumber() < packet.getAmountOfPackets())
+            return Progress::InProgress;
+
+        download.verifying = false;
+        download.candidates.clear();
+        if (download.receivedBytes >= download.totalBytes) {
+            finish(it);
+            return Progress::Complete;
+        }
+
+        uint64_t position = 0;
+        for (const auto& [start, end] : download.received) {
+            if (start > position)
+                missing.emplace_back(position, start - position);
+            position = end;
+        }
+        if (position < download.totalBytes)
+            missing.emplace_back(position, download.totalBytes - position);
+
+        saveJournal(fileName, download);
+        return Progress::Complete;
+    }
+
+    // Writes the content of a "get" packet into its file; content that failed its checksum is left out
+    Progress write(const PacketHelper::ServerPacket& packet, const bool verified) {
+        const auto& fileName = packet.getArgument();
+        auto it = m_downloads.find(fileName);
+
+        // The local file is only created (or truncated) once the server has answered with the file
+        if (packet.isNotFound()) {
+            if (it != m_downloads.end())
+                fail(it);
+            return Progress::NotFound;
+        }
+
+        if (it == m_downloads.end()) {
+            auto file = std::make_unique<FileHelper::WritableFile>(filePath(fileName), true);
+            if (!file->isOpen() || !file->preallocate(packet.getTotalBytes()))
+                return Progress::Failed;
+
+            Download download{std::move(file)};
+            download.totalBytes = packet.getTotalBytes();
+            download.sized = true;
+            it = m_downloads.emplace(fileName, std::move(download)).first;
+            saveJournal(fileName, it->second);
+        }
+
+        Download& download = it->second;
+        const auto& content = packet.getContent();
+
+        // Servers that do not send offsets send the chunks in order
+        const uint64_t offset = packet.getOffset().value_or(download.nextOffset);
+        download.nextOffset = offset + content.size();
+
+        // A damaged chunk is neither written nor counted, so that the journal leaves it to a resume
+        if (!verified) {
+            download.damaged = true;
+        } else if (!content.empty()) {
+            if (offset + content.size() > download.totalBytes ||
+                !download.file->write(offset, reinterpret_cast<const char*>(content.data()), content.size())) {
+                fail(it);
+                return Progress::Failed;
+            }
+
+            // A range written before (e.g. sent again) is not counted twice
+            download.receivedBytes += addRange(download.received, offset, offset + content.size());
+        }
+
+        if (download.receivedBytes < download.totalBytes) {
+            // The download stays open, so that the rest of the file's transfers and a later "get" still fill it in
+            if (download.damaged && packet.getPacketNumber() == packet.getAmountOfPackets()) {
+                download.damaged = false;
+                saveJournal(fileName, download);
+                return Progress::Damaged;
+            }
+            if (download.receivedBytes - download.journaledBytes >= JOURNAL_INTERVAL)
+                saveJournal(fileName, download);
+            return Progress::InProgress;
+        }
+
+        finish(it);
+        return Progress::Complete;
+    }
+
+private:
+    using Ranges = std::map<uint64_t, uint64_t>; // Start -> end, disjoint and not adjacent
+
+    struct Download {
+        std::unique_ptr<FileHelper::WritableFile> file;
+        uint64_t totalBytes = 0;
+        uint64_t receivedBytes = 0;
+        uint64_t journaledBytes = 0;      // receivedBytes when the journal was last saved
+        uint64_t nextOffset = 0;          // Where a packet without offset goes
+        Ranges received;                  // Bytes written (or found intact) so far
+        Ranges candidates;                // While verifying: bytes an earlier download may have written
+        bool sized = false;               // The file has the server's size
+        bool verifying = false;           // Waiting for "sums" packets
+        bool damaged = false;             // Chunks failed their checksum since the last report
+    };
+
+    // Adds [start, end) to the ranges; returns how many of its bytes were not in them yet
+    static uint64_t addRange(Ranges& ranges, uint64_t start, uint64_t end) {
+        uint64_t added = end - start;
+
+        auto it = ranges.upper_bound(start);
+        if (it != ranges.begin() && std::prev(it)->second >= start)
+            --it;
+
+        while (it != ranges.end() && it->first <= end) {
+            const uint64_t overlapStart = std::max(start, it->first);
+            const uint64_t overlapEnd = std::min(end, it->second);
+            if (overlapEnd > overlapStart)
+                added -= overlapEnd - overlapStart;
+
+            start = std::min(start, it->first);
+            end = std::max(end, it->second);
+            it = ranges.erase(it);
+        }
+
+        ranges.emplace(start, end);
+        return added;
+    }
+
+    static bool covers(const Ranges& ranges, const uint64_t start, const uint64_t end) {
+        auto it = ranges.upper_bound(start);
+        return it != ranges.begin() && std::prev(it)->second >= end;
+    }
+
+    static void clip(Ranges& ranges, const uint64_t size) {
+        for (auto it = ranges.begin(); it != ranges.end();) {
+            if (it->first >= size) {
+                it = ranges.erase(it);
+            } else {
+                it->second = std::min(it->second, size);
+                ++it;
+            }
+        }
+    }
+
+    static size_t chunkLength(const uint64_t firstOffset, const size_t index, const uint64_t chunkSize, const uint64_t totalBytes) {
+        const uint64_t start = firstOffset + index * chunkSize;
+        return start < totalBytes ? static_cast<size_t>(std::min(chunkSize, totalBytes - start)) : 0;
+    }
+
+    std::string filePath(const std::string& fileName) const {
+        return m_filesDir + "\\" + fileName;
+    }
+
+    std::string journalPath(const std::string& fileName) const {
+        return filePath(fileName) + JOURNAL_SUFFIX;
+    }
+
+    // Journal: the header line, the file size, then one "start end" line per written range.
+    // Written to a temporary file and renamed, so an interruption leaves the previous one intact.
+    void saveJournal(const std::string& fileName, Download& download) const {
+        const std::string path = journalPath(fileName);
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::trunc);
+            out << JOURNAL_HEADER << '\n' << download.totalBytes << '\n';
+            for (const auto& [start, end] : download.received)
+                out << start << ' ' << end << '\n';
+            if (!out)
+                return;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temporary, path, ec);
+        if (!ec)
+            download.journaledBytes = download.receivedBytes;
+    }
+
+    // Ranges of a journal written for a file of the given size; false if there is no such journal
+    bool loadJournal(const std::string& fileName, const uint64_t size, Ranges& ranges) const {
+        std::ifstream in(journalPath(fileName));
+        std::string header;
+        uint64_t totalBytes = 0;
+        if (!std::getline(in, header) || header != JOURNAL_HEADER || !(in >> totalBytes) || totalBytes != size)
+            return false;
+
+        uint64_t start, end;
+        while (in >> start >> end) {
+            if (start < end && end <= size)
+                addRange(ranges, start, end);
+        }
+        return true;
+    }
+
+    void finish(const std::unordered_map<std::string, Download>::iterator it) {
+        std::error_code ec;
+        std::filesystem::remove(journalPath(it->first), ec);
+        m_downloads.erase(it);
+    }
+
+    // The journal stays, so that a later "get" can still resume what was written
+    void fail(const std::unordered_map<std::string, Download>::iterator it) {
+        if (it->second.sized && !it->second.verifying)
+            saveJournal(it->first, it->second);
+        m_downloads.erase(it);
+    }
+
+    std::string m_filesDir;
+    std::unordered_map<std::string, Download> m_downloads; // By file name
+};
+
+#endif //DOWNLOADSINK_H
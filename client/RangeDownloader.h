@@ -0,0 +1,148 @@
+#ifndef RANGEDOWNLOADER_H
+#define RANGEDOWNLOADER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "ClientConfig.h"
+#include "ClientRunner.h"
+#include "DownloadSink.h"
+#include "PacketHelper.h"
+#include "ResponseHandler.h"
+
+// Large "get"s split into byte ranges that are fetched over several connections at once, so
+// that a download over a high-latency link is not limited to one TCP connection's window.
+// The first parallelMinSize bytes are asked for on the main connection; the first packet of
+// that answer tells the file size, and the rest of the file is then divided into one range per
+// connection. DownloadSink puts the chunks together by their offsets.
+// A file that an earlier download left behind is resumed: its chunk checksums are asked
+// for first, and only the ranges whose data is missing or wrong are fetched, spread the same way.
+class RangeDownloader {
+public:
+    // Range boundaries are multiples of this, which keeps them on the chunk boundaries the
+    // server's checksum index uses for the usual chunk sizes
+    static constexpr uint64_t RANGE_ALIGNMENT = 1024 * 1024;
+
+    RangeDownloader(ClientConfig& clientConfig, PacketHelper& packetHelper, DownloadSink& downloads, ClientRunner& mainRunner)
+        : m_clientConfig(clientConfig), m_packetHelper(packetHelper), m_downloads(downloads), m_mainRunner(mainRunner) {}
+
+    // Opens the connections besides the main one; false if one of them could not be opened
+    bool connect() {
+        for (size_t i = 1; i < m_clientConfig.connections; ++i) {
+            auto runner = std::make_unique<ClientRunner>();
+            if (!runner->connectToServer(m_clientConfig.serverIp, m_clientConfig.serverPort))
+                return false;
+            m_runners.push_back(std::move(runner));
+        }
+        return true;
+    }
+
+    void disconnect() {
+        for (const auto& runner : m_runners)
+            runner->disconnect();
+        m_runners.clear();
+    }
+
+    // Queues a "get"; with more than one connection, larger files continue in parallel ranges
+    void get(const std::string& fileName) {
+        if (m_clientConfig.resume && m_downloads.canResume(fileName) && m_downloads.beginResume(fileName)) {
+            m_mainRunner.queueCommand(m_packetHelper.client.getPacketSums(fileName));
+            return;
+        }
+
+        if (m_runners.empty()) {
+            m_mainRunner.queueCommand(m_packetHelper.client.getPacketGet(fileName));
+            return;
+        }
+
+        m_pending.insert(fileName);
+        m_mainRunner.queueCommand(m_packetHelper.client.getPacketGet(fileName, PacketHelper::Range(0, firstRangeSize())));
+    }
+
+    // To be called with every "get" packet; the first one of a pending download splits the rest of the file
+    void onPacket(const PacketHelper::ServerPacket& packet) {
+        const auto it = m_pending.find(packet.getArgument());
+        if (it == m_pending.end())
+            return;
+        m_pending.erase(it);
+
+        const uint64_t totalBytes = packet.getTotalBytes();
+        uint64_t offset = firstRangeSize();
+        if (totalBytes <= offset)
+            return;
+
+        // One range per connection, the main one included
+        const size_t connections = m_runners.size() + 1;
+        const uint64_t share = alignUp((totalBytes - offset + connections - 1) / connections);
+        for (size_t i = 0; i < connections && offset < totalBytes; ++i) {
+            const uint64_t length = std::min(share, totalBytes - offset);
+            ClientRunner& runner = i == 0 ? m_mainRunner : *m_runners[i - 1];
+            runner.queueCommand(m_packetHelper.client.getPacketGet(packet.getArgument(), PacketHelper::Range(offset, length)));
+            offset += length;
+        }
+    }
+
+    // Gets the ranges a resumed download is missing, split into about equal shares, one per connection
+    void resume(const std::string& fileName, const std::vector<PacketHelper::Range>& missing) {
+        uint64_t missingBytes = 0;
+        for (const auto& range : missing)
+            missingBytes += range.length;
+        if (missingBytes == 0)
+            return;
+
+        const size_t connections = m_runners.size() + 1;
+        const uint64_t share = alignUp((missingBytes + connections - 1) / connections);
+        size_t connection = 0;
+        uint64_t assigned = 0; // Bytes given to the current connection so far
+
+        for (const auto& range : missing) {
+            uint64_t offset = range.offset;
+            const uint64_t end = range.offset + range.length;
+            while (offset < end) {
+                const uint64_t length = std::min(end - offset, share - assigned);
+                ClientRunner& runner = connection == 0 ? m_mainRunner : *m_runners[connection - 1];
+                runner.queueCommand(m_packetHelper.client.getPacketGet(fileName, PacketHelper::Range(offset, length)));
+
+                offset += length;
+                assigned += length;
+                if (assigned == share && connection + 1 < connections) {
+                    ++connection;
+                    assigned = 0;
+                }
+            }
+        }
+    }
+
+    // Runs the I/O of the connections besides the main one and hands their responses on
+    void update(ResponseHandler& responseHandler) {
+        for (const auto& runner : m_runners) {
+            runner->update();
+            const auto& responses = runner->getResponses();
+            if (!responses.empty())
+                responseHandler.handleResponses(responses);
+            runner->clearResponses();
+        }
+    }
+
+private:
+    uint64_t firstRangeSize() const {
+        return alignUp(m_clientConfig.parallelMinSize);
+    }
+
+    static uint64_t alignUp(const uint64_t value) {
+        return (value + RANGE_ALIGNMENT - 1) / RANGE_ALIGNMENT * RANGE_ALIGNMENT;
+    }
+
+    ClientConfig& m_clientConfig;
+    PacketHelper& m_packetHelper;
+    DownloadSink& m_downloads;
+    ClientRunner& m_mainRunner;
+    std::vector<std::unique_ptr<ClientRunner>> m_runners; // Connections besides the main one
+    std::unordered_set<std::string> m_pending;            // Files whose size is not known yet
+};
+
+#endif //RANGEDOWNLOADER_H
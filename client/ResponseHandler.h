@@ -1,25 +1,45 @@
 #ifndef COMMANDHANDLER_H
 #define COMMANDHANDLER_H
 
+#include <cstdint>
+#include <functional>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 
+#include "DownloadSink.h"
 #include "PacketHelper.h"
+#include "SyncSink.h"
 
 class ResponseHandler {
 private:
     ClientConfig& clientConfig;
     PacketHelper& packageHelper;
+    DownloadSink& downloads;
+    SyncSink& syncs;
+    std::function<void(const PacketHelper::ServerPacket&)> getListener;
+    std::function<void(const std::string&, const std::vector<PacketHelper::Range>&)> resumeListener;
 
-    std::unordered_map<std::string, std::vector<std::string>> listResponseMap;
+    // Names received so far per "list", one per line
+    std::unordered_map<std::string, std::string> listResponseMap;
 
 public:
-    ResponseHandler(ClientConfig& clientConfig, PacketHelper& packageHelper)
-        : clientConfig(clientConfig), packageHelper(packageHelper) {}
+    ResponseHandler(ClientConfig& clientConfig, PacketHelper& packageHelper, DownloadSink& downloads, SyncSink& syncs)
+        : clientConfig(clientConfig), packageHelper(packageHelper), downloads(downloads), syncs(syncs) {}
 
-    void handleResponses(const std::vector<std::string> responses) {
+    // Called with every "get" packet before it is written
+    void setGetListener(std::function<void(const PacketHelper::ServerPacket&)> listener) {
+        getListener = std::move(listener);
+    }
+
+    // Called with the ranges a resumed download still needs once its data on disk has been checked
+    void setResumeListener(std::function<void(const std::string&, const std::vector<PacketHelper::Range>&)> listener) {
+        resumeListener = std::move(listener);
+    }
+
+    void handleResponses(const std::vector<std::string_view>& responses) {
         for (const auto& response : responses) {
             const auto serverPacket = packageHelper.parseServerPacket(response);
             const auto& serverPacketId = serverPacket.getId();
@@ -27,39 +47,98 @@ public:
             const auto packetNumber = serverPacket.getPacketNumber();
             const auto amountOfPackets = serverPacket.getAmountOfPackets();
 
-            // if packet id if get, write file chunk
+            const bool verified = ChecksumHelper::verify(serverPacket.getChecksumAlgorithm(), serverPacket.getContent(),
+                                                         serverPacket.getContentChecksum());
+            if (!verified)
+                std::cout << "Checksum mismatch (" << ChecksumHelper::name(serverPacket.getChecksumAlgorithm()) << ") in packet "
+                          << packetNumber << " of " << serverPacketId << " " << serverPacket.getArgument() << std::endl;
+
+            // Protocol negotiation reply: switch the request framing for this connection
+            if (serverPacketId == "hello") {
+                const bool binary = serverPacket.getArgument() == PacketHelper::PROTOCOL_BINARY;
+                packageHelper.client.setProtocol(binary ? PacketHelper::Protocol::Binary : PacketHelper::Protocol::Text);
+                std::cout << "Using " << (binary ? "binary" : "text") << " protocol" << '\n' << std::endl;
+                continue;
+            }
+
+            // if packet id if get, write file chunk where it belongs
             if (serverPacketId == "get") {
+                if (getListener)
+                    getListener(serverPacket);
+
                 const auto& fileName = serverPacket.getArgument();
-                const auto& filePath = clientConfig.filesDir + "\\" + fileName;
+                const auto progress = downloads.write(serverPacket, verified);
+                if (progress == DownloadSink::Progress::Complete)
+                    std::cout << "File: " << fileName << " has been saved." << '\n' << std::endl;
+                else if (progress == DownloadSink::Progress::Failed)
+                    std::cout << "Failed to write file: " << fileName << '\n' << std::endl;
+                else if (progress == DownloadSink::Progress::NotFound)
+                    std::cout << "File: " << fileName << " was not found on the server." << '\n' << std::endl;
+                else if (progress == DownloadSink::Progress::Damaged)
+                    std::cout << "File: " << fileName << " has chunks that failed their checksum, get it again to fetch them" << '\n' << std::endl;
+                continue;
+            }
 
-                const auto& content = serverPacket.getContent();
-                std::ofstream file(filePath, std::ios::app | std::ios::binary);
+            // Delta of a changed file: rebuild it from the local copy
+            if (serverPacketId == "sync") {
+                const auto& fileName = serverPacket.getArgument();
+                uint64_t receivedBytes = 0;
+                const auto progress = syncs.apply(serverPacket, receivedBytes);
+                if (progress == SyncSink::Progress::Complete)
+                    std::cout << "File: " << fileName << " has been synced, " << receivedBytes << " bytes received for "
+                              << serverPacket.getTotalBytes() << '\n' << std::endl;
+                else if (progress == SyncSink::Progress::Failed)
+                    std::cout << "Failed to sync file: " << fileName << ", get it instead" << '\n' << std::endl;
+                else if (progress == SyncSink::Progress::NotFound)
+                    std::cout << "File: " << fileName << " was not found on the server." << '\n' << std::endl;
+                continue;
+            }
 
-                file.write(reinterpret_cast<const char*>(content.data()), content.size());
-                file.close();
-            } else
-                listResponseMap[uuid].push_back(response);
+            // Chunk checksums for resuming a download: check what is on disk, then get the rest
+            if (serverPacketId == "sums") {
+                const auto& fileName = serverPacket.getArgument();
+                std::vector<PacketHelper::Range> missing;
+                const auto progress = downloads.verify(serverPacket, missing);
+                if (progress == DownloadSink::Progress::Failed) {
+                    std::cout << "Failed to resume file: " << fileName << '\n' << std::endl;
+                } else if (progress == DownloadSink::Progress::NotFound) {
+                    std::cout << "File: " << fileName << " was not found on the server." << '\n' << std::endl;
+                } else if (progress == DownloadSink::Progress::Complete) {
+                    if (missing.empty()) {
+                        std::cout << "File: " << fileName << " is already complete." << '\n' << std::endl;
+                    } else {
+                        uint64_t missingBytes = 0;
+                        for (const auto& range : missing)
+                            missingBytes += range.length;
+                        std::cout << "Resuming file: " << fileName << ", " << missingBytes << " of " << serverPacket.getTotalBytes()
+                                  << " bytes left" << std::endl;
+                        if (resumeListener)
+                            resumeListener(fileName, missing);
+                    }
+                }
+                continue;
+            }
+
+            if (serverPacketId == "list") {
+                const auto& content = serverPacket.getContent();
+                listResponseMap[uuid].append(content.begin(), content.end());
+            }
 
             if (packetNumber == amountOfPackets) {
                 if (serverPacketId == "list") {
-                    std::string content;
-                    for (const auto& packet : listResponseMap[uuid]) {
-                        const auto& packetContent = packageHelper.parseServerPacket(packet).getContent();
-                        for (const auto& chunk : packetContent)
-                            content += chunk;
-                        content += '\n';
-                    }
-
+                    const auto& content = listResponseMap[uuid];
                     if (content.empty()) {
                         std::cout << "No files found" << std::endl;
                     } else {
-                        std::cout << std::string(content.begin(), content.end()) << '\n' << std::endl;
+                        std::cout << content << std::endl;
                     }
 
+                    // The server stopped at the requested limit; its argument asks for the next page
+                    if (!serverPacket.getArgument().empty())
+                        std::cout << "More files: list " << serverPacket.getArgument() << std::endl;
+                    std::cout << std::endl;
+
                     listResponseMap.erase(uuid);
-                } else if (serverPacketId == "get") {
-                    const auto& fileName = serverPacket.getArgument();
-                    std::cout << "File: " << fileName << " has been saved." << '\n' << std::endl;
                 }
             }
         }
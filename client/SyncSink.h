@@ -0,0 +1,129 @@
+#ifndef SYNCSINK_H
+#define SYNCSINK_H
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CryptHelper.h"
+#include "DeltaHelper.h"
+#include "FileHelper.h"
+#include "PacketHelper.h"
+
+// Files being updated by "sync". The request carries the signature of the local copy, and the
+// instructions of the answer rebuild the server's version into a temporary file next to it,
+// taking unchanged blocks from the local copy. The temporary file replaces the copy once its
+// SHA-256 matches the one the server computed, so a failed sync leaves the copy as it was.
+class SyncSink {
+public:
+    enum class Progress {
+        InProgress,
+        Complete,
+        Failed,
+        NotFound  // The server has no such file; the local copy stays
+    };
+
+    static constexpr const char* TEMPORARY_SUFFIX = ".sync";
+
+    SyncSink(std::string filesDir, CryptHelper& cryptHelper) : m_filesDir(std::move(filesDir)), m_cryptHelper(cryptHelper) {}
+
+    // Signature of the local copy to send with a "sync"; empty if there is no copy to build on
+    std::vector<BYTE> begin(const std::string& fileName) {
+        auto oldFile = std::make_unique<FileHelper::File>(filePath(fileName));
+        if (!oldFile->isOpen() || oldFile->size() == 0)
+            return {};
+
+        auto signature = DeltaHelper::makeSignature(m_cryptHelper, *oldFile);
+        if (signature.empty())
+            return {};
+
+        auto newFile = std::make_unique<FileHelper::WritableFile>(temporaryPath(fileName), true);
+        if (!newFile->isOpen())
+            return {};
+
+        const size_t blockSize = DeltaHelper::blockSize(oldFile->size());
+        Sync sync;
+        sync.patcher = std::make_unique<DeltaHelper::Patcher>(*oldFile, blockSize, *newFile);
+        sync.oldFile = std::move(oldFile);
+        sync.newFile = std::move(newFile);
+
+        m_syncs.erase(fileName);
+        m_syncs.emplace(fileName, std::move(sync));
+        return signature;
+    }
+
+    // Applies the instructions of a "sync" packet; once complete, `receivedBytes` tells how much the delta took
+    Progress apply(const PacketHelper::ServerPacket& packet, uint64_t& receivedBytes) {
+        const auto& fileName = packet.getArgument();
+        const auto it = m_syncs.find(fileName);
+        if (it == m_syncs.end())
+            return Progress::Failed;
+
+        // The (empty) delta of a missing file would verify and replace the copy with nothing
+        if (packet.isNotFound()) {
+            fail(it);
+            return Progress::NotFound;
+        }
+
+        Sync& sync = it->second;
+        const auto& content = packet.getContent();
+        sync.receivedBytes += content.size();
+        if (!sync.patcher->apply(content.data(), content.size())) {
+            fail(it);
+            return Progress::Failed;
+        }
+
+        if (!sync.patcher->done())
+            return Progress::InProgress;
+
+        if (!sync.patcher->verified() || sync.patcher->size() != packet.getTotalBytes()) {
+            fail(it);
+            return Progress::Failed;
+        }
+
+        // Both files are closed before the new one is renamed over the old one
+        receivedBytes = sync.receivedBytes;
+        m_syncs.erase(it);
+
+        std::error_code ec;
+        std::filesystem::rename(temporaryPath(fileName), filePath(fileName), ec);
+        if (ec) {
+            std::filesystem::remove(temporaryPath(fileName), ec);
+            return Progress::Failed;
+        }
+        return Progress::Complete;
+    }
+
+private:
+    struct Sync {
+        std::unique_ptr<FileHelper::File> oldFile;
+        std::unique_ptr<FileHelper::WritableFile> newFile;
+        std::unique_ptr<DeltaHelper::Patcher> patcher; // Refers to both files, so it is declared (and destroyed) after them
+        uint64_t receivedBytes = 0;
+    };
+
+    std::string filePath(const std::string& fileName) const {
+        return m_filesDir + "\\" + fileName;
+    }
+
+    std::string temporaryPath(const std::string& fileName) const {
+        return filePath(fileName) + TEMPORARY_SUFFIX;
+    }
+
+    void fail(const std::unordered_map<std::string, Sync>::iterator it) {
+        const std::string path = temporaryPath(it->first);
+        m_syncs.erase(it);
+
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+
+    std::string m_filesDir;
+    CryptHelper& m_cryptHelper;
+    std::unordered_map<std::string, Sync> m_syncs; // By file name
+};
+
+#endif //SYNCSINK_H
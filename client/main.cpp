@@ -5,8 +5,11 @@
 #include "ClientConfig.h"
 #include "ClientRunner.h"
 #include "ConfigHelper.h"
+#include "DownloadSink.h"
 #include "PacketHelper.h"
+#include "RangeDownloader.h"
 #include "ResponseHandler.h"
+#include "SyncSink.h"
 
 bool isKeyPressed(const int vkCode) {
     if (_kbhit()) {
@@ -25,16 +28,30 @@ int main() {
     ClientRunner clientRunner;
     CryptHelper clientCrypter;
     PacketHelper packetHelper(clientCrypter);
-    ResponseHandler responseHandler(clientConfig, packetHelper);
+    packetHelper.client.setChunkSize(clientConfig.chunkSize);
+    packetHelper.client.setChecksumAlgorithm(clientConfig.checksumAlgorithm);
+    packetHelper.client.setCompression(clientConfig.compression);
+    DownloadSink downloads(clientConfig.filesDir);
+    SyncSink syncs(clientConfig.filesDir, clientCrypter);
+    ResponseHandler responseHandler(clientConfig, packetHelper, downloads, syncs);
 
     // Connect to server
-    if (!clientRunner.connectToServer("127.0.0.1", 8080)) {
+    if (!clientRunner.connectToServer(clientConfig.serverIp, clientConfig.serverPort)) {
         std::cout << "Failed to connect to server!" << std::endl;
         return 1;
     }
 
-    // Queue multiple commands right away without waiting for responses
-    clientRunner.queueCommand("init");
+    // Additional connections for downloading large files in parallel ranges
+    RangeDownloader rangeDownloader(clientConfig, packetHelper, downloads, clientRunner);
+    if (!rangeDownloader.connect())
+        std::cout << "Failed to open all download connections, large files may be slower" << std::endl;
+    responseHandler.setGetListener([&](const PacketHelper::ServerPacket& packet) { rangeDownloader.onPacket(packet); });
+    responseHandler.setResumeListener([&](const std::string& fileName, const std::vector<PacketHelper::Range>& missing) {
+        rangeDownloader.resume(fileName, missing);
+    });
+
+    // Offer the binary protocol; until the server answers (or if it never does) requests stay text
+    clientRunner.queueCommand(packetHelper.client.getPacketHello());
 
     // Main application loop
     while (true) {
@@ -46,6 +63,7 @@ int main() {
         if (!responses.empty())
             responseHandler.handleResponses(responses);
         clientRunner.clearResponses();
+        rangeDownloader.update(responseHandler);
 
         // if user presses letter 'c', let him type command and press enter (non-blocking)
         auto isPressed = isKeyPressed('c');
@@ -61,8 +79,9 @@ int main() {
             if (userInput == "exit") break;
 
             std::string command;
-            if (userInput == "list") {
-                command = packetHelper.client.getPacketList();
+            if (userInput == "list" || userInput.find("list ") == 0) {
+                // Optional paging: list [--limit N] [--after <name>]
+                command = packetHelper.client.getPacketList(userInput.size() > 5 ? userInput.substr(5) : "");
             } else if (userInput.find("get") == 0) {
                 const auto fileName = userInput.substr(4);
                 if (fileName.empty()) {
@@ -70,7 +89,15 @@ int main() {
                     continue;
                 }
 
-                command = packetHelper.client.getPacketGet(fileName);
+                rangeDownloader.get(fileName);
+            } else if (userInput.find("sync ") == 0) {
+                // Only the changes against the local copy are transferred; without a copy this is a "get"
+                const auto fileName = userInput.substr(5);
+                const auto signature = syncs.begin(fileName);
+                if (signature.empty())
+                    rangeDownloader.get(fileName);
+                else
+                    command = packetHelper.client.getPacketSync(fileName, signature);
             }
 
             if (not command.empty())
@@ -81,6 +108,7 @@ int main() {
         Sleep(10);
     }
 
+    rangeDownloader.disconnect();
     clientRunner.disconnect();
     return 0;
 }
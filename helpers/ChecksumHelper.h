@@ -0,0 +1,96 @@
+#ifndef CHECKSUMHELPER_H
+#define CHECKSUMHELPER_H
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "HashHelper.h"
+#include "PlatformHelper.h"
+
+// Per-transfer choice of the content checksum carried by packets.
+// CRC32C and XXH3 catch transmission errors at a tiny fraction of the cost of SHA-256;
+// SHA-256 stays available (and the default) for when a cryptographic digest is wanted.
+class ChecksumHelper {
+public:
+    // Values travel on the wire, do not renumber
+    enum class Algorithm : uint8_t {
+        None = 0,   // No checksum; in requests: no preference, the server decides
+        Sha256 = 1,
+        Crc32c = 2,
+        Xxh3 = 3
+    };
+
+    static const char* name(const Algorithm algorithm) {
+        switch (algorithm) {
+            case Algorithm::Sha256: return "sha256";
+            case Algorithm::Crc32c: return "crc32c";
+            case Algorithm::Xxh3: return "xxh3";
+            default: return "none";
+        }
+    }
+
+    // Unknown names map to None
+    static Algorithm fromName(const std::string_view name) {
+        if (name == "sha256") return Algorithm::Sha256;
+        if (name == "crc32c") return Algorithm::Crc32c;
+        if (name == "xxh3") return Algorithm::Xxh3;
+        return Algorithm::None;
+    }
+
+    static Algorithm fromValue(const uint8_t value) {
+        return value <= static_cast<uint8_t>(Algorithm::Xxh3) ? static_cast<Algorithm>(value) : Algorithm::None;
+    }
+
+    static size_t digestSize(const Algorithm algorithm) {
+        switch (algorithm) {
+            case Algorithm::Sha256: return HashHelper::Sha256::DIGEST_SIZE;
+            case Algorithm::Crc32c: return 4;
+            case Algorithm::Xxh3: return 8;
+            default: return 0;
+        }
+    }
+
+    // Digests are stored big-endian, the order in which the algorithms are usually printed
+    static std::vector<BYTE> compute(const Algorithm algorithm, const BYTE* data, const size_t size) {
+        switch (algorithm) {
+            case Algorithm::Sha256:
+                return HashHelper::sha256(data, size);
+            case Algorithm::Crc32c:
+                return toBytes(HashHelper::crc32c(data, size), digestSize(algorithm));
+            case Algorithm::Xxh3:
+                return toBytes(HashHelper::xxh3(data, size), digestSize(algorithm));
+            default:
+                return {};
+        }
+    }
+
+    static std::vector<BYTE> compute(const Algorithm algorithm, const std::vector<BYTE>& data) {
+        return compute(algorithm, data.data(), data.size());
+    }
+
+    // Checksums of several buffers; SHA-256 hashes them side by side with the multi-buffer kernel
+    static void computeMany(const Algorithm algorithm, const BYTE* const* data, const size_t* sizes, const size_t count, std::vector<BYTE>* checksums) {
+        if (algorithm == Algorithm::Sha256) {
+            HashHelper::sha256Many(data, sizes, count, checksums);
+            return;
+        }
+
+        for (size_t i = 0; i < count; ++i)
+            checksums[i] = compute(algorithm, data[i], sizes[i]);
+    }
+
+    static bool verify(const Algorithm algorithm, const std::vector<BYTE>& data, const std::vector<BYTE>& expected) {
+        return algorithm == Algorithm::None || compute(algorithm, data) == expected;
+    }
+
+private:
+    static std::vector<BYTE> toBytes(const uint64_t value, const size_t size) {
+        std::vector<BYTE> bytes(size);
+        for (size_t i = 0; i < size; ++i)
+            bytes[i] = static_cast<BYTE>(value >> (8 * (size - 1 - i)));
+        return bytes;
+    }
+};
+
+#endif //CHECKSUMHELPER_H
@@ -0,0 +1,364 @@
+#ifndef COMPRESSIONHELPER_H
+#define COMPRESSIONHELPER_H
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "PlatformHelper.h"
+
+// Per-request compression of packet content. Both codecs produce LZ4 blocks, so one decoder
+// reads either: "lz4" finds matches through a single-entry hash table and skips ahead over
+// incompressible data, "lz4hc" searches hash chains and defers a match by a byte when the next
+// one is longer, trading several times the CPU for a denser stream.
+//
+// Compressed content: u32 little-endian original size | LZ4 block
+//   sequence: u8 token (literal length << 4 | match length - 4) | literal length extension |
+//             literals | u16 match offset | match length extension
+// Lengths of 15 or more continue in bytes of 255 up to the first smaller one; the last sequence
+// has literals only.
+class CompressionHelper {
+public:
+    // Values travel on the wire, do not renumber
+    enum class Codec : uint8_t {
+        None = 0,   // Content as it is; in requests: no compression
+        Lz4 = 1,
+        Lz4Hc = 2
+    };
+
+    // Larger content is not compressed, and compressed content claiming more is rejected
+    static constexpr size_t MAX_ORIGINAL_SIZE = 64 * 1024 * 1024;
+
+    static const char* name(const Codec codec) {
+        switch (codec) {
+            case Codec::Lz4: return "lz4";
+            case Codec::Lz4Hc: return "lz4hc";
+            default: return "none";
+        }
+    }
+
+    // Unknown names map to None
+    static Codec fromName(const std::string_view name) {
+        if (name == "lz4") return Codec::Lz4;
+        if (name == "lz4hc") return Codec::Lz4Hc;
+        return Codec::None;
+    }
+
+    static Codec fromValue(const uint8_t value) {
+        return value <= static_cast<uint8_t>(Codec::Lz4Hc) ? static_cast<Codec>(value) : Codec::None;
+    }
+
+    // Compressed form of the data, or empty if it would not be smaller (or the codec is None)
+    static std::vector<BYTE> compress(const Codec codec, const BYTE* data, const size_t size) {
+        if (codec == Codec::None || size == 0 || size > MAX_ORIGINAL_SIZE)
+            return {};
+
+        std::vector<BYTE> out;
+        out.reserve(SIZE_PREFIX + size + size / 255 + 16);
+        out.resize(SIZE_PREFIX);
+        writeLE32(out.data(), static_cast<uint32_t>(size));
+
+        if (codec == Codec::Lz4Hc)
+            compressHc(data, size, out);
+        else
+            compressFast(data, size, out);
+
+        if (out.size() >= size)
+            return {};
+        return out;
+    }
+
+    static std::vector<BYTE> compress(const Codec codec, const std::vector<BYTE>& data) {
+        return compress(codec, data.data(), data.size());
+    }
+
+    // Restores compressed content; false if it is malformed
+    static bool decompress(const BYTE* data, const size_t size, std::vector<BYTE>& out) {
+        if (size < SIZE_PREFIX)
+            return false;
+
+        // compress() never produces empty content, which would also leave out.data() null below
+        const uint32_t originalSize = readLE32(data);
+        if (originalSize == 0 || originalSize > MAX_ORIGINAL_SIZE)
+            return false;
+
+        out.resize(originalSize);
+        const BYTE* in = data + SIZE_PREFIX;
+        const BYTE* const end = data + size;
+        size_t position = 0;
+
+        while (true) {
+            if (in == end)
+                return false;
+            const BYTE token = *in++;
+
+            size_t literals = token >> 4;
+            if (literals == 15 && !readLength(in, end, literals))
+                return false;
+            if (literals > static_cast<size_t>(end - in) || literals > originalSize - position)
+                return false;
+
+            memcpy(out.data() + position, in, literals);
+            in += literals;
+            position += literals;
+
+            // The last sequence ends the block after its literals
+            if (in == end)
+                return position == originalSize;
+
+            if (end - in < 2)
+                return false;
+            const size_t distance = in[0] | in[1] << 8;
+            in += 2;
+            if (distance == 0 || distance > position)
+                return false;
+
+            size_t length = token & 0x0F;
+            if (length == 15 && !readLength(in, end, length))
+                return false;
+            length += MIN_MATCH;
+            if (length > originalSize - position)
+                return false;
+
+            // Matches may overlap the bytes they produce, e.g. a run of one repeated byte
+            BYTE* target = out.data() + position;
+            const BYTE* source = target - distance;
+            if (distance >= length) {
+                memcpy(target, source, length);
+            } else {
+                for (size_t i = 0; i < length; ++i)
+                    target[i] = source[i];
+            }
+            position += length;
+        }
+    }
+
+    static bool decompress(const std::vector<BYTE>& data, std::vector<BYTE>& out) {
+        return decompress(data.data(), data.size(), out);
+    }
+
+private:
+    static constexpr size_t SIZE_PREFIX = sizeof(uint32_t);
+    static constexpr size_t MIN_MATCH = 4;
+    static constexpr size_t LAST_LITERALS = 5;  // The block ends with at least this many literals
+    static constexpr size_t MATCH_START_LIMIT = 12; // No match starts this close to the end
+    static constexpr size_t MAX_DISTANCE = 65535;
+
+    static constexpr unsigned FAST_HASH_BITS = 14;
+    static constexpr unsigned HC_HASH_BITS = 15;
+    static constexpr size_t HC_WINDOW_MASK = 65535;
+    static constexpr unsigned HC_MAX_ATTEMPTS = 64;
+
+    struct Match {
+        size_t distance = 0;
+        size_t length = 0;
+    };
+
+    static void writeLE32(BYTE* out, const uint32_t value) {
+        for (size_t i = 0; i < 4; ++i)
+            out[i] = static_cast<BYTE>(value >> (8 * i));
+    }
+
+    static uint32_t readLE32(const BYTE* in) {
+        return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 |
+               static_cast<uint32_t>(in[2]) << 16 | static_cast<uint32_t>(in[3]) << 24;
+    }
+
+    static uint32_t read32(const BYTE* in) {
+        uint32_t value;
+        memcpy(&value, in, sizeof(value));
+        return value;
+    }
+
+    static uint32_t hash(const BYTE* in, const unsigned bits) {
+        return (read32(in) * 2654435761u) >> (32 - bits);
+    }
+
+    // Adds the bytes continuing a length of 15; false if the input ends first
+    static bool readLength(const BYTE*& in, const BYTE* const end, size_t& length) {
+        BYTE byte;
+        do {
+            if (in == end)
+                return false;
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+
+    static void writeLength(std::vector<BYTE>& out, size_t length) {
+        for (; length >= 255; length -= 255)
+            out.push_back(255);
+        out.push_back(static_cast<BYTE>(length));
+    }
+
+    // One sequence: the literals from `literals`, then (unless it is the last one) a match
+    static void writeSequence(std::vector<BYTE>& out, const BYTE* literals, const size_t literalLength, const Match& match) {
+        const size_t token = out.size();
+        out.push_back(static_cast<BYTE>(std::min<size_t>(literalLength, 15) << 4));
+        if (literalLength >= 15)
+            writeLength(out, literalLength - 15);
+        out.insert(out.end(), literals, literals + literalLength);
+
+        if (match.length == 0)
+            return;
+
+        out.push_back(static_cast<BYTE>(match.distance & 0xff));
+        out.push_back(static_cast<BYTE>(match.distance >> 8));
+        const size_t length = match.length - MIN_MATCH;
+        out[token] |= static_cast<BYTE>(std::min<size_t>(length, 15));
+        if (length >= 15)
+            writeLength(out, length - 15);
+    }
+
+    // Length of the common prefix of two positions, up to `limit` bytes from `current`
+    static size_t matchLength(const BYTE* candidate, const BYTE* current, const BYTE* limit) {
+        const BYTE* start = current;
+        while (current + sizeof(uint64_t) <= limit) {
+            uint64_t a, b;
+            memcpy(&a, candidate, sizeof(a));
+            memcpy(&b, current, sizeof(b));
+            if (a != b)
+                return current - start + std::countr_zero(a ^ b) / 8;
+            candidate += sizeof(uint64_t);
+            current += sizeof(uint64_t);
+        }
+        while (current < limit && *candidate == *current) {
+            ++candidate;
+            ++current;
+        }
+        return current - start;
+    }
+
+    static void compressFast(const BYTE* data, const size_t size, std::vector<BYTE>& out) {
+        size_t anchor = 0;
+        if (size > MATCH_START_LIMIT) {
+            std::vector<uint32_t> table(size_t{1} << FAST_HASH_BITS, UINT32_MAX);
+            const size_t searchEnd = size - MATCH_START_LIMIT;
+            const BYTE* const matchEnd = data + size - LAST_LITERALS;
+
+            size_t position = 0;
+            while (position < searchEnd) {
+                const uint32_t h = hash(data + position, FAST_HASH_BITS);
+                const size_t candidate = table[h];
+                table[h] = static_cast<uint32_t>(position);
+
+                if (candidate == UINT32_MAX || position - candidate > MAX_DISTANCE ||
+                    read32(data + candidate) != read32(data + position)) {
+                    // The longer nothing matches, the bigger the steps
+                    position += 1 + ((position - anchor) >> 6);
+                    continue;
+                }
+
+                Match match{position - candidate, MIN_MATCH + matchLength(data + candidate + MIN_MATCH, data + position + MIN_MATCH, matchEnd)};
+
+                // Bytes before the match may belong to it as well
+                size_t start = position;
+                for (size_t from = candidate; start > anchor && from > 0 && data[start - 1] == data[from - 1]; --start, --from)
+                    ++match.length;
+
+                writeSequence(out, data + anchor, start - anchor, match);
+                position = start + match.length;
+                anchor = position;
+                if (position - 2 < searchEnd)
+                    table[hash(data + position - 2, FAST_HASH_BITS)] = static_cast<uint32_t>(position - 2);
+            }
+        }
+        writeSequence(out, data + anchor, size - anchor, Match{});
+    }
+
+    // Hash chains: `head` holds the latest position of each hash, `chain` the distance from
+    // a position back to the previous one with the same hash (0 when there is none in the window)
+    class HashChains {
+    public:
+        explicit HashChains(const BYTE* data) : m_data(data), m_head(size_t{1} << HC_HASH_BITS, UINT32_MAX), m_chain(HC_WINDOW_MASK + 1) {}
+
+        // Adds all positions up to and including `position`
+        void insert(const size_t position) {
+            for (; m_next <= position; ++m_next) {
+                uint32_t& head = m_head[hash(m_data + m_next, HC_HASH_BITS)];
+                const size_t distance = head == UINT32_MAX ? 0 : m_next - head;
+                m_chain[m_next & HC_WINDOW_MASK] = static_cast<uint16_t>(distance > MAX_DISTANCE ? 0 : distance);
+                head = static_cast<uint32_t>(m_next);
+            }
+        }
+
+        // Longest earlier match of the (inserted) position, ending by `limit`
+        Match find(const size_t position, const BYTE* limit) const {
+            Match best;
+            const BYTE* current = m_data + position;
+            size_t candidate = position;
+            for (unsigned attempts = 0; attempts < HC_MAX_ATTEMPTS; ++attempts) {
+                const size_t distance = m_chain[candidate & HC_WINDOW_MASK];
+                if (distance == 0 || position - (candidate - distance) > MAX_DISTANCE)
+                    break;
+                candidate -= distance;
+
+                // A longer match must at least differ from the best one in its next byte
+                const BYTE* earlier = m_data + candidate;
+                if (earlier[best.length] != current[best.length] || read32(earlier) != read32(current))
+                    continue;
+
+                const size_t length = MIN_MATCH + matchLength(earlier + MIN_MATCH, current + MIN_MATCH, limit);
+                if (length > best.length) {
+                    best = {position - candidate, length};
+                    if (current + length == limit)
+                        break;
+                }
+            }
+            return best;
+        }
+
+    private:
+        const BYTE* m_data;
+        std::vector<uint32_t> m_head;
+        std::vector<uint16_t> m_chain;
+        size_t m_next = 0;
+    };
+
+    static void compressHc(const BYTE* data, const size_t size, std::vector<BYTE>& out) {
+        size_t anchor = 0;
+        if (size > MATCH_START_LIMIT) {
+            HashChains chains(data);
+            const size_t searchEnd = size - MATCH_START_LIMIT;
+            const BYTE* const matchEnd = data + size - LAST_LITERALS;
+
+            size_t position = 0;
+            Match match;
+            while (position < searchEnd) {
+                if (match.length == 0) {
+                    chains.insert(position);
+                    match = chains.find(position, matchEnd);
+                    if (match.length < MIN_MATCH) {
+                        // Skips ahead over incompressible data too, though more cautiously than compressFast
+                        match = {};
+                        position += 1 + ((position - anchor) >> 8);
+                        continue;
+                    }
+                }
+
+                // Lazy matching: a longer match one byte later is worth a literal
+                if (position + 1 < searchEnd) {
+                    chains.insert(position + 1);
+                    const Match next = chains.find(position + 1, matchEnd);
+                    if (next.length > match.length) {
+                        match = next;
+                        ++position;
+                        continue;
+                    }
+                }
+
+                writeSequence(out, data + anchor, position - anchor, match);
+                position += match.length;
+                anchor = position;
+                match = {};
+            }
+        }
+        writeSequence(out, data + anchor, size - anchor, Match{});
+    }
+};
+
+#endif //COMPRESSIONHELPER_H
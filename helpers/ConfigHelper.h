@@ -3,8 +3,15 @@
 
 #include <string>
 #include <fstream>
+#include <stdexcept>
+
+#ifdef _WIN32
 #include <windows.h>
 #include <shlwapi.h>
+#else
+#include <filesystem>
+#include <vector>
+#endif
 
 class ConfigHelper {
 private:
@@ -12,6 +19,7 @@ private:
 
 public:
     ConfigHelper(const std::string& pathToIniFile) {
+#ifdef _WIN32
         if (PathIsRelativeA(pathToIniFile.c_str())) {
             // Get current directory and append
             char currentDir[MAX_PATH];
@@ -25,9 +33,13 @@ public:
             iniFilePath += pathToIniFile;
         } else // Path is absolute
             iniFilePath = pathToIniFile;
+#else
+        iniFilePath = std::filesystem::absolute(pathToIniFile).string();
+#endif
     }
 
     std::string readIni(const std::string& section, const std::string& key) {
+#ifdef _WIN32
         char buffer[1024] = { 0 };
 
         const DWORD result = GetPrivateProfileStringA(
@@ -44,9 +56,48 @@ public:
         }
 
         return buffer;
+#else
+        std::ifstream file(iniFilePath);
+        std::string line;
+        std::string currentSection;
+
+        while (std::getline(file, line)) {
+            line = trim(line);
+            if (line.empty() || line[0] == ';' || line[0] == '#')
+                continue;
+
+            if (line.front() == '[' && line.back() == ']') {
+                currentSection = trim(line.substr(1, line.size() - 2));
+                continue;
+            }
+
+            const size_t equalsPos = line.find('=');
+            if (equalsPos == std::string::npos || currentSection != section)
+                continue;
+
+            if (trim(line.substr(0, equalsPos)) == key) {
+                std::string value = trim(line.substr(equalsPos + 1));
+                if (!value.empty())
+                    return value;
+                break;
+            }
+        }
+
+        throw std::runtime_error("Failed to read ini file: " + iniFilePath + ", section: " + section + ", key: " + key);
+#endif
+    }
+
+    // Read a value, falling back to defaultValue when the key is missing
+    std::string readIni(const std::string& section, const std::string& key, const std::string& defaultValue) {
+        try {
+            return readIni(section, key);
+        } catch (const std::runtime_error&) {
+            return defaultValue;
+        }
     }
 
     bool writeIni(const std::string& section, const std::string& key, const std::string& value) {
+#ifdef _WIN32
         const BOOL result = WritePrivateProfileStringA(
             section.c_str(),
             key.c_str(),
@@ -55,6 +106,68 @@ public:
         );
 
         return result != 0;
+#else
+        std::vector<std::string> lines;
+        {
+            std::ifstream file(iniFilePath);
+            std::string line;
+            while (std::getline(file, line))
+                lines.push_back(line);
+        }
+
+        // Find the section, then either replace the key or insert it at the end of the section
+        std::string currentSection;
+        size_t sectionEnd = std::string::npos;
+        bool written = false;
+
+        for (size_t i = 0; i < lines.size() && !written; ++i) {
+            const std::string line = trim(lines[i]);
+            if (!line.empty() && line.front() == '[' && line.back() == ']') {
+                if (currentSection == section)
+                    break;
+                currentSection = trim(line.substr(1, line.size() - 2));
+                if (currentSection == section)
+                    sectionEnd = i + 1;
+                continue;
+            }
+
+            if (currentSection != section)
+                continue;
+
+            const size_t equalsPos = line.find('=');
+            if (equalsPos != std::string::npos && trim(line.substr(0, equalsPos)) == key) {
+                lines[i] = key + "=" + value;
+                written = true;
+            } else if (!line.empty())
+                sectionEnd = i + 1;
+        }
+
+        if (!written) {
+            if (sectionEnd == std::string::npos) {
+                if (!lines.empty())
+                    lines.emplace_back();
+                lines.push_back("[" + section + "]");
+                lines.push_back(key + "=" + value);
+            } else
+                lines.insert(lines.begin() + static_cast<std::ptrdiff_t>(sectionEnd), key + "=" + value);
+        }
+
+        std::ofstream file(iniFilePath, std::ios::trunc);
+        for (const auto& line : lines)
+            file << line << "\n";
+
+        return static_cast<bool>(file);
+#endif
+    }
+
+private:
+    static std::string trim(const std::string& str) {
+        const size_t first = str.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return "";
+
+        const size_t last = str.find_last_not_of(" \t\r");
+        return str.substr(first, last - first + 1);
     }
 };
 
@@ -1,13 +1,15 @@
 #ifndef CRYPTHELPER_H
 #define CRYPTHELPER_H
 
-#include <Windows.h>
-#include <wincrypt.h>
 #include <string>
 #include <vector>
 #include <memory>
 #include <stdexcept>
 
+#ifdef _WIN32
+#include <Windows.h>
+#include <wincrypt.h>
+
 class CryptHelper {
 private:
     HCRYPTPROV m_hCryptProv = NULL;
@@ -285,5 +287,31 @@ public:
         m_hasKeyPair = false;
     }
 };
+#else
+#include "HashHelper.h"
+
+using ALG_ID = unsigned int;
+constexpr ALG_ID CALG_SHA_256 = 0x0000800c;
+
+// Portable subset of CryptHelper: only the hashing used by the packet layer
+class CryptHelper {
+public:
+    CryptHelper() = default;
+
+    bool initialize() {
+        return true;
+    }
+
+    // Create a hash of the data
+    std::vector<BYTE> createHash(const std::vector<BYTE>& data, const ALG_ID algId = CALG_SHA_256) {
+        if (algId != CALG_SHA_256)
+            throw std::runtime_error("Unsupported hash algorithm: " + std::to_string(algId));
+
+        return HashHelper::sha256(data.data(), data.size());
+    }
+
+    void cleanup() {}
+};
+#endif
 
 #endif //CRYPTHELPER_H
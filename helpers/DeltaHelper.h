@@ -0,0 +1,422 @@
+#ifndef DELTAHELPER_H
+#define DELTAHELPER_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "CryptHelper.h"
+#include "FileHelper.h"
+#include "HashHelper.h"
+
+// rsync-style delta encoding. Whoever has the old version of a file describes it by a signature:
+// a weak rolling checksum and a strong hash of each of its blocks. Whoever has the new version
+// slides a block-sized window over it byte by byte; where the window's rolling checksum and then
+// its strong hash match a block of the signature, a reference to that block is sent instead of
+// the bytes. Everything else is sent literally. The old file and the delta then rebuild the new one.
+//
+// Signature (little-endian): u32 block size | u64 file size | per whole block: u32 weak | u8[16] strong
+// Delta: a sequence of instructions
+//   COPY    u8 1 | u64 first block | u32 block count    consecutive blocks of the old file
+//   LITERAL u8 2 | u32 length | bytes
+//   END     u8 3 | u8[32] SHA-256 of the whole new file
+class DeltaHelper {
+public:
+    static constexpr size_t STRONG_SIZE = 16;        // Bytes of the SHA-256 of a block kept in a signature
+    static constexpr size_t SIGNATURE_HEADER_SIZE = 12;
+    static constexpr size_t SIGNATURE_ENTRY_SIZE = sizeof(uint32_t) + STRONG_SIZE;
+    static constexpr size_t MIN_BLOCK_SIZE = 2048;
+    static constexpr size_t MAX_BLOCKS = 8192;       // Keeps a signature within one request, even hex-encoded
+    static constexpr size_t MAX_BLOCK_SIZE = 16 * 1024 * 1024; // Bounds the encoder's buffer
+    static constexpr size_t MAX_LITERAL = 64 * 1024; // Literal bytes per instruction
+
+    enum class Op : uint8_t {
+        Copy = 1,
+        Literal = 2,
+        End = 3
+    };
+
+    // Adler-32-like checksum of a window, moved by one byte in constant time (as in rsync)
+    class RollingChecksum {
+    public:
+        void reset(const BYTE* data, const size_t size) {
+            m_a = m_b = 0;
+            m_size = static_cast<uint32_t>(size);
+            for (size_t i = 0; i < size; ++i) {
+                m_a += data[i];
+                m_b += m_a;
+            }
+        }
+
+        // Drops `out` from the front of the window and appends `in` at its back
+        void roll(const BYTE out, const BYTE in) {
+            m_a += in - out;
+            m_b += m_a - m_size * out;
+        }
+
+        uint32_t value() const { return (m_a & 0xffff) | m_b << 16; }
+
+    private:
+        uint32_t m_a = 0;
+        uint32_t m_b = 0;
+        uint32_t m_size = 0;
+    };
+
+    struct Signature {
+        size_t blockSize = 0;
+        uint64_t fileSize = 0;
+        std::vector<uint32_t> weak;
+        std::vector<std::array<BYTE, STRONG_SIZE>> strong;
+    };
+
+    // About the square root of the file size, as rsync picks it, but large enough to stay under MAX_BLOCKS
+    static size_t blockSize(const uint64_t fileSize) {
+        size_t size = MIN_BLOCK_SIZE;
+        while (size < MAX_BLOCK_SIZE && (static_cast<uint64_t>(size) * size < fileSize || fileSize / size > MAX_BLOCKS))
+            size *= 2;
+        return size;
+    }
+
+    static std::array<BYTE, STRONG_SIZE> strongHash(CryptHelper& cryptHelper, const std::vector<BYTE>& block) {
+        const auto digest = cryptHelper.createHash(block);
+        std::array<BYTE, STRONG_SIZE> strong{};
+        std::copy_n(digest.begin(), std::min(digest.size(), STRONG_SIZE), strong.begin());
+        return strong;
+    }
+
+    // Signature of a file's whole blocks; a trailing partial block is left out and sent literally if unchanged.
+    // Empty if the file cannot be read or is too large to be described in MAX_BLOCKS blocks.
+    static std::vector<BYTE> makeSignature(CryptHelper& cryptHelper, const FileHelper::File& file) {
+        const uint64_t fileSize = file.size();
+        const size_t size = blockSize(fileSize);
+        const uint64_t blocks = fileSize / size;
+        if (!file.isOpen() || blocks > MAX_BLOCKS)
+            return {};
+
+        std::vector<BYTE> signature(SIGNATURE_HEADER_SIZE + blocks * SIGNATURE_ENTRY_SIZE);
+        writeLE<uint32_t>(signature.data(), static_cast<uint32_t>(size));
+        writeLE<uint64_t>(signature.data() + 4, fileSize);
+
+        std::vector<BYTE> block(size);
+        RollingChecksum rolling;
+        for (uint64_t i = 0; i < blocks; ++i) {
+            if (file.read(i * size, reinterpret_cast<char*>(block.data()), size) != size)
+                return {}; // Shrank while reading
+
+            BYTE* entry = signature.data() + SIGNATURE_HEADER_SIZE + i * SIGNATURE_ENTRY_SIZE;
+            rolling.reset(block.data(), size);
+            writeLE<uint32_t>(entry, rolling.value());
+            const auto strong = strongHash(cryptHelper, block);
+            memcpy(entry + sizeof(uint32_t), strong.data(), STRONG_SIZE);
+        }
+        return signature;
+    }
+
+    static bool parseSignature(const std::vector<BYTE>& data, Signature& signature) {
+        if (data.size() < SIGNATURE_HEADER_SIZE || (data.size() - SIGNATURE_HEADER_SIZE) % SIGNATURE_ENTRY_SIZE != 0)
+            return false;
+
+        signature.blockSize = readLE<uint32_t>(data.data());
+        signature.fileSize = readLE<uint64_t>(data.data() + 4);
+        const size_t blocks = (data.size() - SIGNATURE_HEADER_SIZE) / SIGNATURE_ENTRY_SIZE;
+        if (signature.blockSize != blockSize(signature.fileSize) || blocks > MAX_BLOCKS ||
+            blocks != signature.fileSize / signature.blockSize)
+            return false;
+
+        signature.weak.resize(blocks);
+        signature.strong.resize(blocks);
+        for (size_t i = 0; i < blocks; ++i) {
+            const BYTE* entry = data.data() + SIGNATURE_HEADER_SIZE + i * SIGNATURE_ENTRY_SIZE;
+            signature.weak[i] = readLE<uint32_t>(entry);
+            memcpy(signature.strong[i].data(), entry + sizeof(uint32_t), STRONG_SIZE);
+        }
+        return true;
+    }
+
+    // Produces the delta of a file against a signature, a part at a time, reading the file as it goes
+    class Encoder {
+    public:
+        Encoder(CryptHelper& cryptHelper, std::shared_ptr<const FileHelper::File> file, Signature signature)
+            : m_cryptHelper(cryptHelper), m_file(std::move(file)), m_signature(std::move(signature)) {
+            m_fileSize = m_file->isOpen() ? m_file->size() : 0;
+            m_blockSize = std::max<size_t>(m_signature.blockSize, 1);
+            m_buffer.resize(MAX_LITERAL + 2 * m_blockSize + READ_SIZE);
+            m_window.resize(m_blockSize);
+
+            m_filter.resize(1 << 16);
+            for (size_t i = 0; i < m_signature.weak.size(); ++i) {
+                m_blocks[m_signature.weak[i]].push_back(static_cast<uint32_t>(i));
+                m_filter[filterIndex(m_signature.weak[i])] = true;
+            }
+        }
+
+        uint64_t fileSize() const { return m_fileSize; }
+        bool done() const { return m_done; }
+
+        // Bytes of the file sent literally so far
+        uint64_t literalBytes() const { return m_literalBytes; }
+
+        // Appends instructions to `out` until it holds at least `budget` bytes or, with END, the whole file
+        // is covered; false if the file could not be read
+        bool encode(std::vector<BYTE>& out, const size_t budget) {
+            while (!m_done && out.size() < budget) {
+                if (!fill())
+                    return false;
+
+                // Too little left for a block (or nothing to match): the rest goes literally
+                if (m_end - m_pos < m_blockSize || m_blocks.empty()) {
+                    flushCopy(out);
+                    m_pos = std::min(m_end, m_literalStart + MAX_LITERAL);
+                    flushLiteral(out);
+                    if (m_eof && m_pos == m_end)
+                        finish(out);
+                    continue;
+                }
+
+                if (!m_rollingValid) {
+                    m_rolling.reset(m_buffer.data() + m_pos, m_blockSize);
+                    m_rollingValid = true;
+                }
+
+                const int64_t block = findBlock();
+                if (block >= 0) {
+                    flushLiteral(out);
+                    m_hash.update(m_buffer.data() + m_pos, m_blockSize);
+                    if (m_copyCount == 0 || m_copyFirst + m_copyCount != static_cast<uint64_t>(block)) {
+                        flushCopy(out);
+                        m_copyFirst = static_cast<uint64_t>(block);
+                    }
+                    ++m_copyCount;
+
+                    m_pos += m_blockSize;
+                    m_literalStart = m_pos;
+                    m_rollingValid = false;
+                    continue;
+                }
+
+                // No match: the window's first byte becomes literal, after any blocks matched before it
+                flushCopy(out);
+                if (m_pos + m_blockSize < m_end)
+                    m_rolling.roll(m_buffer[m_pos], m_buffer[m_pos + m_blockSize]);
+                else
+                    m_rollingValid = false;
+                ++m_pos;
+
+                if (m_pos - m_literalStart >= MAX_LITERAL)
+                    flushLiteral(out);
+            }
+            return true;
+        }
+
+    private:
+        static constexpr size_t READ_SIZE = 1024 * 1024;
+
+        // Most windows match no block; a bit per 16-bit tag rules them out before the hash table lookup
+        static size_t filterIndex(const uint32_t weak) {
+            return (weak ^ weak >> 16) & 0xffff;
+        }
+
+        // Makes sure more than a block is buffered past the window start, unless the file ends first
+        bool fill() {
+            if (m_eof || m_end - m_pos > m_blockSize)
+                return true;
+
+            // Only bytes not sent yet are kept
+            memmove(m_buffer.data(), m_buffer.data() + m_literalStart, m_end - m_literalStart);
+            m_pos -= m_literalStart;
+            m_end -= m_literalStart;
+            m_literalStart = 0;
+
+            const auto wanted = static_cast<size_t>(std::min<uint64_t>(m_buffer.size() - m_end, m_fileSize - m_readOffset));
+            const size_t read = wanted > 0 ? m_file->read(m_readOffset, reinterpret_cast<char*>(m_buffer.data() + m_end), wanted) : 0;
+            if (read != wanted)
+                return false; // Shrank or became unreadable
+
+            m_readOffset += read;
+            m_end += read;
+            m_eof = m_readOffset == m_fileSize;
+            return true;
+        }
+
+        // Block of the signature equal to the window, preferring the one that continues the current copy
+        int64_t findBlock() {
+            const uint32_t weak = m_rolling.value();
+            if (!m_filter[filterIndex(weak)])
+                return -1;
+
+            const auto it = m_blocks.find(weak);
+            if (it == m_blocks.end())
+                return -1;
+
+            m_window.assign(m_buffer.begin() + static_cast<ptrdiff_t>(m_pos), m_buffer.begin() + static_cast<ptrdiff_t>(m_pos + m_blockSize));
+            const auto strong = strongHash(m_cryptHelper, m_window);
+
+            int64_t found = -1;
+            for (const uint32_t block : it->second) {
+                if (m_signature.strong[block] != strong)
+                    continue;
+                if (m_copyCount > 0 && m_copyFirst + m_copyCount == block)
+                    return block;
+                if (found < 0)
+                    found = block;
+            }
+            return found;
+        }
+
+        void flushLiteral(std::vector<BYTE>& out) {
+            const size_t length = m_pos - m_literalStart;
+            if (length == 0)
+                return;
+
+            const BYTE* data = m_buffer.data() + m_literalStart;
+            const size_t position = out.size();
+            out.resize(position + 1 + sizeof(uint32_t) + length);
+            out[position] = static_cast<BYTE>(Op::Literal);
+            writeLE<uint32_t>(out.data() + position + 1, static_cast<uint32_t>(length));
+            memcpy(out.data() + position + 1 + sizeof(uint32_t), data, length);
+
+            m_hash.update(data, length);
+            m_literalBytes += length;
+            m_literalStart = m_pos;
+        }
+
+        void flushCopy(std::vector<BYTE>& out) {
+            if (m_copyCount == 0)
+                return;
+
+            const size_t position = out.size();
+            out.resize(position + 1 + sizeof(uint64_t) + sizeof(uint32_t));
+            out[position] = static_cast<BYTE>(Op::Copy);
+            writeLE<uint64_t>(out.data() + position + 1, m_copyFirst);
+            writeLE<uint32_t>(out.data() + position + 1 + sizeof(uint64_t), m_copyCount);
+            m_copyCount = 0;
+        }
+
+        void finish(std::vector<BYTE>& out) {
+            const auto digest = m_hash.finish();
+            out.push_back(static_cast<BYTE>(Op::End));
+            out.insert(out.end(), digest.begin(), digest.end());
+            m_done = true;
+        }
+
+        CryptHelper& m_cryptHelper;
+        std::shared_ptr<const FileHelper::File> m_file;
+        Signature m_signature;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> m_blocks; // Signature blocks by weak checksum
+        std::vector<bool> m_filter;   // Tags of the weak checksums in m_blocks
+        size_t m_blockSize;
+        uint64_t m_fileSize;
+
+        std::vector<BYTE> m_buffer;   // File bytes from m_literalStart on
+        std::vector<BYTE> m_window;   // Copy of the window for createHash
+        size_t m_literalStart = 0;    // First byte not sent yet
+        size_t m_pos = 0;             // Window start
+        size_t m_end = 0;             // End of the buffered bytes
+        uint64_t m_readOffset = 0;    // File offset of the next read
+        bool m_eof = false;
+
+        RollingChecksum m_rolling;
+        bool m_rollingValid = false;
+        uint64_t m_copyFirst = 0;     // Run of matched blocks not sent yet
+        uint32_t m_copyCount = 0;
+        HashHelper::Sha256 m_hash;    // Of the new file, for END
+        uint64_t m_literalBytes = 0;
+        bool m_done = false;
+    };
+
+    // Rebuilds the new version of a file from its delta and the old version
+    class Patcher {
+    public:
+        Patcher(const FileHelper::File& oldFile, const size_t blockSize, FileHelper::WritableFile& newFile)
+            : m_oldFile(oldFile), m_blockSize(blockSize), m_newFile(newFile) {}
+
+        // Applies whole instructions, as every packet of a delta carries; false if they are malformed or I/O fails
+        bool apply(const BYTE* data, const size_t size) {
+            size_t position = 0;
+            while (position < size && !m_done) {
+                const auto op = static_cast<Op>(data[position++]);
+                if (op == Op::Copy) {
+                    if (size - position < sizeof(uint64_t) + sizeof(uint32_t))
+                        return false;
+                    const uint64_t first = readLE<uint64_t>(data + position);
+                    const uint32_t count = readLE<uint32_t>(data + position + sizeof(uint64_t));
+                    position += sizeof(uint64_t) + sizeof(uint32_t);
+                    if (!copy(first, count))
+                        return false;
+                } else if (op == Op::Literal) {
+                    if (size - position < sizeof(uint32_t))
+                        return false;
+                    const uint32_t length = readLE<uint32_t>(data + position);
+                    position += sizeof(uint32_t);
+                    if (size - position < length || !write(data + position, length))
+                        return false;
+                    position += length;
+                } else if (op == Op::End) {
+                    if (size - position < HashHelper::Sha256::DIGEST_SIZE)
+                        return false;
+                    m_verified = m_hash.finish() == std::vector<BYTE>(data + position, data + position + HashHelper::Sha256::DIGEST_SIZE);
+                    position += HashHelper::Sha256::DIGEST_SIZE;
+                    m_done = true;
+                } else {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // END was applied; verified() tells whether the result has the new file's SHA-256
+        bool done() const { return m_done; }
+        bool verified() const { return m_verified; }
+        uint64_t size() const { return m_size; }
+
+    private:
+        bool copy(const uint64_t first, const uint32_t count) {
+            std::vector<BYTE> buffer(m_blockSize);
+            for (uint64_t block = first; block < first + count; ++block) {
+                if (m_oldFile.read(block * m_blockSize, reinterpret_cast<char*>(buffer.data()), m_blockSize) != m_blockSize ||
+                    !write(buffer.data(), m_blockSize))
+                    return false;
+            }
+            return true;
+        }
+
+        bool write(const BYTE* data, const size_t size) {
+            if (!m_newFile.write(m_size, reinterpret_cast<const char*>(data), size))
+                return false;
+            m_hash.update(data, size);
+            m_size += size;
+            return true;
+        }
+
+        const FileHelper::File& m_oldFile;
+        size_t m_blockSize;
+        FileHelper::WritableFile& m_newFile;
+        HashHelper::Sha256 m_hash;
+        uint64_t m_size = 0;
+        bool m_done = false;
+        bool m_verified = false;
+    };
+
+private:
+    template <typename T>
+    static void writeLE(BYTE* out, T value) {
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            out[i] = static_cast<BYTE>(value & 0xff);
+            value = static_cast<T>(value >> 8);
+        }
+    }
+
+    template <typename T>
+    static T readLE(const BYTE* in) {
+        T value = 0;
+        for (size_t i = sizeof(T); i-- > 0;)
+            value = static_cast<T>(value << 8 | in[i]);
+        return value;
+    }
+};
+
+#endif //DELTAHELPER_H
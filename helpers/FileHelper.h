@@ -1,13 +1,511 @@
 #ifndef FILEHELPER_H
 #define FILEHELPER_H
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <span>
+#include <string>
+
+#include "PlatformHelper.h"
+
+#ifdef _WIN32
+#include <windows.h>
 #include <shlwapi.h>
 #include <shlobj.h>
-#include <string>
+#else
+#include <cerrno>
+#include <csignal>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 class FileHelper {
 public:
+    // Read-only file opened through the OS API, so that its handle can be given to
+    // sendfile/TransmitFile and read at any offset from several threads
+    class File {
+    public:
+#ifdef _WIN32
+        using Handle = HANDLE;
+#else
+        using Handle = int;
+#endif
+
+        explicit File(const std::string& path) {
+#ifdef _WIN32
+            m_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            LARGE_INTEGER size{};
+            if (m_handle != INVALID_HANDLE_VALUE && GetFileSizeEx(m_handle, &size))
+                m_size = static_cast<uint64_t>(size.QuadPart);
+#else
+            m_handle = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            struct stat info{};
+            if (m_handle >= 0 && fstat(m_handle, &info) == 0 && S_ISREG(info.st_mode))
+                m_size = static_cast<uint64_t>(info.st_size);
+            else if (m_handle >= 0) {
+                ::close(m_handle);
+                m_handle = -1;
+            }
+#endif
+        }
+
+        ~File() {
+            if (!isOpen()) return;
+#ifdef _WIN32
+            CloseHandle(m_handle);
+#else
+            ::close(m_handle);
+#endif
+        }
+
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+
+        bool isOpen() const {
+#ifdef _WIN32
+            return m_handle != INVALID_HANDLE_VALUE;
+#else
+            return m_handle >= 0;
+#endif
+        }
+
+        Handle handle() const { return m_handle; }
+        uint64_t size() const { return m_size; }
+
+        // Positional read; returns the number of bytes read, 0 at end of file or on error
+        size_t read(const uint64_t offset, char* buffer, const size_t size) const {
+#ifdef _WIN32
+            OVERLAPPED overlapped{};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+            DWORD bytesRead = 0;
+            if (!ReadFile(m_handle, buffer, static_cast<DWORD>(size), &bytesRead, &overlapped))
+                return 0;
+            return bytesRead;
+#else
+            size_t done = 0;
+            while (done < size) {
+                const ssize_t result = pread(m_handle, buffer + done, size - done, static_cast<off_t>(offset + done));
+                if (result < 0 && errno == EINTR) continue;
+                if (result <= 0) break;
+                done += static_cast<size_t>(result);
+            }
+            return done;
+#endif
+        }
+
+    private:
+        Handle m_handle;
+        uint64_t m_size = 0;
+    };
+
+    // File written at arbitrary offsets through the OS API, e.g. by chunks arriving out of order.
+    // Opened for reading too, so that data already on disk can be checked.
+    class WritableFile {
+    public:
+#ifdef _WIN32
+        using Handle = HANDLE;
+#else
+        using Handle = int;
+#endif
+
+        // Creates the file if needed; with truncate, existing contents are dropped
+        WritableFile(const std::string& path, const bool truncate) {
+#ifdef _WIN32
+            m_handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                                   truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+#else
+            m_handle = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+#endif
+        }
+
+        ~WritableFile() {
+            if (!isOpen()) return;
+#ifdef _WIN32
+            CloseHandle(m_handle);
+#else
+            ::close(m_handle);
+#endif
+        }
+
+        WritableFile(const WritableFile&) = delete;
+        WritableFile& operator=(const WritableFile&) = delete;
+
+        bool isOpen() const {
+#ifdef _WIN32
+            return m_handle != INVALID_HANDLE_VALUE;
+#else
+            return m_handle >= 0;
+#endif
+        }
+
+        uint64_t size() const {
+#ifdef _WIN32
+            LARGE_INTEGER size{};
+            return GetFileSizeEx(m_handle, &size) ? static_cast<uint64_t>(size.QuadPart) : 0;
+#else
+            struct stat info{};
+            return fstat(m_handle, &info) == 0 ? static_cast<uint64_t>(info.st_size) : 0;
+#endif
+        }
+
+        // Reserves disk space for, and sets the length to, size bytes so that writes do not
+        // extend the file piece by piece. Best effort: the length is set even without reservation.
+        bool preallocate(const uint64_t size) {
+#ifdef _WIN32
+            FILE_ALLOCATION_INFO allocation{};
+            allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+            SetFileInformationByHandle(m_handle, FileAllocationInfo, &allocation, sizeof(allocation));
+            // Bytes not written yet read as zeros; SetFileValidData would skip zeroing them, but
+            // they would then hold whatever the disk held before, and the file outlives a failed download
+            return resize(size);
+#else
+#ifdef __linux__
+            // Unlike posix_fallocate, fails instead of writing zeros where the filesystem cannot reserve
+            int result;
+            do {
+                result = fallocate(m_handle, 0, 0, static_cast<off_t>(size));
+            } while (result != 0 && errno == EINTR);
+            if (result == 0 && this->size() == size)
+                return true;
+#endif
+            return resize(size);
+#endif
+        }
+
+        bool resize(const uint64_t size) {
+#ifdef _WIN32
+            FILE_END_OF_FILE_INFO end{};
+            end.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+            return SetFileInformationByHandle(m_handle, FileEndOfFileInfo, &end, sizeof(end));
+#else
+            return ftruncate(m_handle, static_cast<off_t>(size)) == 0;
+#endif
+        }
+
+        // Positional write of all size bytes; false on error
+        bool write(const uint64_t offset, const char* data, const size_t size) {
+#ifdef _WIN32
+            size_t done = 0;
+            while (done < size) {
+                OVERLAPPED overlapped{};
+                overlapped.Offset = static_cast<DWORD>(offset + done);
+                overlapped.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+
+                DWORD written = 0;
+                const auto chunk = static_cast<DWORD>(std::min<size_t>(size - done, 1u << 30));
+                if (!WriteFile(m_handle, data + done, chunk, &written, &overlapped) || written == 0)
+                    return false;
+                done += written;
+            }
+            return true;
+#else
+            size_t done = 0;
+            while (done < size) {
+                const ssize_t result = pwrite(m_handle, data + done, size - done, static_cast<off_t>(offset + done));
+                if (result < 0 && errno == EINTR) continue;
+                if (result <= 0) return false;
+                done += static_cast<size_t>(result);
+            }
+            return true;
+#endif
+        }
+
+        // Positional read; returns the number of bytes read, 0 at end of file or on error
+        size_t read(const uint64_t offset, char* buffer, const size_t size) const {
+#ifdef _WIN32
+            OVERLAPPED overlapped{};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+            DWORD bytesRead = 0;
+            if (!ReadFile(m_handle, buffer, static_cast<DWORD>(size), &bytesRead, &overlapped))
+                return 0;
+            return bytesRead;
+#else
+            size_t done = 0;
+            while (done < size) {
+                const ssize_t result = pread(m_handle, buffer + done, size - done, static_cast<off_t>(offset + done));
+                if (result < 0 && errno == EINTR) continue;
+                if (result <= 0) break;
+                done += static_cast<size_t>(result);
+            }
+            return done;
+#endif
+        }
+
+    private:
+        Handle m_handle;
+    };
+
+#ifndef _WIN32
+    // Reading a mapped page past the end of a file that was truncated raises SIGBUS. For the
+    // mappings registered here, the handler maps a page of zeros over the missing one, so that
+    // the reader carries on and finds out from MappedFile::contains that the data is gone.
+    // Faults anywhere else go to the handler that was installed before, or get the default action.
+    //
+    // mmap is not on POSIX's list of async-signal-safe functions. It is used here anyway because
+    // the fault is synchronous (the interrupted code is the reader touching the page, not one
+    // holding a lock mmap could need), and because on Linux and the BSDs mmap is a bare system
+    // call: no allocation, no locks, no state in libc. The zero page comes from /dev/zero, opened
+    // when the handler is installed, so the handler opens nothing and only replaces a page inside
+    // a mapping it owns.
+    class TruncationGuard {
+    public:
+        static constexpr size_t MAX_MAPPINGS = 4096;
+
+        // False if all slots are taken; the mapping must then not be read
+        static bool add(const void* address, const size_t size) {
+            static std::once_flag installed;
+            std::call_once(installed, install);
+
+            const auto begin = reinterpret_cast<uintptr_t>(address);
+            for (auto& slot : slots()) {
+                uintptr_t expected = 0;
+                if (slot.begin.compare_exchange_strong(expected, begin)) {
+                    slot.end.store(begin + size, std::memory_order_release);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        static void remove(const void* address) {
+            const auto begin = reinterpret_cast<uintptr_t>(address);
+            for (auto& slot : slots()) {
+                if (slot.begin.load(std::memory_order_acquire) == begin) {
+                    slot.end.store(0, std::memory_order_release);
+                    slot.begin.store(0, std::memory_order_release);
+                    return;
+                }
+            }
+        }
+
+    private:
+        struct Slot {
+            std::atomic<uintptr_t> begin{0};
+            std::atomic<uintptr_t> end{0};
+        };
+
+        static Slot (&slots())[MAX_MAPPINGS] {
+            static Slot slots[MAX_MAPPINGS];
+            return slots;
+        }
+
+        static inline uintptr_t s_pageSize = 4096;
+        static inline int s_zeroFile = -1;
+        static inline struct sigaction s_previous{};
+
+        static void install() {
+            s_pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+            s_zeroFile = open("/dev/zero", O_RDONLY | O_CLOEXEC);
+            slots(); // Constructed here rather than in the handler
+
+            struct sigaction action{};
+            action.sa_sigaction = handler;
+            action.sa_flags = SA_SIGINFO | SA_RESTART;
+            sigemptyset(&action.sa_mask);
+            sigaction(SIGBUS, nullptr, &s_previous);
+            sigaction(SIGBUS, &action, nullptr);
+        }
+
+        static void handler(const int signal, siginfo_t* info, void* context) {
+            const int savedErrno = errno;
+            const auto address = reinterpret_cast<uintptr_t>(info->si_addr);
+            for (auto& slot : slots()) {
+                const uintptr_t begin = slot.begin.load(std::memory_order_acquire);
+                if (begin == 0 || address < begin || address >= slot.end.load(std::memory_order_acquire))
+                    continue;
+
+                void* page = reinterpret_cast<void*>(address & ~(s_pageSize - 1));
+                const void* zeros = s_zeroFile >= 0
+                    ? mmap(page, s_pageSize, PROT_READ, MAP_PRIVATE | MAP_FIXED, s_zeroFile, 0)
+                    : mmap(page, s_pageSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+                errno = savedErrno;
+                if (zeros != MAP_FAILED)
+                    return;
+                break;
+            }
+            errno = savedErrno;
+
+            // Not ours: chain to the previous handler
+            if ((s_previous.sa_flags & SA_SIGINFO) && s_previous.sa_sigaction) {
+                s_previous.sa_sigaction(signal, info, context);
+                return;
+            }
+            if (!(s_previous.sa_flags & SA_SIGINFO) && s_previous.sa_handler != SIG_DFL && s_previous.sa_handler != SIG_IGN) {
+                s_previous.sa_handler(signal);
+                return;
+            }
+
+            // Otherwise the faulting access is repeated and ends the process as usual
+            struct sigaction fallback{};
+            fallback.sa_handler = SIG_DFL;
+            sigemptyset(&fallback.sa_mask);
+            sigaction(SIGBUS, &fallback, nullptr);
+        }
+    };
+#endif
+
+    // Read-only file mapped into memory, so that chunks can be hashed and encoded straight from
+    // its pages. The mapping covers the file as it was when opened; views are cut short where
+    // the file ends now. Windows refuses to truncate a file while it is mapped; elsewhere pages
+    // lost to truncation read as zeros (see TruncationGuard), so whatever was read from a view
+    // is only good if contains() still holds afterwards. Files that cannot be mapped (e.g. empty
+    // ones) stay open for positional reads through file().
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path) : m_file(path), m_size(m_file.size()) {
+            if (!m_file.isOpen() || m_size == 0 || m_size > SIZE_MAX)
+                return;
+#ifdef _WIN32
+            m_mapping = CreateFileMappingA(m_file.handle(), nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_mapping)
+                m_data = static_cast<const BYTE*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+            void* data = mmap(nullptr, static_cast<size_t>(m_size), PROT_READ, MAP_SHARED, m_file.handle(), 0);
+            if (data == MAP_FAILED)
+                return;
+            if (!TruncationGuard::add(data, static_cast<size_t>(m_size))) {
+                munmap(data, static_cast<size_t>(m_size));
+                return;
+            }
+            madvise(data, static_cast<size_t>(m_size), MADV_SEQUENTIAL);
+            m_data = static_cast<const BYTE*>(data);
+#endif
+        }
+
+        ~MappedFile() {
+#ifdef _WIN32
+            if (m_data)
+                UnmapViewOfFile(m_data);
+            if (m_mapping)
+                CloseHandle(m_mapping);
+#else
+            if (m_data) {
+                TruncationGuard::remove(m_data);
+                munmap(const_cast<BYTE*>(m_data), static_cast<size_t>(m_size));
+            }
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool isOpen() const { return m_file.isOpen(); }
+        bool isMapped() const { return m_data != nullptr; }
+        const File& file() const { return m_file; }
+
+        // Size when the file was opened
+        uint64_t size() const { return m_size; }
+
+        // Up to `length` mapped bytes from offset, fewer where the file ends now; empty if not mapped
+        std::span<const BYTE> view(const uint64_t offset, const size_t length) const {
+            const uint64_t size = m_data ? currentSize() : 0;
+            if (offset >= size)
+                return {};
+            return {m_data + offset, static_cast<size_t>(std::min<uint64_t>(length, size - offset))};
+        }
+
+        // Whether the file still holds all bytes before `end`, i.e. views ending there read real data
+        bool contains(const uint64_t end) const {
+            return end <= currentSize();
+        }
+
+    private:
+        // Size of the file now, but no more than is mapped
+        uint64_t currentSize() const {
+#ifdef _WIN32
+            return m_size;
+#else
+            struct stat info{};
+            if (fstat(m_file.handle(), &info) != 0)
+                return 0;
+            return std::min(m_size, static_cast<uint64_t>(info.st_size));
+#endif
+        }
+
+        File m_file;
+        uint64_t m_size;
+        const BYTE* m_data = nullptr;
+#ifdef _WIN32
+        HANDLE m_mapping = nullptr;
+#endif
+    };
+
+    // What cached data derived from a file is checked against; any difference means the file changed
+    struct Identity {
+        uint64_t size = 0;
+        int64_t modified = 0; // Last write time: ns since the epoch (POSIX) or FILETIME ticks (Windows)
+        uint64_t fileId = 0;  // Inode or NTFS file index, so a replaced file is noticed too
+
+        bool operator==(const Identity&) const = default;
+    };
+
+    // Identity of a regular file; false if it does not exist or is not a regular file
+    static bool getIdentity(const std::string& path, Identity& identity) {
+#ifdef _WIN32
+        const HANDLE handle = CreateFileA(path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                          nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return false;
+
+        BY_HANDLE_FILE_INFORMATION info{};
+        const BOOL result = GetFileInformationByHandle(handle, &info);
+        CloseHandle(handle);
+        if (!result || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+            return false;
+
+        identity.size = static_cast<uint64_t>(info.nFileSizeHigh) << 32 | info.nFileSizeLow;
+        identity.modified = static_cast<int64_t>(static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32 | info.ftLastWriteTime.dwLowDateTime);
+        identity.fileId = static_cast<uint64_t>(info.nFileIndexHigh) << 32 | info.nFileIndexLow;
+        return true;
+#else
+        struct stat info{};
+        if (::stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+            return false;
+
+        identity.size = static_cast<uint64_t>(info.st_size);
+        identity.modified = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        identity.fileId = static_cast<uint64_t>(info.st_ino);
+        return true;
+#endif
+    }
+
+    // Identity of an open file, i.e. of what its handle reads now, whatever its path has become since
+    static bool getIdentity(const File& file, Identity& identity) {
+        if (!file.isOpen())
+            return false;
+#ifdef _WIN32
+        BY_HANDLE_FILE_INFORMATION info{};
+        if (!GetFileInformationByHandle(file.handle(), &info))
+            return false;
+
+        identity.size = static_cast<uint64_t>(info.nFileSizeHigh) << 32 | info.nFileSizeLow;
+        identity.modified = static_cast<int64_t>(static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32 | info.ftLastWriteTime.dwLowDateTime);
+        identity.fileId = static_cast<uint64_t>(info.nFileIndexHigh) << 32 | info.nFileIndexLow;
+        return true;
+#else
+        struct stat info{};
+        if (fstat(file.handle(), &info) != 0)
+            return false;
+
+        identity.size = static_cast<uint64_t>(info.st_size);
+        identity.modified = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        identity.fileId = static_cast<uint64_t>(info.st_ino);
+        return true;
+#endif
+    }
+
     static void createAllSubdirectories(const std::string& path) {
+#ifdef _WIN32
         std::string fullPath;
         if (PathIsRelativeA(path.c_str())) {
             // Get current directory and append
@@ -27,6 +525,10 @@ public:
         if (!PathFileExistsA(fullPath.c_str())) {
             SHCreateDirectoryExA(nullptr, fullPath.c_str(), nullptr);
         }
+#else
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::absolute(path), ec);
+#endif
     }
 };
 
@@ -0,0 +1,185 @@
+#ifndef FRAMEDECODER_H
+#define FRAMEDECODER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "PacketHelper.h"
+
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+#define FRAMEDECODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Incremental splitter of a byte stream into packets. Bytes are appended as they arrive,
+// however TCP happens to segment them, and next() hands out every complete packet in order:
+// binary packets by the length in their header, text packets from START_PACKET to END_PACKET.
+// Scanning for an end marker resumes where the previous attempt stopped and consumed bytes
+// are dropped in bulk, so decoding stays linear in the bytes received however they are split.
+class FrameDecoder {
+public:
+    static constexpr std::string_view START_MARKER = "START_PACKET";
+    static constexpr std::string_view END_MARKER = "END_PACKET";
+
+    explicit FrameDecoder(const size_t maxFrameSize) : m_maxFrameSize(maxFrameSize) {}
+
+    // Room for up to `size` more bytes, to be filled (e.g. by recv) and then passed to commit().
+    // Invalidates views handed out by next().
+    char* prepare(const size_t size) {
+        // Drop consumed bytes once they make up most of the buffer, keeping appends amortized linear
+        if (m_start > 0 && m_start >= m_end / 2) {
+            memmove(m_buffer.data(), m_buffer.data() + m_start, m_end - m_start);
+            m_end -= m_start;
+            m_scan -= std::min(m_scan, m_start);
+            m_start = 0;
+        }
+
+        if (m_buffer.size() < m_end + size)
+            m_buffer.resize(std::max(m_end + size, m_buffer.size() * 2));
+        return m_buffer.data() + m_end;
+    }
+
+    void commit(const size_t size) {
+        m_end += size;
+    }
+
+    void append(const char* data, const size_t size) {
+        memcpy(prepare(size), data, size);
+        commit(size);
+    }
+
+    // Next complete packet; the view stays valid until the next call to prepare() or append()
+    bool next(std::string_view& frame) {
+        while (!m_failed && m_start < m_end) {
+            const std::string_view remaining(m_buffer.data() + m_start, m_end - m_start);
+
+            // Binary packets are length-prefixed and may contain marker bytes in their payload
+            if (PacketHelper::isBinaryPacket(remaining)) {
+                if (remaining.size() < PacketHelper::BINARY_HEADER_SIZE)
+                    return false;
+
+                // The length is known once the header is in; one that cannot be a packet ends decoding
+                const size_t packetSize = PacketHelper::binaryPacketSize(remaining);
+                if (packetSize < PacketHelper::BINARY_HEADER_SIZE || packetSize > m_maxFrameSize) {
+                    m_failed = true;
+                    return false;
+                }
+                if (packetSize > remaining.size())
+                    return false;
+
+                frame = remaining.substr(0, packetSize);
+                consume(packetSize);
+                return true;
+            }
+
+            // A binary magic may still be arriving; do not mistake its first bytes for text
+            if (remaining.size() < sizeof(uint32_t) && isMagicPrefix(remaining))
+                return false;
+
+            if (!remaining.starts_with(START_MARKER)) {
+                // Skip noise up to the next start marker, keeping one that is only partially received
+                const size_t markerPos = findMarker(remaining, 1, START_MARKER);
+                if (markerPos == std::string_view::npos) {
+                    consume(remaining.size() - std::min(remaining.size(), START_MARKER.size() - 1));
+                    return false;
+                }
+                consume(markerPos);
+                continue;
+            }
+
+            // Text packet: look for the end marker from where the last search gave up
+            const size_t from = std::max(m_scan, m_start + START_MARKER.size()) - m_start;
+            const size_t endPos = findMarker(remaining, from, END_MARKER);
+            if (endPos == std::string_view::npos) {
+                m_scan = m_end - std::min(remaining.size() - from, END_MARKER.size() - 1);
+                if (remaining.size() > m_maxFrameSize)
+                    m_failed = true;
+                return false;
+            }
+
+            const size_t packetSize = endPos + END_MARKER.size();
+            frame = remaining.substr(0, packetSize);
+            consume(packetSize);
+            return true;
+        }
+        return false;
+    }
+
+    // A packet exceeded the maximum size or declared an impossible length; the stream cannot be
+    // decoded any further and next() returns false from then on
+    bool failed() const { return m_failed; }
+
+    // Bytes received but not handed out yet
+    size_t buffered() const { return m_end - m_start; }
+
+    // Forget all received bytes, e.g. after a reconnect
+    void reset() {
+        m_start = m_end = m_scan = 0;
+        m_failed = false;
+    }
+
+    // Position of the first occurrence of marker in data at or after from, or npos.
+    // Candidates are found 16 bytes at a time by matching the marker's first and last byte
+    // together, which rules out nearly every position in hex text before any memcmp.
+    static size_t findMarker(const std::string_view data, size_t from, const std::string_view marker) {
+        const size_t length = marker.size();
+        if (length == 0 || data.size() < length || from > data.size() - length)
+            return std::string_view::npos;
+
+        const char* text = data.data();
+#ifdef FRAMEDECODER_SSE2
+        const __m128i first = _mm_set1_epi8(marker.front());
+        const __m128i last = _mm_set1_epi8(marker.back());
+        for (; from + length - 1 + 16 <= data.size(); from += 16) {
+            const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + from));
+            const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + from + length - 1));
+            auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first), _mm_cmpeq_epi8(tail, last))));
+
+            while (mask != 0) {
+                const size_t position = from + __builtin_ctz(mask);
+                if (memcmp(text + position, marker.data(), length) == 0)
+                    return position;
+                mask &= mask - 1;
+            }
+        }
+#endif
+
+        // Remaining bytes (all of them without SSE2): memchr for the first byte, then compare
+        while (from <= data.size() - length) {
+            const auto* candidate = static_cast<const char*>(memchr(text + from, marker.front(), data.size() - length + 1 - from));
+            if (!candidate)
+                break;
+
+            from = candidate - text;
+            if (memcmp(candidate, marker.data(), length) == 0)
+                return from;
+            ++from;
+        }
+        return std::string_view::npos;
+    }
+
+private:
+    void consume(const size_t size) {
+        m_start += size;
+        m_scan = m_start;
+    }
+
+    static bool isMagicPrefix(const std::string_view data) {
+        char magic[sizeof(uint32_t)];
+        for (size_t i = 0; i < sizeof(magic); ++i)
+            magic[i] = static_cast<char>(PacketHelper::BINARY_MAGIC >> (8 * i));
+        return memcmp(data.data(), magic, data.size()) == 0;
+    }
+
+    size_t m_maxFrameSize;
+    PacketBuffer m_buffer;  // Storage; bytes [m_start, m_end) are received and not handed out yet
+    size_t m_start = 0;     // Start of the first packet not handed out yet
+    size_t m_end = 0;       // End of the received bytes
+    size_t m_scan = 0;      // Where the search for the current text packet's end marker resumes
+    bool m_failed = false;
+};
+
+#endif //FRAMEDECODER_H
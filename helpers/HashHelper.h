@@ -0,0 +1,640 @@
+#ifndef HASHHELPER_H
+#define HASHHELPER_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "PlatformHelper.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HASHHELPER_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define HASHHELPER_ARM_CRC 1
+#include <arm_acle.h>
+#endif
+
+// Portable hash primitives: SHA-256 (single and multi-buffer) for platforms without CryptoAPI
+// and for packet checksums, plus the non-cryptographic CRC32C and XXH3-64.
+// Vector and CRC instructions are used when the CPU has them.
+class HashHelper {
+public:
+    // Incremental SHA-256 (FIPS 180-4)
+    class Sha256 {
+    public:
+        static constexpr size_t DIGEST_SIZE = 32;
+        static constexpr size_t BLOCK_SIZE = 64;
+
+        Sha256() { reset(); }
+
+        void reset() {
+            m_state = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+            m_bufferSize = 0;
+            m_totalBytes = 0;
+        }
+
+        void update(const BYTE* data, size_t size) {
+            m_totalBytes += size;
+
+            // Top up a partially filled block first
+            if (m_bufferSize > 0) {
+                const size_t toCopy = std::min(size, BLOCK_SIZE - m_bufferSize);
+                memcpy(m_buffer.data() + m_bufferSize, data, toCopy);
+                m_bufferSize += toCopy;
+                data += toCopy;
+                size -= toCopy;
+
+                if (m_bufferSize < BLOCK_SIZE)
+                    return;
+
+                transform(m_buffer.data());
+                m_bufferSize = 0;
+            }
+
+            // Process whole blocks straight from the input
+            for (; size >= BLOCK_SIZE; data += BLOCK_SIZE, size -= BLOCK_SIZE)
+                transform(data);
+
+            if (size > 0) {
+                memcpy(m_buffer.data(), data, size);
+                m_bufferSize = size;
+            }
+        }
+
+        std::vector<BYTE> finish() {
+            const uint64_t totalBits = m_totalBytes * 8;
+
+            // Append the 0x80 terminator, pad with zeros and store the message length
+            constexpr BYTE terminator = 0x80;
+            constexpr BYTE zeros[BLOCK_SIZE] = {};
+            update(&terminator, 1);
+            const size_t padding = (m_bufferSize <= 56) ? 56 - m_bufferSize : BLOCK_SIZE + 56 - m_bufferSize;
+            update(zeros, padding);
+
+            BYTE lengthBytes[8];
+            for (int i = 0; i < 8; ++i)
+                lengthBytes[i] = static_cast<BYTE>(totalBits >> (56 - 8 * i));
+            update(lengthBytes, sizeof(lengthBytes));
+
+            std::vector<BYTE> digest(DIGEST_SIZE);
+            for (size_t i = 0; i < m_state.size(); ++i) {
+                digest[i * 4 + 0] = static_cast<BYTE>(m_state[i] >> 24);
+                digest[i * 4 + 1] = static_cast<BYTE>(m_state[i] >> 16);
+                digest[i * 4 + 2] = static_cast<BYTE>(m_state[i] >> 8);
+                digest[i * 4 + 3] = static_cast<BYTE>(m_state[i]);
+            }
+
+            reset();
+            return digest;
+        }
+
+        // Round constants, shared with the multi-buffer kernel
+        static uint32_t roundConstant(const int i) {
+            return K[i];
+        }
+
+    private:
+        std::array<uint32_t, 8> m_state{};
+        std::array<BYTE, BLOCK_SIZE> m_buffer{};
+        size_t m_bufferSize = 0;
+        uint64_t m_totalBytes = 0;
+
+        static constexpr uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+
+        static uint32_t rotr(const uint32_t x, const int n) {
+            return (x >> n) | (x << (32 - n));
+        }
+
+        void transform(const BYTE* block) {
+            uint32_t w[64];
+            for (int i = 0; i < 16; ++i)
+                w[i] = static_cast<uint32_t>(block[i * 4]) << 24 | static_cast<uint32_t>(block[i * 4 + 1]) << 16 |
+                       static_cast<uint32_t>(block[i * 4 + 2]) << 8 | static_cast<uint32_t>(block[i * 4 + 3]);
+
+            for (int i = 16; i < 64; ++i) {
+                const uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                const uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            uint32_t a = m_state[0], b = m_state[1], c = m_state[2], d = m_state[3];
+            uint32_t e = m_state[4], f = m_state[5], g = m_state[6], h = m_state[7];
+
+            for (int i = 0; i < 64; ++i) {
+                const uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+                const uint32_t ch = (e & f) ^ (~e & g);
+                const uint32_t temp1 = h + s1 + ch + K[i] + w[i];
+                const uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+                const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+                const uint32_t temp2 = s0 + maj;
+
+                h = g; g = f; f = e; e = d + temp1;
+                d = c; c = b; b = a; a = temp1 + temp2;
+            }
+
+            m_state[0] += a; m_state[1] += b; m_state[2] += c; m_state[3] += d;
+            m_state[4] += e; m_state[5] += f; m_state[6] += g; m_state[7] += h;
+        }
+    };
+
+    static std::vector<BYTE> sha256(const BYTE* data, const size_t size) {
+        Sha256 hasher;
+        hasher.update(data, size);
+        return hasher.finish();
+    }
+
+    static constexpr size_t SHA256_LANES = 8; // Messages per sha256Many kernel call
+
+    // Hashes `count` independent messages into digests[0..count). With AVX2, eight messages
+    // run through the compression function at once, one per 32-bit lane; equally sized
+    // messages (the chunks of a transfer) keep all lanes busy.
+    static void sha256Many(const BYTE* const* data, const size_t* sizes, const size_t count, std::vector<BYTE>* digests) {
+        size_t done = 0;
+
+#ifdef HASHHELPER_X86
+        if (hasAvx2()) {
+            for (; count - done >= 2; done += std::min(SHA256_LANES, count - done))
+                sha256Avx2(data + done, sizes + done, std::min(SHA256_LANES, count - done), digests + done);
+        }
+#endif
+
+        for (; done < count; ++done)
+            digests[done] = sha256(data[done], sizes[done]);
+    }
+
+    // CRC-32C (Castagnoli), as used by iSCSI and ext4; pass a previous result to continue it
+    static uint32_t crc32c(const BYTE* data, size_t size, uint32_t crc = 0) {
+        crc = ~crc;
+
+#if defined(HASHHELPER_X86)
+        if (hasSse42())
+            return ~crc32cSse42(data, size, crc);
+#elif defined(HASHHELPER_ARM_CRC)
+        for (; size >= 8; data += 8, size -= 8) {
+            uint64_t word;
+            memcpy(&word, data, sizeof(word));
+            crc = __crc32cd(crc, word);
+        }
+        for (; size > 0; ++data, --size)
+            crc = __crc32cb(crc, *data);
+        return ~crc;
+#endif
+
+        const auto& table = crc32cTable();
+        for (; size > 0; ++data, --size)
+            crc = table[(crc ^ *data) & 0xff] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // XXH3-64 with seed 0 and the default secret; matches the reference xxHash implementation
+    static uint64_t xxh3(const BYTE* data, const size_t size) {
+        if (size <= 16) return xxh3UpTo16(data, size);
+        if (size <= 128) return xxh3UpTo128(data, size);
+        if (size <= XXH3_MID_SIZE_MAX) return xxh3UpTo240(data, size);
+
+#ifdef HASHHELPER_X86
+        if (hasAvx2())
+            return xxh3Long(data, size, xxh3AccumulateAvx2, xxh3ScrambleAvx2);
+#endif
+        return xxh3Long(data, size, xxh3AccumulateScalar, xxh3ScrambleScalar);
+    }
+
+private:
+    static constexpr uint64_t PRIME32_1 = 0x9E3779B1U;
+    static constexpr uint64_t PRIME32_2 = 0x85EBCA77U;
+    static constexpr uint64_t PRIME32_3 = 0xC2B2AE3DU;
+    static constexpr uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+    static constexpr size_t XXH3_STRIPE_LEN = 64;
+    static constexpr size_t XXH3_SECRET_SIZE = 192;
+    static constexpr size_t XXH3_MID_SIZE_MAX = 240;
+    static constexpr BYTE XXH3_SECRET[XXH3_SECRET_SIZE] = {
+        0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+        0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+        0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+        0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+        0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+        0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+        0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+        0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+        0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+        0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+        0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+        0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+    };
+
+    // Accumulators: 8 x u64, 32-byte aligned so the vector kernels can load them directly
+    using Xxh3Accumulate = void (*)(uint64_t* acc, const BYTE* input, const BYTE* secret, size_t stripes);
+    using Xxh3Scramble = void (*)(uint64_t* acc, const BYTE* secret);
+
+#ifdef HASHHELPER_X86
+    static bool hasAvx2() {
+        static const bool supported = __builtin_cpu_supports("avx2");
+        return supported;
+    }
+
+    static bool hasSse42() {
+        static const bool supported = __builtin_cpu_supports("sse4.2");
+        return supported;
+    }
+#endif
+
+    static uint32_t readLE32(const BYTE* p) {
+        return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+               static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+    }
+
+    static uint64_t readLE64(const BYTE* p) {
+        return static_cast<uint64_t>(readLE32(p)) | static_cast<uint64_t>(readLE32(p + 4)) << 32;
+    }
+
+    static uint32_t readBE32(const BYTE* p) {
+        return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+               static_cast<uint32_t>(p[2]) << 8 | static_cast<uint32_t>(p[3]);
+    }
+
+    static uint64_t byteSwap64(const uint64_t x) {
+        uint64_t result = 0;
+        for (int i = 0; i < 8; ++i)
+            result |= (x >> (8 * i) & 0xff) << (56 - 8 * i);
+        return result;
+    }
+
+    static uint64_t rotl64(const uint64_t x, const int n) {
+        return (x << n) | (x >> (64 - n));
+    }
+
+    // ---- CRC32C ----
+
+    static const std::array<uint32_t, 256>& crc32cTable() {
+        static constexpr std::array<uint32_t, 256> table = [] {
+            std::array<uint32_t, 256> result{};
+            for (uint32_t i = 0; i < 256; ++i) {
+                uint32_t crc = i;
+                for (int bit = 0; bit < 8; ++bit)
+                    crc = (crc >> 1) ^ (0x82F63B78U & (0U - (crc & 1)));
+                result[i] = crc;
+            }
+            return result;
+        }();
+        return table;
+    }
+
+#ifdef HASHHELPER_X86
+    __attribute__((target("sse4.2")))
+    static uint32_t crc32cSse42(const BYTE* data, size_t size, uint32_t crc) {
+#ifdef __x86_64__
+        uint64_t crc64 = crc;
+        for (; size >= 8; data += 8, size -= 8) {
+            uint64_t word;
+            memcpy(&word, data, sizeof(word));
+            crc64 = _mm_crc32_u64(crc64, word);
+        }
+        crc = static_cast<uint32_t>(crc64);
+#endif
+        for (; size >= 4; data += 4, size -= 4) {
+            uint32_t word;
+            memcpy(&word, data, sizeof(word));
+            crc = _mm_crc32_u32(crc, word);
+        }
+        for (; size > 0; ++data, --size)
+            crc = _mm_crc32_u8(crc, *data);
+        return crc;
+    }
+#endif
+
+    // ---- XXH3-64 ----
+
+    static uint64_t mul128Fold64(const uint64_t lhs, const uint64_t rhs) {
+#ifdef __SIZEOF_INT128__
+        const unsigned __int128 product = static_cast<unsigned __int128>(lhs) * rhs;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+        const uint64_t loLo = (lhs & 0xffffffff) * (rhs & 0xffffffff);
+        const uint64_t hiLo = (lhs >> 32) * (rhs & 0xffffffff);
+        const uint64_t loHi = (lhs & 0xffffffff) * (rhs >> 32);
+        const uint64_t hiHi = (lhs >> 32) * (rhs >> 32);
+        const uint64_t cross = (loLo >> 32) + (hiLo & 0xffffffff) + loHi;
+        const uint64_t upper = (hiLo >> 32) + (cross >> 32) + hiHi;
+        const uint64_t lower = (cross << 32) | (loLo & 0xffffffff);
+        return lower ^ upper;
+#endif
+    }
+
+    static uint64_t xxh64Avalanche(uint64_t h) {
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        return h ^ (h >> 32);
+    }
+
+    static uint64_t xxh3Avalanche(uint64_t h) {
+        h ^= h >> 37;
+        h *= 0x165667919E3779F9ULL;
+        return h ^ (h >> 32);
+    }
+
+    static uint64_t xxh3Rrmxmx(uint64_t h, const uint64_t length) {
+        h ^= rotl64(h, 49) ^ rotl64(h, 24);
+        h *= 0x9FB21C651E98DF25ULL;
+        h ^= (h >> 35) + length;
+        h *= 0x9FB21C651E98DF25ULL;
+        return h ^ (h >> 28);
+    }
+
+    static uint64_t xxh3Mix16(const BYTE* input, const BYTE* secret) {
+        return mul128Fold64(readLE64(input) ^ readLE64(secret), readLE64(input + 8) ^ readLE64(secret + 8));
+    }
+
+    static uint64_t xxh3UpTo16(const BYTE* data, const size_t size) {
+        const BYTE* secret = XXH3_SECRET;
+
+        if (size > 8) {
+            const uint64_t low = readLE64(data) ^ (readLE64(secret + 24) ^ readLE64(secret + 32));
+            const uint64_t high = readLE64(data + size - 8) ^ (readLE64(secret + 40) ^ readLE64(secret + 48));
+            return xxh3Avalanche(size + byteSwap64(low) + high + mul128Fold64(low, high));
+        }
+
+        if (size >= 4) {
+            const uint64_t input = readLE32(data + size - 4) + (static_cast<uint64_t>(readLE32(data)) << 32);
+            return xxh3Rrmxmx(input ^ (readLE64(secret + 8) ^ readLE64(secret + 16)), size);
+        }
+
+        if (size > 0) {
+            const uint32_t combined = static_cast<uint32_t>(data[0]) << 16 | static_cast<uint32_t>(data[size >> 1]) << 24 |
+                                      static_cast<uint32_t>(data[size - 1]) | static_cast<uint32_t>(size) << 8;
+            return xxh64Avalanche(combined ^ static_cast<uint64_t>(readLE32(secret) ^ readLE32(secret + 4)));
+        }
+
+        return xxh64Avalanche(readLE64(secret + 56) ^ readLE64(secret + 64));
+    }
+
+    static uint64_t xxh3UpTo128(const BYTE* data, const size_t size) {
+        const BYTE* secret = XXH3_SECRET;
+        uint64_t acc = size * PRIME64_1;
+
+        if (size > 32) {
+            if (size > 64) {
+                if (size > 96) {
+                    acc += xxh3Mix16(data + 48, secret + 96);
+                    acc += xxh3Mix16(data + size - 64, secret + 112);
+                }
+                acc += xxh3Mix16(data + 32, secret + 64);
+                acc += xxh3Mix16(data + size - 48, secret + 80);
+            }
+            acc += xxh3Mix16(data + 16, secret + 32);
+            acc += xxh3Mix16(data + size - 32, secret + 48);
+        }
+        acc += xxh3Mix16(data, secret);
+        acc += xxh3Mix16(data + size - 16, secret + 16);
+
+        return xxh3Avalanche(acc);
+    }
+
+    static uint64_t xxh3UpTo240(const BYTE* data, const size_t size) {
+        const BYTE* secret = XXH3_SECRET;
+        uint64_t acc = size * PRIME64_1;
+        const size_t rounds = size / 16;
+
+        for (size_t i = 0; i < 8; ++i)
+            acc += xxh3Mix16(data + 16 * i, secret + 16 * i);
+        acc = xxh3Avalanche(acc);
+
+        for (size_t i = 8; i < rounds; ++i)
+            acc += xxh3Mix16(data + 16 * i, secret + 16 * (i - 8) + 3);
+        acc += xxh3Mix16(data + size - 16, secret + 136 - 17);
+
+        return xxh3Avalanche(acc);
+    }
+
+    static void xxh3AccumulateScalar(uint64_t* acc, const BYTE* input, const BYTE* secret, const size_t stripes) {
+        for (size_t stripe = 0; stripe < stripes; ++stripe, input += XXH3_STRIPE_LEN, secret += 8) {
+            for (size_t i = 0; i < 8; ++i) {
+                const uint64_t value = readLE64(input + 8 * i);
+                const uint64_t key = value ^ readLE64(secret + 8 * i);
+                acc[i ^ 1] += value;
+                acc[i] += (key & 0xffffffff) * (key >> 32);
+            }
+        }
+    }
+
+    static void xxh3ScrambleScalar(uint64_t* acc, const BYTE* secret) {
+        for (size_t i = 0; i < 8; ++i) {
+            uint64_t value = acc[i];
+            value ^= value >> 47;
+            value ^= readLE64(secret + 8 * i);
+            acc[i] = value * PRIME32_1;
+        }
+    }
+
+#ifdef HASHHELPER_X86
+    // Half a stripe: four accumulators
+    __attribute__((target("avx2")))
+    static __m256i xxh3Accumulate256Avx2(const __m256i acc, const BYTE* input, const BYTE* secret) {
+        const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input));
+        const __m256i keyed = _mm256_xor_si256(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret)));
+        const __m256i product = _mm256_mul_epu32(keyed, _mm256_srli_epi64(keyed, 32));
+        const __m256i swapped = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+        return _mm256_add_epi64(_mm256_add_epi64(acc, swapped), product);
+    }
+
+    __attribute__((target("avx2")))
+    static void xxh3AccumulateAvx2(uint64_t* acc, const BYTE* input, const BYTE* secret, const size_t stripes) {
+        auto* accVec = reinterpret_cast<__m256i*>(acc);
+        __m256i acc0 = _mm256_load_si256(accVec);
+        __m256i acc1 = _mm256_load_si256(accVec + 1);
+
+        for (size_t stripe = 0; stripe < stripes; ++stripe, input += XXH3_STRIPE_LEN, secret += 8) {
+            acc0 = xxh3Accumulate256Avx2(acc0, input, secret);
+            acc1 = xxh3Accumulate256Avx2(acc1, input + 32, secret + 32);
+        }
+
+        _mm256_store_si256(accVec, acc0);
+        _mm256_store_si256(accVec + 1, acc1);
+    }
+
+    __attribute__((target("avx2")))
+    static void xxh3ScrambleAvx2(uint64_t* acc, const BYTE* secret) {
+        auto* accVec = reinterpret_cast<__m256i*>(acc);
+        const __m256i prime = _mm256_set1_epi32(static_cast<int>(PRIME32_1));
+
+        for (int i = 0; i < 2; ++i) {
+            __m256i value = _mm256_load_si256(accVec + i);
+            value = _mm256_xor_si256(value, _mm256_srli_epi64(value, 47));
+            value = _mm256_xor_si256(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret + 32 * i)));
+
+            // 64 x 32-bit multiply from two 32 x 32 -> 64 products
+            const __m256i low = _mm256_mul_epu32(value, prime);
+            const __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(value, 32), prime);
+            _mm256_store_si256(accVec + i, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+        }
+    }
+#endif
+
+    static uint64_t xxh3Long(const BYTE* data, const size_t size, const Xxh3Accumulate accumulate, const Xxh3Scramble scramble) {
+        const BYTE* secret = XXH3_SECRET;
+        alignas(32) uint64_t acc[8] = {
+            PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+        };
+
+        constexpr size_t stripesPerBlock = (XXH3_SECRET_SIZE - XXH3_STRIPE_LEN) / 8;
+        constexpr size_t blockLength = XXH3_STRIPE_LEN * stripesPerBlock;
+        const size_t blocks = (size - 1) / blockLength;
+
+        for (size_t block = 0; block < blocks; ++block) {
+            accumulate(acc, data + block * blockLength, secret, stripesPerBlock);
+            scramble(acc, secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN);
+        }
+
+        // Remaining whole stripes, then the last 64 bytes with their own secret offset
+        const size_t stripes = ((size - 1) - blockLength * blocks) / XXH3_STRIPE_LEN;
+        accumulate(acc, data + blocks * blockLength, secret, stripes);
+        accumulate(acc, data + size - XXH3_STRIPE_LEN, secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN - 7, 1);
+
+        uint64_t result = size * PRIME64_1;
+        for (size_t i = 0; i < 4; ++i)
+            result += mul128Fold64(acc[2 * i] ^ readLE64(secret + 11 + 16 * i), acc[2 * i + 1] ^ readLE64(secret + 11 + 16 * i + 8));
+        return xxh3Avalanche(result);
+    }
+
+    // ---- Multi-buffer SHA-256 ----
+
+#ifdef HASHHELPER_X86
+    __attribute__((target("avx2")))
+    static __m256i rotr8x32(const __m256i x, const int n) {
+        return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+    }
+
+    __attribute__((target("avx2")))
+    static void sha256Avx2(const BYTE* const* data, const size_t* sizes, const size_t lanes, std::vector<BYTE>* digests) {
+        static constexpr uint32_t INITIAL[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+
+        // Each lane walks its message's whole blocks in place, then one or two padded tail blocks
+        BYTE tails[SHA256_LANES][2 * Sha256::BLOCK_SIZE] = {};
+        size_t wholeBlocks[SHA256_LANES] = {};
+        size_t totalBlocks[SHA256_LANES] = {};
+        size_t maxBlocks = 0;
+
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            const size_t size = sizes[lane];
+            const size_t tailBytes = size % Sha256::BLOCK_SIZE;
+            const size_t tailBlocks = tailBytes + 9 <= Sha256::BLOCK_SIZE ? 1 : 2;
+
+            wholeBlocks[lane] = size / Sha256::BLOCK_SIZE;
+            totalBlocks[lane] = wholeBlocks[lane] + tailBlocks;
+            maxBlocks = std::max(maxBlocks, totalBlocks[lane]);
+
+            BYTE* tail = tails[lane];
+            if (tailBytes > 0)
+                memcpy(tail, data[lane] + wholeBlocks[lane] * Sha256::BLOCK_SIZE, tailBytes);
+            tail[tailBytes] = 0x80;
+
+            const uint64_t totalBits = static_cast<uint64_t>(size) * 8;
+            BYTE* length = tail + tailBlocks * Sha256::BLOCK_SIZE - 8;
+            for (int i = 0; i < 8; ++i)
+                length[i] = static_cast<BYTE>(totalBits >> (56 - 8 * i));
+        }
+
+        __m256i state[8];
+        for (int i = 0; i < 8; ++i)
+            state[i] = _mm256_set1_epi32(static_cast<int>(INITIAL[i]));
+
+        for (size_t block = 0; block < maxBlocks; ++block) {
+            // Lanes that already finished hash their tail again; their digest was taken earlier
+            const BYTE* blocks[SHA256_LANES];
+            for (size_t lane = 0; lane < SHA256_LANES; ++lane) {
+                if (lane < lanes && block < wholeBlocks[lane])
+                    blocks[lane] = data[lane] + block * Sha256::BLOCK_SIZE;
+                else if (lane < lanes && block < totalBlocks[lane])
+                    blocks[lane] = tails[lane] + (block - wholeBlocks[lane]) * Sha256::BLOCK_SIZE;
+                else
+                    blocks[lane] = tails[lane];
+            }
+
+            __m256i w[16];
+            for (int i = 0; i < 16; ++i) {
+                w[i] = _mm256_setr_epi32(
+                    static_cast<int>(readBE32(blocks[0] + 4 * i)), static_cast<int>(readBE32(blocks[1] + 4 * i)),
+                    static_cast<int>(readBE32(blocks[2] + 4 * i)), static_cast<int>(readBE32(blocks[3] + 4 * i)),
+                    static_cast<int>(readBE32(blocks[4] + 4 * i)), static_cast<int>(readBE32(blocks[5] + 4 * i)),
+                    static_cast<int>(readBE32(blocks[6] + 4 * i)), static_cast<int>(readBE32(blocks[7] + 4 * i)));
+            }
+
+            __m256i a = state[0], b = state[1], c = state[2], d = state[3];
+            __m256i e = state[4], f = state[5], g = state[6], h = state[7];
+
+            for (int i = 0; i < 64; ++i) {
+                // Message schedule in a rolling window of 16 words
+                if (i >= 16) {
+                    const __m256i w15 = w[(i - 15) & 15];
+                    const __m256i w2 = w[(i - 2) & 15];
+                    const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr8x32(w15, 7), rotr8x32(w15, 18)), _mm256_srli_epi32(w15, 3));
+                    const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr8x32(w2, 17), rotr8x32(w2, 19)), _mm256_srli_epi32(w2, 10));
+                    w[i & 15] = _mm256_add_epi32(_mm256_add_epi32(w[i & 15], s0), _mm256_add_epi32(w[(i - 7) & 15], s1));
+                }
+
+                const __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr8x32(e, 6), rotr8x32(e, 11)), rotr8x32(e, 25));
+                const __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+                const __m256i temp1 = _mm256_add_epi32(
+                    _mm256_add_epi32(_mm256_add_epi32(h, s1), _mm256_add_epi32(ch, w[i & 15])),
+                    _mm256_set1_epi32(static_cast<int>(Sha256::roundConstant(i))));
+                const __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr8x32(a, 2), rotr8x32(a, 13)), rotr8x32(a, 22));
+                const __m256i maj = _mm256_xor_si256(_mm256_and_si256(a, _mm256_xor_si256(b, c)), _mm256_and_si256(b, c));
+                const __m256i temp2 = _mm256_add_epi32(s0, maj);
+
+                h = g; g = f; f = e; e = _mm256_add_epi32(d, temp1);
+                d = c; c = b; b = a; a = _mm256_add_epi32(temp1, temp2);
+            }
+
+            state[0] = _mm256_add_epi32(state[0], a); state[1] = _mm256_add_epi32(state[1], b);
+            state[2] = _mm256_add_epi32(state[2], c); state[3] = _mm256_add_epi32(state[3], d);
+            state[4] = _mm256_add_epi32(state[4], e); state[5] = _mm256_add_epi32(state[5], f);
+            state[6] = _mm256_add_epi32(state[6], g); state[7] = _mm256_add_epi32(state[7], h);
+
+            // Take the digest of every lane whose message ends with this block
+            alignas(32) uint32_t words[8][SHA256_LANES];
+            bool extracted = false;
+            for (size_t lane = 0; lane < lanes; ++lane) {
+                if (totalBlocks[lane] != block + 1)
+                    continue;
+
+                if (!extracted) {
+                    for (int i = 0; i < 8; ++i)
+                        _mm256_store_si256(reinterpret_cast<__m256i*>(words[i]), state[i]);
+                    extracted = true;
+                }
+
+                std::vector<BYTE>& digest = digests[lane];
+                digest.resize(Sha256::DIGEST_SIZE);
+                for (int i = 0; i < 8; ++i) {
+                    digest[i * 4 + 0] = static_cast<BYTE>(words[i][lane] >> 24);
+                    digest[i * 4 + 1] = static_cast<BYTE>(words[i][lane] >> 16);
+                    digest[i * 4 + 2] = static_cast<BYTE>(words[i][lane] >> 8);
+                    digest[i * 4 + 3] = static_cast<BYTE>(words[i][lane]);
+                }
+            }
+        }
+    }
+#endif
+};
+
+#endif //HASHHELPER_H
@@ -0,0 +1,396 @@
+#ifndef HEXHELPER_H
+#define HEXHELPER_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "PlatformHelper.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define HEXHELPER_X86 1
+#include <immintrin.h>
+#endif
+
+// Encoder/decoder for the "[ 0xNN 0xNN ... ]" byte lists of the text protocol.
+// Each byte takes exactly 5 characters ("0xNN "), so 16 bytes map to 80 characters and
+// the vector kernels can work on fixed blocks with precomputed shuffle masks.
+// The widest instruction set supported by the CPU is picked at runtime.
+class HexHelper {
+public:
+    enum class Isa {
+        Scalar,
+        Ssse3, // pshufb is required to interleave the "0x" and " " around the digits
+        Avx2
+    };
+
+    static Isa bestIsa() {
+        static const Isa isa = detectIsa();
+        return isa;
+    }
+
+    static bool isSupported(const Isa isa) {
+        switch (isa) {
+            case Isa::Avx2: return bestIsa() == Isa::Avx2;
+            case Isa::Ssse3: return bestIsa() != Isa::Scalar;
+            default: return true;
+        }
+    }
+
+    static const char* isaName(const Isa isa) {
+        switch (isa) {
+            case Isa::Avx2: return "avx2";
+            case Isa::Ssse3: return "ssse3";
+            default: return "scalar";
+        }
+    }
+
+    static std::string encode(const std::vector<BYTE>& bytes) {
+        return encode(bytes.data(), bytes.size(), bestIsa());
+    }
+
+    static std::string encode(const BYTE* data, const size_t size, const Isa isa) {
+        std::string text(2 + size * TOKEN_SIZE + 1, ' ');
+        text.front() = '[';
+        text.back() = ']';
+
+        char* out = text.data() + 2;
+        size_t done = 0;
+
+#ifdef HEXHELPER_X86
+        if (isa == Isa::Avx2)
+            done = encodeAvx2(data, size, out);
+        else if (isa == Isa::Ssse3)
+            done = encodeSsse3(data, size, out);
+#endif
+
+        encodeScalar(data + done, size - done, out + done * TOKEN_SIZE);
+        return text;
+    }
+
+    static std::vector<BYTE> decode(const std::string_view text) {
+        return decode(text, bestIsa());
+    }
+
+    // Accepts everything the old stringstream parser did: the first two characters are skipped,
+    // whitespace separated tokens not starting with "0x" are ignored and a trailing ']' is dropped.
+    // Well-formed blocks of "0xNN " go through the vector kernels, anything else through the tokenizer.
+    static std::vector<BYTE> decode(const std::string_view text, const Isa isa) {
+        std::vector<BYTE> bytes;
+        size_t pos = std::min<size_t>(2, text.size()); // Skip "[ "
+        size_t count = 0;
+
+#ifdef HEXHELPER_X86
+        if (isa != Isa::Scalar && text.size() - pos >= BLOCK_CHARS) {
+            bytes.resize((text.size() - pos) / TOKEN_SIZE);
+            BYTE* out = bytes.data();
+
+            if (isa == Isa::Avx2) {
+                while (text.size() - pos >= 2 * BLOCK_CHARS && decodeBlocksAvx2(text.data() + pos, out + count)) {
+                    pos += 2 * BLOCK_CHARS;
+                    count += 2 * BLOCK_BYTES;
+                }
+            }
+
+            while (text.size() - pos >= BLOCK_CHARS && decodeBlockSsse3(text.data() + pos, out + count)) {
+                pos += BLOCK_CHARS;
+                count += BLOCK_BYTES;
+            }
+
+            bytes.resize(count);
+        }
+#endif
+
+        decodeTokens(text, pos, bytes);
+        return bytes;
+    }
+
+private:
+    static constexpr size_t TOKEN_SIZE = 5;   // "0xNN "
+    static constexpr size_t BLOCK_BYTES = 16;
+    static constexpr size_t BLOCK_CHARS = BLOCK_BYTES * TOKEN_SIZE;
+    static constexpr char DIGITS[] = "0123456789abcdef";
+
+    using Mask = std::array<int8_t, 16>;
+    using BlockMasks = std::array<Mask, TOKEN_SIZE>;
+
+    static Isa detectIsa() {
+#ifdef HEXHELPER_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return Isa::Avx2;
+        if (__builtin_cpu_supports("ssse3")) return Isa::Ssse3;
+#endif
+        return Isa::Scalar;
+    }
+
+    static void encodeScalar(const BYTE* data, const size_t size, char* out) {
+        for (size_t i = 0; i < size; ++i, out += TOKEN_SIZE) {
+            out[0] = '0';
+            out[1] = 'x';
+            out[2] = DIGITS[data[i] >> 4];
+            out[3] = DIGITS[data[i] & 0x0F];
+        }
+    }
+
+    static int hexValue(const char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static bool isSpace(const char c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    static void decodeTokens(const std::string_view text, size_t pos, std::vector<BYTE>& bytes) {
+        bytes.reserve(bytes.size() + (text.size() - pos) / TOKEN_SIZE);
+
+        while (pos < text.size()) {
+            while (pos < text.size() && isSpace(text[pos])) ++pos;
+            const size_t start = pos;
+            while (pos < text.size() && !isSpace(text[pos])) ++pos;
+
+            std::string_view token = text.substr(start, pos - start);
+            if (!token.empty() && token.back() == ']') token.remove_suffix(1);
+            if (token.size() < 2 || token[0] != '0' || token[1] != 'x') continue;
+
+            // std::hex also takes an optional base prefix after the one checked above
+            token.remove_prefix(2);
+            if (token.size() >= 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X'))
+                token.remove_prefix(2);
+
+            unsigned value = 0;
+            size_t digits = 0;
+            for (; digits < token.size() && hexValue(token[digits]) >= 0; ++digits)
+                value = value << 4 | hexValue(token[digits]);
+
+            if (digits > 0)
+                bytes.push_back(static_cast<BYTE>(value));
+        }
+    }
+
+    // Encoder: for each 16 character output chunk, which hex digit of the window goes where (-128 = none)
+    static constexpr BlockMasks makeEncodeShuffles() {
+        BlockMasks masks{};
+        for (size_t k = 0; k < TOKEN_SIZE; ++k) {
+            const size_t window = 2 * (16 * k / TOKEN_SIZE);
+            for (size_t j = 0; j < 16; ++j) {
+                const size_t p = 16 * k + j;
+                const size_t r = p % TOKEN_SIZE;
+                masks[k][j] = r == 2 || r == 3 ? static_cast<int8_t>(2 * (p / TOKEN_SIZE) + (r - 2) - window) : -128;
+            }
+        }
+        return masks;
+    }
+
+    // Fixed characters of each chunk ('0', 'x', ' '), zero where a digit goes
+    static constexpr BlockMasks makeTemplates() {
+        BlockMasks masks{};
+        for (size_t k = 0; k < TOKEN_SIZE; ++k) {
+            for (size_t j = 0; j < 16; ++j) {
+                const size_t r = (16 * k + j) % TOKEN_SIZE;
+                masks[k][j] = r == 0 ? '0' : r == 1 ? 'x' : r == 4 ? ' ' : 0;
+            }
+        }
+        return masks;
+    }
+
+    // Decoder: which positions of each input chunk hold digits
+    static constexpr BlockMasks makeDigitPositions() {
+        BlockMasks masks{};
+        for (size_t k = 0; k < TOKEN_SIZE; ++k) {
+            for (size_t j = 0; j < 16; ++j) {
+                const size_t r = (16 * k + j) % TOKEN_SIZE;
+                masks[k][j] = r == 2 || r == 3 ? -1 : 0;
+            }
+        }
+        return masks;
+    }
+
+    // Decoder: output byte i is read from position 5i+2 of whichever chunk contains it
+    static constexpr BlockMasks makeDecodeGathers() {
+        BlockMasks masks{};
+        for (size_t k = 0; k < TOKEN_SIZE; ++k) {
+            for (size_t i = 0; i < BLOCK_BYTES; ++i) {
+                const size_t p = TOKEN_SIZE * i + 2;
+                masks[k][i] = p / 16 == k ? static_cast<int8_t>(p % 16) : -128;
+            }
+        }
+        return masks;
+    }
+
+    // Tables are built at compile time; member functions see the complete class
+    static const BlockMasks& encodeShuffles() { static constexpr BlockMasks masks = makeEncodeShuffles(); return masks; }
+    static const BlockMasks& templates() { static constexpr BlockMasks masks = makeTemplates(); return masks; }
+    static const BlockMasks& digitPositions() { static constexpr BlockMasks masks = makeDigitPositions(); return masks; }
+    static const BlockMasks& decodeGathers() { static constexpr BlockMasks masks = makeDecodeGathers(); return masks; }
+
+#ifdef HEXHELPER_X86
+    __attribute__((target("sse2")))
+    static __m128i loadMask(const Mask& mask) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask.data()));
+    }
+
+    __attribute__((target("ssse3")))
+    static size_t encodeSsse3(const BYTE* data, const size_t size, char* out) {
+        const __m128i digits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(DIGITS));
+        const __m128i lowNibble = _mm_set1_epi8(0x0F);
+
+        size_t i = 0;
+        for (; i + BLOCK_BYTES <= size; i += BLOCK_BYTES, out += BLOCK_CHARS) {
+            const __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const __m128i high = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(input, 4), lowNibble));
+            const __m128i low = _mm_shuffle_epi8(digits, _mm_and_si128(input, lowNibble));
+
+            // Digit stream of the 16 bytes, split in two halves
+            const __m128i first = _mm_unpacklo_epi8(high, low);
+            const __m128i second = _mm_unpackhi_epi8(high, low);
+
+            // 16 digit window starting at the first byte of each output chunk
+            const __m128i windows[TOKEN_SIZE] = {
+                first,
+                _mm_alignr_epi8(second, first, 6),
+                _mm_alignr_epi8(second, first, 12),
+                _mm_srli_si128(second, 2),
+                _mm_srli_si128(second, 8)
+            };
+
+            for (size_t k = 0; k < TOKEN_SIZE; ++k) {
+                const __m128i chunk = _mm_or_si128(_mm_shuffle_epi8(windows[k], loadMask(encodeShuffles()[k])), loadMask(templates()[k]));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * k), chunk);
+            }
+        }
+
+        return i;
+    }
+
+    // Same as encodeSsse3, with one 16 byte block per 128-bit lane
+    __attribute__((target("avx2")))
+    static size_t encodeAvx2(const BYTE* data, const size_t size, char* out) {
+        const __m256i digits = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(DIGITS)));
+        const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+
+        size_t i = 0;
+        for (; i + 2 * BLOCK_BYTES <= size; i += 2 * BLOCK_BYTES, out += 2 * BLOCK_CHARS) {
+            const __m256i input = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+            const __m256i high = _mm256_shuffle_epi8(digits, _mm256_and_si256(_mm256_srli_epi16(input, 4), lowNibble));
+            const __m256i low = _mm256_shuffle_epi8(digits, _mm256_and_si256(input, lowNibble));
+
+            const __m256i first = _mm256_unpacklo_epi8(high, low);
+            const __m256i second = _mm256_unpackhi_epi8(high, low);
+
+            const __m256i windows[TOKEN_SIZE] = {
+                first,
+                _mm256_alignr_epi8(second, first, 6),
+                _mm256_alignr_epi8(second, first, 12),
+                _mm256_srli_si256(second, 2),
+                _mm256_srli_si256(second, 8)
+            };
+
+            for (size_t k = 0; k < TOKEN_SIZE; ++k) {
+                const __m256i shuffle = _mm256_broadcastsi128_si256(loadMask(encodeShuffles()[k]));
+                const __m256i fixed = _mm256_broadcastsi128_si256(loadMask(templates()[k]));
+                const __m256i chunk = _mm256_or_si256(_mm256_shuffle_epi8(windows[k], shuffle), fixed);
+
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16 * k), _mm256_castsi256_si128(chunk));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + BLOCK_CHARS + 16 * k), _mm256_extracti128_si256(chunk, 1));
+            }
+        }
+
+        return i;
+    }
+
+    // Turn 16 characters into nibble values; `valid` flags characters matching the expected layout
+    __attribute__((target("ssse3")))
+    static __m128i nibblesSsse3(const __m128i chars, const size_t k, __m128i& valid) {
+        const __m128i digit = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+        const __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit);
+        const __m128i alpha = _mm_sub_epi8(_mm_or_si128(chars, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+        const __m128i isAlpha = _mm_cmpeq_epi8(_mm_min_epu8(alpha, _mm_set1_epi8(5)), alpha);
+
+        const __m128i positions = loadMask(digitPositions()[k]);
+        valid = _mm_or_si128(
+            _mm_and_si128(positions, _mm_or_si128(isDigit, isAlpha)),
+            _mm_andnot_si128(positions, _mm_cmpeq_epi8(chars, loadMask(templates()[k]))));
+
+        const __m128i value = _mm_or_si128(
+            _mm_and_si128(isDigit, digit),
+            _mm_and_si128(isAlpha, _mm_add_epi8(alpha, _mm_set1_epi8(10))));
+        return _mm_and_si128(value, positions);
+    }
+
+    __attribute__((target("ssse3")))
+    static bool decodeBlockSsse3(const char* text, BYTE* out) {
+        __m128i nibbles[TOKEN_SIZE];
+        __m128i valid = _mm_set1_epi8(-1);
+
+        for (size_t k = 0; k < TOKEN_SIZE; ++k) {
+            __m128i chunkValid;
+            nibbles[k] = nibblesSsse3(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 16 * k)), k, chunkValid);
+            valid = _mm_and_si128(valid, chunkValid);
+        }
+
+        if (_mm_movemask_epi8(valid) != 0xFFFF)
+            return false;
+
+        // byte[p] = nibble[p] << 4 | nibble[p + 1], then pick p = 5i + 2 out of every chunk
+        __m128i result = _mm_setzero_si128();
+        for (size_t k = 0; k < TOKEN_SIZE; ++k) {
+            const __m128i next = k + 1 < TOKEN_SIZE ? _mm_alignr_epi8(nibbles[k + 1], nibbles[k], 1) : _mm_srli_si128(nibbles[k], 1);
+            const __m128i bytes = _mm_or_si128(_mm_slli_epi16(nibbles[k], 4), next);
+            result = _mm_or_si128(result, _mm_shuffle_epi8(bytes, loadMask(decodeGathers()[k])));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), result);
+        return true;
+    }
+
+    // Two consecutive blocks, one per 128-bit lane
+    __attribute__((target("avx2")))
+    static bool decodeBlocksAvx2(const char* text, BYTE* out) {
+        __m256i nibbles[TOKEN_SIZE];
+        __m256i valid = _mm256_set1_epi8(-1);
+
+        for (size_t k = 0; k < TOKEN_SIZE; ++k) {
+            const __m256i chars = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 16 * k))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + BLOCK_CHARS + 16 * k)), 1);
+
+            const __m256i digit = _mm256_sub_epi8(chars, _mm256_set1_epi8('0'));
+            const __m256i isDigit = _mm256_cmpeq_epi8(_mm256_min_epu8(digit, _mm256_set1_epi8(9)), digit);
+            const __m256i alpha = _mm256_sub_epi8(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)), _mm256_set1_epi8('a'));
+            const __m256i isAlpha = _mm256_cmpeq_epi8(_mm256_min_epu8(alpha, _mm256_set1_epi8(5)), alpha);
+
+            const __m256i positions = _mm256_broadcastsi128_si256(loadMask(digitPositions()[k]));
+            const __m256i fixed = _mm256_broadcastsi128_si256(loadMask(templates()[k]));
+            valid = _mm256_and_si256(valid, _mm256_or_si256(
+                _mm256_and_si256(positions, _mm256_or_si256(isDigit, isAlpha)),
+                _mm256_andnot_si256(positions, _mm256_cmpeq_epi8(chars, fixed))));
+
+            const __m256i value = _mm256_or_si256(
+                _mm256_and_si256(isDigit, digit),
+                _mm256_and_si256(isAlpha, _mm256_add_epi8(alpha, _mm256_set1_epi8(10))));
+            nibbles[k] = _mm256_and_si256(value, positions);
+        }
+
+        if (_mm256_movemask_epi8(valid) != -1)
+            return false;
+
+        __m256i result = _mm256_setzero_si256();
+        for (size_t k = 0; k < TOKEN_SIZE; ++k) {
+            const __m256i next = k + 1 < TOKEN_SIZE ? _mm256_alignr_epi8(nibbles[k + 1], nibbles[k], 1) : _mm256_srli_si256(nibbles[k], 1);
+            const __m256i bytes = _mm256_or_si256(_mm256_slli_epi16(nibbles[k], 4), next);
+            result = _mm256_or_si256(result, _mm256_shuffle_epi8(bytes, _mm256_broadcastsi128_si256(loadMask(decodeGathers()[k]))));
+        }
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), result);
+        return true;
+    }
+#endif
+};
+
+#endif //HEXHELPER_H
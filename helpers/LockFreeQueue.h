@@ -0,0 +1,48 @@
+#ifndef LOCKFREEQUEUE_H
+#define LOCKFREEQUEUE_H
+
+#include <atomic>
+
+// Intrusive queue that any number of threads push to and take from without a lock: items are
+// linked through their `next` member onto an atomic list head, and a consumer takes the whole
+// list at once and gets it back in push order. Taking everything in one exchange is what keeps
+// it free of ABA; a consumer that wants one item at a time keeps the rest itself. Operations are
+// sequentially consistent, so a consumer that clears a flag before taking and a producer that sets
+// it after pushing cannot both miss each other.
+template <typename T>
+class LockFreeQueue {
+public:
+    LockFreeQueue() = default;
+    LockFreeQueue(const LockFreeQueue&) = delete;
+    LockFreeQueue& operator=(const LockFreeQueue&) = delete;
+
+    void push(T* item) {
+        item->next = m_head.load(std::memory_order_relaxed);
+        while (!m_head.compare_exchange_weak(item->next, item)) {
+        }
+    }
+
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == nullptr;
+    }
+
+    // Every item pushed so far, oldest first, linked through `next`; nullptr if there are none
+    T* takeAll() {
+        T* item = m_head.exchange(nullptr);
+
+        // The list is newest first; reverse it
+        T* oldest = nullptr;
+        while (item) {
+            T* next = item->next;
+            item->next = oldest;
+            oldest = item;
+            item = next;
+        }
+        return oldest;
+    }
+
+private:
+    std::atomic<T*> m_head{nullptr};
+};
+
+#endif //LOCKFREEQUEUE_H
@@ -0,0 +1,306 @@
+#ifndef MEMORYPOOL_H
+#define MEMORYPOOL_H
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Intrusive LIFO of free blocks, linked through the first bytes of the blocks themselves
+class FreeList {
+public:
+    bool empty() const { return m_head == nullptr; }
+    size_t size() const { return m_size; }
+
+    void push(void* block) {
+        *static_cast<void**>(block) = m_head;
+        m_head = block;
+        ++m_size;
+    }
+
+    void* pop() {
+        void* block = m_head;
+        m_head = *static_cast<void**>(block);
+        --m_size;
+        return block;
+    }
+
+    // Move up to `count` blocks onto `other`; returns how many moved
+    size_t moveTo(FreeList& other, const size_t count) {
+        size_t moved = 0;
+        for (; moved < count && m_head; ++moved)
+            other.push(pop());
+        return moved;
+    }
+
+private:
+    void* m_head = nullptr;
+    size_t m_size = 0;
+};
+
+// Objects of one type carved out of slabs of SLAB_OBJECTS, for objects created and destroyed at
+// a high rate (one per connection). A freed object goes to a per-thread cache and the caches
+// trade with a shared free list in batches, so once the pool has grown to the peak number of
+// live objects, creating and destroying them neither allocates nor usually takes the lock.
+// Slabs are only given back to the heap with the pool.
+template <typename T, size_t SLAB_OBJECTS = 64>
+class SlabPool {
+public:
+    static constexpr size_t THREAD_CACHE_OBJECTS = 32;
+
+    static SlabPool& instance() {
+        static SlabPool pool;
+        return pool;
+    }
+
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    ~SlabPool() {
+        for (void* slab : m_slabs)
+            ::operator delete(slab, std::align_val_t(BLOCK_ALIGN));
+    }
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+        void* block = allocate();
+        try {
+            return new (block) T(std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate(block);
+            throw;
+        }
+    }
+
+    void destroy(T* object) {
+        if (!object)
+            return;
+        object->~T();
+        deallocate(object);
+    }
+
+private:
+    static constexpr size_t BLOCK_ALIGN = std::max(alignof(T), alignof(void*));
+    static constexpr size_t BLOCK_SIZE = (std::max(sizeof(T), sizeof(void*)) + BLOCK_ALIGN - 1) / BLOCK_ALIGN * BLOCK_ALIGN;
+
+    struct ThreadCache {
+        FreeList blocks;
+
+        ~ThreadCache() {
+            if (!blocks.empty())
+                instance().spill(blocks, blocks.size());
+        }
+    };
+
+    static FreeList& threadCache() {
+        thread_local ThreadCache cache;
+        return cache.blocks;
+    }
+
+    void* allocate() {
+        FreeList& cache = threadCache();
+        if (cache.empty()) {
+            std::lock_guard lock(m_mutex);
+            if (m_free.empty())
+                grow();
+            m_free.moveTo(cache, THREAD_CACHE_OBJECTS / 2);
+        }
+        return cache.pop();
+    }
+
+    void deallocate(void* block) {
+        FreeList& cache = threadCache();
+        cache.push(block);
+        if (cache.size() >= THREAD_CACHE_OBJECTS)
+            spill(cache, THREAD_CACHE_OBJECTS / 2);
+    }
+
+    void spill(FreeList& cache, const size_t count) {
+        std::lock_guard lock(m_mutex);
+        cache.moveTo(m_free, count);
+    }
+
+    // Caller holds m_mutex
+    void grow() {
+        auto* slab = static_cast<std::byte*>(::operator new(BLOCK_SIZE * SLAB_OBJECTS, std::align_val_t(BLOCK_ALIGN)));
+        m_slabs.push_back(slab);
+        for (size_t i = SLAB_OBJECTS; i-- > 0;)
+            m_free.push(slab + i * BLOCK_SIZE);
+    }
+
+    std::mutex m_mutex;
+    FreeList m_free;            // Shared free blocks
+    std::vector<void*> m_slabs; // Every slab, released with the pool
+};
+
+// Byte buffers in size classes, four to every power of two from MIN_CLASS_SIZE to MAX_CLASS_SIZE,
+// so a buffer is never more than a fifth larger than what was asked for. Like SlabPool, freed
+// buffers go to a per-thread cache per class first and trade with shared lists in batches; the
+// caches are bounded in bytes, per class and per thread across all classes, and whatever does not
+// fit goes back to the heap. Classes too large for two of them to fit a thread's class budget skip
+// the thread caches and trade with the shared lists directly. Larger buffers always come from the
+// heap. Allocator<T> makes containers (strings of outgoing frames, queues) draw from the
+// process-wide instance().
+class BufferPool {
+public:
+    static constexpr size_t MIN_CLASS_SIZE = 256;
+    static constexpr size_t MAX_CLASS_SIZE = 64 * 1024 * 1024;
+    static constexpr size_t CLASS_COUNT = 73;                       // 256 B, then 320 B ... 64 MiB
+    static constexpr size_t THREAD_CACHE_CLASS_BYTES = 1024 * 1024; // Per class and thread
+    static constexpr size_t THREAD_CACHE_BYTES = 8 * 1024 * 1024;   // Per thread, all classes together
+    static constexpr size_t SHARED_CACHE_BYTES = 128 * 1024 * 1024; // Free buffers kept in the shared lists
+
+    template <typename T>
+    struct Allocator {
+        using value_type = T;
+
+        Allocator() = default;
+        template <typename U>
+        Allocator(const Allocator<U>&) noexcept {}
+
+        T* allocate(const size_t n) { return static_cast<T*>(instance().allocate(n * sizeof(T))); }
+        void deallocate(T* p, const size_t n) noexcept { instance().deallocate(p, n * sizeof(T)); }
+
+        template <typename U>
+        bool operator==(const Allocator<U>&) const noexcept { return true; }
+    };
+
+    static BufferPool& instance() {
+        static BufferPool pool;
+        return pool;
+    }
+
+    BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    ~BufferPool() {
+        for (FreeList& list : m_shared)
+            while (!list.empty())
+                ::operator delete(list.pop());
+    }
+
+    static size_t classSize(const size_t index) {
+        if (index == 0)
+            return MIN_CLASS_SIZE;
+        const size_t power = 8 + (index - 1) / 4;
+        return ((index - 1) % 4 + 5) << (power - 2);
+    }
+
+    static size_t classIndex(const size_t size) {
+        if (size <= MIN_CLASS_SIZE)
+            return 0;
+        const size_t power = std::bit_width(size - 1) - 1;
+        const size_t quarter = ((size - 1) >> (power - 2)) - 4;
+        return 1 + (power - 8) * 4 + quarter;
+    }
+
+    void* allocate(const size_t size) {
+        if (size > MAX_CLASS_SIZE)
+            return ::operator new(size);
+
+        const size_t index = classIndex(size);
+        if (threadCacheLimit(index) == 0)
+            return takeShared(index);
+
+        ThreadCache& cache = threadCache();
+        FreeList& list = cache.classes[index];
+        if (list.empty() && !refill(index, cache))
+            return ::operator new(classSize(index));
+        cache.bytes -= classSize(index);
+        return list.pop();
+    }
+
+    void deallocate(void* buffer, const size_t size) noexcept {
+        if (size > MAX_CLASS_SIZE) {
+            ::operator delete(buffer);
+            return;
+        }
+
+        const size_t index = classIndex(size);
+        if (threadCacheLimit(index) == 0) {
+            FreeList single;
+            single.push(buffer);
+            spill(index, single, 1);
+            return;
+        }
+
+        ThreadCache& cache = threadCache();
+        FreeList& list = cache.classes[index];
+        list.push(buffer);
+        cache.bytes += classSize(index);
+
+        // Over the class's share or the thread's total: half of the class goes, at least this buffer
+        if (list.size() > threadCacheLimit(index) || cache.bytes > THREAD_CACHE_BYTES) {
+            const size_t count = std::max<size_t>(1, list.size() / 2);
+            cache.bytes -= count * classSize(index);
+            spill(index, list, count);
+        }
+    }
+
+private:
+    struct ThreadCache {
+        std::array<FreeList, CLASS_COUNT> classes;
+        size_t bytes = 0; // In all classes
+
+        ~ThreadCache() {
+            for (size_t i = 0; i < CLASS_COUNT; ++i)
+                if (!classes[i].empty())
+                    instance().spill(i, classes[i], classes[i].size());
+        }
+    };
+
+    static ThreadCache& threadCache() {
+        thread_local ThreadCache cache;
+        return cache;
+    }
+
+    // Buffers of the class a thread may keep; 0 for classes that skip the thread caches
+    static size_t threadCacheLimit(const size_t index) {
+        const size_t limit = THREAD_CACHE_CLASS_BYTES / classSize(index);
+        return limit >= 2 ? limit : 0;
+    }
+
+    bool refill(const size_t index, ThreadCache& cache) {
+        std::lock_guard lock(m_mutex);
+        const size_t moved = m_shared[index].moveTo(cache.classes[index], std::max<size_t>(1, threadCacheLimit(index) / 2));
+        m_sharedBytes -= moved * classSize(index);
+        cache.bytes += moved * classSize(index);
+        return moved > 0;
+    }
+
+    void* takeShared(const size_t index) {
+        {
+            std::lock_guard lock(m_mutex);
+            if (!m_shared[index].empty()) {
+                m_sharedBytes -= classSize(index);
+                return m_shared[index].pop();
+            }
+        }
+        return ::operator new(classSize(index));
+    }
+
+    void spill(const size_t index, FreeList& cache, size_t count) noexcept {
+        const size_t size = classSize(index);
+        {
+            std::lock_guard lock(m_mutex);
+            for (; count > 0 && m_sharedBytes + size <= SHARED_CACHE_BYTES; --count) {
+                m_shared[index].push(cache.pop());
+                m_sharedBytes += size;
+            }
+        }
+        for (; count > 0; --count)
+            ::operator delete(cache.pop());
+    }
+
+    std::mutex m_mutex;
+    std::array<FreeList, CLASS_COUNT> m_shared; // Free buffers per class
+    size_t m_sharedBytes = 0;
+};
+
+#endif //MEMORYPOOL_H
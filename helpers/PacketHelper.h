@@ -1,19 +1,310 @@
 #ifndef PACKETBUILDHELPER_H
 #define PACKETBUILDHELPER_H
 
-#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <queue>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
 #include <iomanip>
 #include <random>
+#include <span>
 #include <filesystem>
 
+#include "ChecksumHelper.h"
+#include "CompressionHelper.h"
 #include "CryptHelper.h"
+#include "DeltaHelper.h"
+#include "FileHelper.h"
+#include "HexHelper.h"
+#include "PacketQueue.h"
 
 class PacketHelper {
+public:
+    // Wire format of a packet
+    enum class Protocol {
+        Text,   // START_PACKET ... END_PACKET with hex-encoded checksum and content
+        Binary  // Fixed little-endian header followed by the raw argument and content
+    };
+
+    // Binary framing, version 1:
+    //   u32 magic | u8 version | u8 type | u8 checksum length | u8 flags |
+    //   char[8] id | u8[16] uuid | u16 argument length | u8 checksum algorithm | u8 compression | u32 content length |
+    //   u64 total bytes | u64 amount of packets | u64 packet number | u8[32] checksum |
+    //   argument bytes | content bytes
+    // Client packets carry the requested chunk size (0 = server default) in the total bytes field,
+    // the requested checksum algorithm (None = server default) in the checksum algorithm field and
+    // the range of a "get" in the amount of packets (offset) and packet number (length) fields.
+    // Server packets with BINARY_FLAG_OFFSET start the argument bytes with the u64 file offset of
+    // their content; the argument length includes these 8 bytes.
+    // The compression field is the codec a client accepts for the answer (None = uncompressed) and
+    // the codec a server packet's content is compressed with; checksums cover the original content.
+    static constexpr uint32_t BINARY_MAGIC = 0x31534357; // "WCS1"
+    static constexpr uint8_t BINARY_VERSION = 1;
+    static constexpr size_t BINARY_HEADER_SIZE = 96;
+    static constexpr size_t BINARY_ID_SIZE = 8;
+    static constexpr size_t BINARY_UUID_SIZE = 16;
+    static constexpr size_t BINARY_CHECKSUM_SIZE = 32;
+
+    // Client flag: "get" may be answered with chunks that carry no checksum and whose
+    // content the server moves straight from the file to the socket (sendfile/TransmitFile)
+    static constexpr uint8_t BINARY_FLAG_RAW_PAYLOAD = 0x01;
+
+    // Server flag: the packet carries the file offset of its content, so that chunks can be
+    // written where they belong whatever order they arrive in
+    static constexpr uint8_t BINARY_FLAG_OFFSET = 0x02;
+
+    // Server flag: the requested file does not exist or cannot be opened, as opposed to being
+    // empty; the packet is the whole answer and carries no content (NOT_FOUND in text framing)
+    static constexpr uint8_t BINARY_FLAG_NOT_FOUND = 0x04;
+
+    // Content bytes of the next "get" packet; asked once per packet so that the size can adapt
+    using ChunkSizer = std::function<size_t()>;
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 256 * 1024;
+
+    // With SHA-256, "get" reads up to this many bytes ahead so that several chunks can be
+    // hashed at once by the multi-buffer kernel
+    static constexpr size_t CHECKSUM_READ_AHEAD = 1024 * 1024;
+
+    // Checksums known in advance (e.g. from an index): fills `checksum` for the chunk of
+    // `length` bytes at `offset` and returns true, or returns false to have it computed
+    using ChecksumLookup = std::function<bool(uint64_t offset, size_t length, std::vector<BYTE>& checksum)>;
+
+    // Compression of "get" chunks (e.g. through a cache): fills `compressed` for the chunk at `offset`
+    // and returns the codec used, or returns None to send the chunk as it is
+    using ChunkCompressor = std::function<CompressionHelper::Codec(uint64_t offset, std::span<const BYTE> chunk, std::vector<BYTE>& compressed)>;
+
+    // "list" answers carry names separated by '\n', packed into packets of up to this many content bytes
+    static constexpr size_t LIST_BATCH_SIZE = 64 * 1024;
+
+    // "sums" answers carry the checksums of up to this many consecutive chunks per packet
+    static constexpr size_t SUMS_BATCH_CHUNKS = 64;
+
+    // Page of a "list", from the argument "[--limit N] [--after <name>]". Names are listed in
+    // sorted order; --after takes the rest of the argument so that names may contain spaces.
+    // An answer that stops early carries the argument asking for the next page.
+    struct ListPage {
+        std::string after;  // List names sorting after this one; empty starts at the beginning
+        size_t limit;       // At most this many names; 0 for all
+
+        ListPage() : limit(0) {}
+
+        static ListPage parse(const std::string& argument) {
+            ListPage page;
+            std::string_view rest(argument);
+            while (!rest.empty()) {
+                if (rest.front() == ' ') {
+                    rest.remove_prefix(1);
+                } else if (rest.starts_with("--after ")) {
+                    page.after = rest.substr(8);
+                    break;
+                } else if (rest.starts_with("--limit ")) {
+                    rest.remove_prefix(8);
+                    const size_t end = std::min(rest.find(' '), rest.size());
+                    page.limit = std::strtoull(std::string(rest.substr(0, end)).c_str(), nullptr, 10);
+                    rest.remove_prefix(end);
+                } else {
+                    break; // Unknown words are ignored, like any argument of older "list" requests
+                }
+            }
+            return page;
+        }
+
+        std::string toArgument() const {
+            std::string argument;
+            if (limit > 0)
+                argument += "--limit " + std::to_string(limit);
+            if (!after.empty())
+                argument += (argument.empty() ? "" : " ") + std::string("--after ") + after;
+            return argument;
+        }
+    };
+
+    // Part of a file asked for by a "get": `length` bytes from `offset`, 0 meaning up to the end.
+    // Get packets still report the whole file size in TOTAL_BYTES and absolute offsets.
+    struct Range {
+        uint64_t offset;
+        uint64_t length;
+
+        Range(const uint64_t offset = 0, const uint64_t length = 0) : offset(offset), length(length) {}
+
+        // End of the range within a file of the given size
+        uint64_t end(const uint64_t fileSize) const {
+            if (offset >= fileSize) return fileSize;
+            return length == 0 ? fileSize : offset + std::min(length, fileSize - offset);
+        }
+    };
+
+    // Protocol names used in the "hello" negotiation
+    static constexpr std::string_view PROTOCOL_TEXT = "text";
+    static constexpr std::string_view PROTOCOL_BINARY = "binary/1";
+
+    // Check whether a received packet uses the binary framing
+    static bool isBinaryPacket(const std::string_view data) {
+        return data.size() >= sizeof(uint32_t) && readLE<uint32_t>(data.data()) == BINARY_MAGIC;
+    }
+
+    // Replace the UUID of an already built packet, so that cached responses can be reused
+    template <typename Packet>
+    static void setPacketUuid(Packet& packet, const std::string& uuid) {
+        if (isBinaryPacket(packet)) {
+            if (packet.size() >= BINARY_HEADER_SIZE)
+                packUuid(packet.data() + 16, uuid);
+            return;
+        }
+
+        const size_t start = packet.find("\nUUID: ");
+        if (start == Packet::npos)
+            return;
+
+        const size_t valueStart = start + 7;
+        const size_t valueEnd = packet.find('\n', valueStart);
+        packet.replace(valueStart, valueEnd == Packet::npos ? Packet::npos : valueEnd - valueStart, uuid);
+    }
+
+    // Size of the binary packet at the start of data, or 0 if its header is not complete yet
+    static size_t binaryPacketSize(const std::string_view data) {
+        if (data.size() < BINARY_HEADER_SIZE)
+            return 0;
+
+        const size_t argumentBytes = readLE<uint16_t>(data.data() + 32);
+        const size_t contentBytes = readLE<uint32_t>(data.data() + 36);
+        return BINARY_HEADER_SIZE + argumentBytes + contentBytes;
+    }
+
+    // Chunk size at the start of a "sums" packet's content (the digests follow it), or 0 if missing
+    static uint64_t sumsChunkSize(const std::vector<BYTE>& content) {
+        return content.size() >= sizeof(uint64_t) ? readLE<uint64_t>(reinterpret_cast<const char*>(content.data())) : 0;
+    }
+
 private:
+    enum class BinaryPacketType : uint8_t {
+        Server = 1,
+        Client = 2
+    };
+
+    // Decimal field of a text packet; malformed values read as 0
+    static size_t parseSize(const std::string_view value) {
+        size_t result = 0;
+        std::from_chars(value.data(), value.data() + value.size(), result);
+        return result;
+    }
+
+    template <typename T>
+    static void writeLE(char* out, T value) {
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            out[i] = static_cast<char>(value & 0xff);
+            value = static_cast<T>(value >> 8);
+        }
+    }
+
+    template <typename T>
+    static T readLE(const char* in) {
+        T value = 0;
+        for (size_t i = sizeof(T); i-- > 0;)
+            value = static_cast<T>(value << 8 | static_cast<unsigned char>(in[i]));
+        return value;
+    }
+
+    // UUIDs travel as 32 hex characters in text packets and as 16 raw bytes in binary ones
+    static void packUuid(char* out, const std::string& uuid) {
+        memset(out, 0, BINARY_UUID_SIZE);
+        for (size_t i = 0; i < BINARY_UUID_SIZE && i * 2 + 1 < uuid.size(); ++i) {
+            const int high = hexValue(uuid[i * 2]);
+            const int low = hexValue(uuid[i * 2 + 1]);
+            if (high < 0 || low < 0) break;
+            out[i] = static_cast<char>(high << 4 | low);
+        }
+    }
+
+    static std::string unpackUuid(const char* in) {
+        static constexpr char digits[] = "0123456789abcdef";
+        std::string uuid(BINARY_UUID_SIZE * 2, '0');
+        for (size_t i = 0; i < BINARY_UUID_SIZE; ++i) {
+            const auto byte = static_cast<unsigned char>(in[i]);
+            uuid[i * 2] = digits[byte >> 4];
+            uuid[i * 2 + 1] = digits[byte & 0x0f];
+        }
+        return uuid;
+    }
+
+    static int hexValue(const char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    // Server packets are built straight into pooled buffers; client ones are plain strings
+    template <typename Packet = std::string>
+    Packet buildBinaryPacket(
+        const BinaryPacketType type,
+        const std::string& id,
+        const std::string& argument,
+        const std::string& uuid,
+        const size_t totalBytes,
+        const size_t amountOfPackets,
+        const size_t packetNumber,
+        const std::vector<BYTE>& checksum,
+        const BYTE* content,
+        const size_t contentBytes,
+        uint8_t flags = 0,
+        const ChecksumHelper::Algorithm checksumAlgorithm = ChecksumHelper::Algorithm::None,
+        const std::optional<uint64_t> offset = std::nullopt,
+        const CompressionHelper::Codec codec = CompressionHelper::Codec::None) {
+
+        const size_t offsetBytes = offset ? sizeof(uint64_t) : 0;
+        if (offset)
+            flags |= BINARY_FLAG_OFFSET;
+
+        if (id.size() > BINARY_ID_SIZE)
+            throw std::runtime_error("Packet id too long for binary framing: " + id);
+        if (offsetBytes + argument.size() > UINT16_MAX)
+            throw std::runtime_error("Packet argument too long for binary framing");
+        if (checksum.size() > BINARY_CHECKSUM_SIZE)
+            throw std::runtime_error("Checksum too long for binary framing");
+
+        if (contentBytes > UINT32_MAX)
+            throw std::runtime_error("Content too long for binary framing");
+
+        // Without content only the header and argument are built; the content follows separately
+        Packet packet(BINARY_HEADER_SIZE + offsetBytes + argument.size() + (content ? contentBytes : 0), '\0');
+        char* header = packet.data();
+
+        writeLE<uint32_t>(header, BINARY_MAGIC);
+        header[4] = static_cast<char>(BINARY_VERSION);
+        header[5] = static_cast<char>(type);
+        header[6] = static_cast<char>(checksum.size());
+        header[7] = static_cast<char>(flags);
+        memcpy(header + 8, id.data(), id.size());
+        packUuid(header + 16, uuid);
+        writeLE<uint16_t>(header + 32, static_cast<uint16_t>(offsetBytes + argument.size()));
+        header[34] = static_cast<char>(checksumAlgorithm);
+        header[35] = static_cast<char>(codec);
+        writeLE<uint32_t>(header + 36, static_cast<uint32_t>(contentBytes));
+        writeLE<uint64_t>(header + 40, totalBytes);
+        writeLE<uint64_t>(header + 48, amountOfPackets);
+        writeLE<uint64_t>(header + 56, packetNumber);
+        if (!checksum.empty())
+            memcpy(header + 64, checksum.data(), checksum.size());
+
+        if (offset)
+            writeLE<uint64_t>(header + BINARY_HEADER_SIZE, *offset);
+        memcpy(header + BINARY_HEADER_SIZE + offsetBytes, argument.data(), argument.size());
+        if (content && contentBytes > 0)
+            memcpy(header + BINARY_HEADER_SIZE + offsetBytes + argument.size(), content, contentBytes);
+
+        return packet;
+    }
+
     std::string generateUUID() {
         std::random_device rd;
         std::mt19937 gen(rd());
@@ -26,18 +317,11 @@ private:
         return ss.str();
     }
 
-    std::string bytesToHexString(const std::vector<BYTE>& bytes) {
-        std::stringstream ss;
-
-        ss << "[ ";
-        for (const BYTE b : bytes)
-            ss << "0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(b) << " ";
-        ss << "]";
-
-        return ss.str();
+    std::string bytesToHexString(const std::span<const BYTE> bytes) {
+        return HexHelper::encode(bytes.data(), bytes.size(), HexHelper::bestIsa());
     }
 
-    std::string buildServerPacket(
+    PacketBuffer buildServerPacket(
         const std::string& id,
         const std::string& argument,
         const std::string& uuid,
@@ -45,10 +329,14 @@ private:
         const size_t amountOfPackets,
         const size_t packetNumber,
         const size_t contentBytes,
+        const std::string& checksumAlgorithm,
         const std::string& checksumStr,
-        const std::string& contentStr) {
+        const std::string& contentStr,
+        const std::optional<uint64_t> offset = std::nullopt,
+        const CompressionHelper::Codec codec = CompressionHelper::Codec::None,
+        const bool notFound = false) {
 
-        std::stringstream packet;
+        std::basic_ostringstream<char, std::char_traits<char>, BufferPool::Allocator<char>> packet;
         packet << "START_PACKET\n"
                << "ID: " << id << "\n"
                << "ARGUMENT: " << argument << "\n"
@@ -56,8 +344,16 @@ private:
                << "TOTAL_BYTES: " << totalBytes << "\n"
                << "AMOUNT_OF_PACKETS: " << amountOfPackets << "\n"
                << "PACKET_NUMBER: " << packetNumber << "\n"
-               << "CONTENT_BYTES: " << contentBytes << "\n"
-               << "CONTENT_CHECKSUM: " << checksumStr << "\n"
+               << "CONTENT_BYTES: " << contentBytes << "\n";
+        if (offset)
+            packet << "OFFSET: " << *offset << "\n";
+        if (notFound)
+            packet << "NOT_FOUND: 1\n";
+        if (!checksumAlgorithm.empty())
+            packet << "CHECKSUM_ALGORITHM: " << checksumAlgorithm << "\n";
+        if (codec != CompressionHelper::Codec::None)
+            packet << "COMPRESSION: " << CompressionHelper::name(codec) << "\n";
+        packet << "CONTENT_CHECKSUM: " << checksumStr << "\n"
                << "CONTENT: " << contentStr << "\n"
                << "END_PACKET";
 
@@ -67,36 +363,85 @@ private:
     std::string buildClientPacket(
         const std::string& id,
         const std::string& uuid,
-        const std::string& argument) {
+        const std::string& argument,
+        const size_t chunkSize = 0,
+        const ChecksumHelper::Algorithm checksumAlgorithm = ChecksumHelper::Algorithm::None,
+        const Range& range = Range(),
+        const std::vector<BYTE>& content = {},
+        const CompressionHelper::Codec codec = CompressionHelper::Codec::None) {
 
         std::stringstream packet;
         packet << "START_PACKET\n"
                << "ID: " << id << "\n"
                << "UUID: " << uuid << "\n"
-               << "ARGUMENT: " << argument << "\n"
-               << "END_PACKET";
+               << "ARGUMENT: " << argument << "\n";
+        if (chunkSize > 0)
+            packet << "CHUNK_SIZE: " << chunkSize << "\n";
+        if (range.offset > 0)
+            packet << "RANGE_OFFSET: " << range.offset << "\n";
+        if (range.length > 0)
+            packet << "RANGE_LENGTH: " << range.length << "\n";
+        if (checksumAlgorithm != ChecksumHelper::Algorithm::None)
+            packet << "CHECKSUM_ALGORITHM: " << ChecksumHelper::name(checksumAlgorithm) << "\n";
+        if (codec != CompressionHelper::Codec::None)
+            packet << "COMPRESSION: " << CompressionHelper::name(codec) << "\n";
+        if (!content.empty())
+            packet << "CONTENT_BYTES: " << content.size() << "\n"
+                   << "CONTENT: " << bytesToHexString(content) << "\n";
+        packet << "END_PACKET";
 
         return packet.str();
     }
 
-    std::vector<BYTE> parseHexStringToBytes(const std::string& hexStr) {
-        std::vector<BYTE> bytes;
-        std::istringstream iss(hexStr);
-        std::string token;
-        iss.ignore(2); // Skip "[ "
-
-        while (iss >> token) {
-            if (!token.empty() && token.back() == ']') token.pop_back();
-            if (token.size() < 2 || token.substr(0, 2) != "0x") continue;
-
-            unsigned int byteValue;
-            std::stringstream converter;
-            converter << std::hex << token.substr(2);
-            converter >> byteValue;
-            bytes.push_back(static_cast<BYTE>(byteValue));
-        }
+    // Build a server packet in the requested wire format
+    PacketBuffer buildServerPacket(
+        const Protocol protocol,
+        const std::string& id,
+        const std::string& argument,
+        const std::string& uuid,
+        const size_t totalBytes,
+        const size_t amountOfPackets,
+        const size_t packetNumber,
+        const std::vector<BYTE>& checksum,
+        const std::span<const BYTE> content,
+        const ChecksumHelper::Algorithm checksumAlgorithm = ChecksumHelper::Algorithm::None,
+        const std::optional<uint64_t> offset = std::nullopt,
+        const CompressionHelper::Codec codec = CompressionHelper::Codec::None) {
+
+        if (protocol == Protocol::Binary)
+            return buildBinaryPacket<PacketBuffer>(
+                BinaryPacketType::Server, id, argument, uuid, totalBytes, amountOfPackets, packetNumber,
+                checksum, content.data(), content.size(), 0, checksumAlgorithm, offset, codec);
+
+        return buildServerPacket(
+            id, argument, uuid, totalBytes, amountOfPackets, packetNumber, content.size(),
+            checksum.empty() ? "" : ChecksumHelper::name(checksumAlgorithm),
+            checksum.empty() ? "" : bytesToHexString(checksum),
+            content.empty() ? "" : bytesToHexString(content), offset, codec);
+    }
 
-        return bytes;
+    // Build a client packet in the requested wire format
+    std::string buildClientPacket(
+        const Protocol protocol,
+        const std::string& id,
+        const std::string& uuid,
+        const std::string& argument,
+        const uint8_t flags = 0,
+        const size_t chunkSize = 0,
+        const ChecksumHelper::Algorithm checksumAlgorithm = ChecksumHelper::Algorithm::None,
+        const Range& range = Range(),
+        const std::vector<BYTE>& content = {},
+        const CompressionHelper::Codec codec = CompressionHelper::Codec::None) {
+
+        if (protocol == Protocol::Binary)
+            return buildBinaryPacket(BinaryPacketType::Client, id, argument, uuid, chunkSize, range.offset, range.length,
+                                     {}, content.data(), content.size(), flags, checksumAlgorithm, std::nullopt, codec);
+
+        return buildClientPacket(id, uuid, argument, chunkSize, checksumAlgorithm, range, content, codec);
+    }
+
+    std::vector<BYTE> parseHexStringToBytes(const std::string_view hexStr) {
+        return HexHelper::decode(hexStr);
     }
 
     CryptHelper& cryptHelper;
@@ -106,76 +451,382 @@ public:
     public:
         Server(PacketHelper& parent) : parent(parent) {}
 
-        std::queue<std::string> getPacketList(const std::string& uuid, const std::string& pathToDir) {
-            std::queue<std::string> packets;
-            size_t totalBytes = 0;
+        // Answer a "hello": pick binary framing if the client offers it, text otherwise.
+        // The reply itself is always text so that clients can read it before switching.
+        PacketQueue getPacketHello(const std::string& uuid, const std::string& offeredProtocols) {
+            std::string selected(PROTOCOL_TEXT);
+
+            std::stringstream offers(offeredProtocols);
+            std::string offer;
+            while (std::getline(offers, offer, ',')) {
+                if (offer == PROTOCOL_BINARY) {
+                    selected = PROTOCOL_BINARY;
+                    break;
+                }
+            }
+
+            PacketQueue packets;
+            packets.push(parent.buildServerPacket("hello", selected, uuid, 0, 1, 1, 0, "", "", ""));
+            return packets;
+        }
+
+        PacketQueue getPacketList(const std::string& uuid, const std::string& pathToDir, const Protocol protocol = Protocol::Text,
+                                  const ChecksumHelper::Algorithm checksumAlgorithm = ChecksumHelper::Algorithm::Sha256,
+                                  const ListPage& page = {}) {
             std::vector<std::string> filenames;
 
             for (const auto& entry : std::filesystem::directory_iterator(pathToDir)) {
-                if (entry.is_regular_file()) {
-                    std::string filename = entry.path().filename().string();
-                    filenames.push_back(filename);
-                    totalBytes += filename.size();
-                }
+                if (entry.is_regular_file())
+                    filenames.push_back(entry.path().filename().string());
             }
+            std::sort(filenames.begin(), filenames.end());
 
-            const size_t amountOfPackets = filenames.size();
+            ListPage next;
+            filenames = takeListPage(std::upper_bound(filenames.begin(), filenames.end(), page.after), filenames.end(), page, next);
+            return getPacketList(uuid, filenames, protocol, checksumAlgorithm, next);
+        }
 
-            for (size_t i = 0; i < filenames.size(); ++i) {
-                const std::string& filename = filenames[i];
-                const std::vector<BYTE> content(filename.begin(), filename.end());
-                std::vector<BYTE> checksum = parent.cryptHelper.createHash(content);
-                std::string checksumStr = parent.bytesToHexString(checksum);
-                std::string contentStr = parent.bytesToHexString(content);
+        // "list" answer for names that are already known, e.g. from a cached listing. Names are
+        // packed into batches of up to LIST_BATCH_SIZE bytes, each checksummed as a whole;
+        // a non-empty `next` is sent as the argument to ask for the following page.
+        PacketQueue getPacketList(const std::string& uuid, const std::vector<std::string>& filenames, const Protocol protocol,
+                                  const ChecksumHelper::Algorithm checksumAlgorithm, const ListPage& next = {}) {
+            std::vector<std::vector<BYTE>> batches(1);
+            size_t totalBytes = 0;
+            for (const auto& filename : filenames) {
+                // A name with a line break cannot be told apart from two names
+                if (filename.find('\n') != std::string::npos)
+                    continue;
 
-                std::string packetStr = parent.buildServerPacket(
-                    "list", "", uuid, totalBytes, amountOfPackets, i + 1,
-                    filename.size(), checksumStr, contentStr);
+                if (!batches.back().empty() && batches.back().size() + filename.size() + 1 > LIST_BATCH_SIZE)
+                    batches.emplace_back();
+                batches.back().insert(batches.back().end(), filename.begin(), filename.end());
+                batches.back().push_back('\n');
+                totalBytes += filename.size() + 1;
+            }
 
-                packets.push(packetStr);
+            // Checksum all batches in one go so that SHA-256 can use the multi-buffer kernel
+            std::vector<const BYTE*> data(batches.size());
+            std::vector<size_t> sizes(batches.size());
+            std::vector<std::vector<BYTE>> checksums(batches.size());
+            for (size_t i = 0; i < batches.size(); ++i) {
+                data[i] = batches[i].data();
+                sizes[i] = batches[i].size();
             }
+            ChecksumHelper::computeMany(checksumAlgorithm, data.data(), sizes.data(), batches.size(), checksums.data());
 
-            if (packets.empty())
-                packets.push(parent.buildServerPacket("list", "", uuid, 0, 0, 1, 0, "", ""));
+            PacketQueue packets;
+            const std::string argument = next.toArgument();
+            for (size_t i = 0; i < batches.size(); ++i) {
+                packets.push(parent.buildServerPacket(
+                    protocol, "list", argument, uuid, totalBytes, batches.size(), i + 1,
+                    checksums[i], batches[i], checksumAlgorithm));
+            }
 
             return packets;
         }
 
-        std::queue<std::string> getPacketGet(const std::string& uuid, const std::string& argument, std::fstream& file) {
-            std::queue<std::string> packets;
-            file.seekg(0, std::ios::end);
-            const auto totalBytes = static_cast<size_t>(file.tellg());
-            file.seekg(0, std::ios::beg);
-
-            constexpr size_t chunkSize = 512;
-            const size_t amountOfPackets = (totalBytes + chunkSize - 1) / chunkSize;
-
-            for (size_t packetNumber = 1; packetNumber <= amountOfPackets; ++packetNumber) {
-                std::vector<BYTE> chunk(chunkSize);
-                file.read(reinterpret_cast<char*>(chunk.data()), chunkSize);
-                const size_t bytesRead = static_cast<size_t>(file.gcount());
-                if (bytesRead < chunkSize) {
-                    chunk.resize(bytesRead);
+        // Names of one page from a sorted range starting after the cursor; `next` asks for the rest, if any
+        template <typename Iterator>
+        static std::vector<std::string> takeListPage(Iterator first, const Iterator last, const ListPage& page, ListPage& next) {
+            std::vector<std::string> names;
+            for (; first != last && (page.limit == 0 || names.size() < page.limit); ++first)
+                names.push_back(*first);
+
+            next = {};
+            if (first != last && !names.empty()) {
+                next.after = names.back();
+                next.limit = page.limit;
+            }
+            return names;
+        }
+
+        // Packets are built lazily: each chunk is hashed and encoded only when the send path asks
+        // for it, straight from the file's mapped pages, so memory per transfer does not grow with
+        // the file size. When chunk sizes vary, AMOUNT_OF_PACKETS is an estimate that is exact on the last packet.
+        // With a compressor, chunks it compresses go out compressed; checksums stay those of the file data.
+        PacketQueue getPacketGet(const std::string& uuid, const std::string& argument, std::shared_ptr<const FileHelper::MappedFile> file,
+                                 const Protocol protocol = Protocol::Text, ChunkSizer nextChunkSize = [] { return DEFAULT_CHUNK_SIZE; },
+                                 const ChecksumHelper::Algorithm checksumAlgorithm = ChecksumHelper::Algorithm::Sha256,
+                                 ChecksumLookup knownChecksums = nullptr, const Range& range = Range(),
+                                 ChunkCompressor compressor = nullptr) {
+            const uint64_t totalBytes = file->isOpen() ? file->size() : 0;
+
+            const uint64_t start = std::min(range.offset, totalBytes);
+            const uint64_t end = range.end(totalBytes);
+            if (start == end) {
+                PacketQueue packets;
+                packets.push(parent.buildServerPacket(protocol, "get", argument, uuid, totalBytes, 1, 1, {}, {},
+                                                      ChecksumHelper::Algorithm::None, start));
+                return packets;
+            }
+
+            struct Transfer {
+                std::shared_ptr<const FileHelper::MappedFile> file;
+                std::vector<BYTE> buffer;                 // Batch read from a file that is not mapped
+                std::vector<std::span<const BYTE>> chunks; // Current batch: views of the mapping or of buffer
+                std::vector<std::vector<BYTE>> checksums;
+                size_t chunkCount = 0;                    // Chunks of the batch that hold data
+                size_t nextChunk = 0;                     // Next one to send
+                size_t chunkSize = 0;                     // Last size asked from nextChunkSize
+                size_t packetNumber = 0;
+                uint64_t bytesRead = 0;                   // File offset of the next chunk to read
+                uint64_t bytesSent = 0;                   // File offset of the next chunk to send
+            };
+
+            auto transfer = std::make_shared<Transfer>();
+            transfer->file = std::move(file);
+            transfer->bytesRead = transfer->bytesSent = start;
+            PacketHelper& helper = parent;
+
+            return PacketQueue([=, &helper](OutgoingPacket& packet) {
+                if (transfer->nextChunk == transfer->chunkCount) {
+                    if (!readBatch(*transfer, end, nextChunkSize, checksumAlgorithm, knownChecksums))
+                        return false; // Done, or the file shrank or became unreadable mid-transfer
                 }
 
-                std::vector<BYTE> checksum = parent.cryptHelper.createHash(chunk);
-                std::string checksumStr = parent.bytesToHexString(checksum);
-                std::string contentStr = parent.bytesToHexString(chunk);
+                const size_t index = transfer->nextChunk++;
+                ++transfer->packetNumber;
 
-                std::string packetStr = parent.buildServerPacket(
-                    "get", argument, uuid, totalBytes, amountOfPackets, packetNumber,
-                    bytesRead, checksumStr, contentStr);
+                // Chunks already read are exact; the rest is estimated from the latest chunk size
+                const uint64_t unread = end - transfer->bytesRead;
+                const size_t amountOfPackets = transfer->packetNumber + (transfer->chunkCount - transfer->nextChunk) +
+                                               static_cast<size_t>((unread + transfer->chunkSize - 1) / transfer->chunkSize);
 
-                packets.push(packetStr);
+                const auto chunk = transfer->chunks[index];
+                std::vector<BYTE> compressed;
+                const auto codec = compressor ? compressor(transfer->bytesSent, chunk, compressed) : CompressionHelper::Codec::None;
+
+                packet.data = helper.buildServerPacket(
+                    protocol, "get", argument, uuid, totalBytes, amountOfPackets, transfer->packetNumber,
+                    transfer->checksums[index], codec == CompressionHelper::Codec::None ? chunk : std::span<const BYTE>(compressed),
+                    checksumAlgorithm, transfer->bytesSent, codec);
+                transfer->bytesSent += chunk.size();
+
+                // Pages the file lost while the chunk was read held zeros; such a chunk is not sent
+                if (transfer->file->isMapped() && !transfer->file->contains(transfer->bytesSent))
+                    return false;
+                return true;
+            });
+        }
+
+        // Binary-only variant of getPacketGet for clients that set BINARY_FLAG_RAW_PAYLOAD: packets
+        // carry just the header, and the send path appends the chunk straight from the file
+        PacketQueue getPacketGetRaw(const std::string& uuid, const std::string& argument, std::shared_ptr<const FileHelper::File> file,
+                                    ChunkSizer nextChunkSize = [] { return DEFAULT_CHUNK_SIZE; }, const Range& range = Range()) {
+            const uint64_t totalBytes = file->isOpen() ? file->size() : 0;
+
+            const uint64_t start = std::min(range.offset, totalBytes);
+            const uint64_t end = range.end(totalBytes);
+            if (start == end) {
+                PacketQueue packets;
+                packets.push(parent.buildServerPacket(Protocol::Binary, "get", argument, uuid, totalBytes, 1, 1, {}, {},
+                                                      ChecksumHelper::Algorithm::None, start));
+                return packets;
             }
 
-            if (packets.empty())
-                packets.push(parent.buildServerPacket("get", argument, uuid, totalBytes, amountOfPackets, 1, 0, "", ""));
+            PacketHelper& helper = parent;
+            return PacketQueue([=, &helper, packetNumber = size_t{0}, offset = start](OutgoingPacket& packet) mutable {
+                if (offset == end)
+                    return false;
+
+                // Binary framing limits the content length to 32 bits
+                const size_t chunkSize = std::clamp<size_t>(nextChunkSize(), 1, UINT32_MAX);
+                const auto length = static_cast<size_t>(std::min<uint64_t>(chunkSize, end - offset));
+                ++packetNumber;
+
+                const uint64_t remaining = end - offset - length;
+                const size_t amountOfPackets = packetNumber + static_cast<size_t>((remaining + chunkSize - 1) / chunkSize);
+
+                packet.data = helper.buildBinaryPacket<PacketBuffer>(
+                    BinaryPacketType::Server, "get", argument, uuid, totalBytes, amountOfPackets, packetNumber,
+                    {}, nullptr, length, 0, ChecksumHelper::Algorithm::None, offset);
+                packet.file = file;
+                packet.fileOffset = offset;
+                packet.fileLength = length;
+
+                offset += length;
+                return true;
+            });
+        }
 
+        // Whole answer to a "get", "sums" or "sync" for a file that does not exist or cannot be opened,
+        // which an empty file's answer could not be told apart from
+        PacketQueue getPacketNotFound(const std::string& uuid, const std::string& id, const std::string& argument,
+                                      const Protocol protocol) {
+            PacketQueue packets;
+            if (protocol == Protocol::Binary)
+                packets.push(parent.buildBinaryPacket<PacketBuffer>(BinaryPacketType::Server, id, argument, uuid, 0, 1, 1, {}, nullptr, 0,
+                                                                    BINARY_FLAG_NOT_FOUND));
+            else
+                packets.push(parent.buildServerPacket(id, argument, uuid, 0, 1, 1, 0, "", "", "", std::nullopt,
+                                                      CompressionHelper::Codec::None, true));
             return packets;
         }
 
+        // "sums" answer: checksums of a file's chunks instead of its content, so that a client can check
+        // data it already has (e.g. from an interrupted download) and ask only for the rest. Each packet's
+        // content is the u64 little-endian chunk size followed by the digests of up to SUMS_BATCH_CHUNKS
+        // consecutive chunks, the first of which starts at the packet's offset. Like "get", chunks are
+        // read and hashed only when the send path asks for the packet.
+        PacketQueue getPacketSums(const std::string& uuid, const std::string& argument, std::shared_ptr<const FileHelper::File> file,
+                                  const Protocol protocol, const size_t chunkSize, const ChecksumHelper::Algorithm checksumAlgorithm,
+                                  ChecksumLookup knownChecksums = nullptr, const Range& range = Range()) {
+            const uint64_t totalBytes = file->isOpen() ? file->size() : 0;
+            const uint64_t start = std::min(range.offset / chunkSize * chunkSize, totalBytes);
+            const uint64_t end = range.end(totalBytes);
+            const uint64_t chunkCount = (end - start + chunkSize - 1) / chunkSize;
+            const size_t amountOfPackets = std::max<size_t>(static_cast<size_t>((chunkCount + SUMS_BATCH_CHUNKS - 1) / SUMS_BATCH_CHUNKS), 1);
+
+            // Chunks whose checksum is not known are hashed together, as many as the multi-buffer kernel takes
+            const auto group = static_cast<size_t>(std::clamp<uint64_t>(CHECKSUM_READ_AHEAD / chunkSize, 1, HashHelper::SHA256_LANES));
+
+            PacketHelper& helper = parent;
+            return PacketQueue([=, &helper, packetNumber = size_t{0}, offset = start](OutgoingPacket& packet) mutable {
+                if (packetNumber == amountOfPackets)
+                    return false;
+                ++packetNumber;
+
+                std::vector<BYTE> content(sizeof(uint64_t));
+                writeLE<uint64_t>(reinterpret_cast<char*>(content.data()), chunkSize);
+                const uint64_t firstOffset = offset;
+
+                std::vector<BYTE> buffer;
+                for (size_t first = 0; first < SUMS_BATCH_CHUNKS && offset < end; first += group) {
+                    std::vector<BYTE> digests[HashHelper::SHA256_LANES];
+                    std::vector<BYTE> computed[HashHelper::SHA256_LANES];
+                    const BYTE* data[HashHelper::SHA256_LANES];
+                    size_t sizes[HashHelper::SHA256_LANES];
+                    size_t missing[HashHelper::SHA256_LANES];
+                    size_t count = 0;
+                    size_t missingCount = 0;
+
+                    for (; count < group && first + count < SUMS_BATCH_CHUNKS && offset < end; ++count) {
+                        const auto length = static_cast<size_t>(std::min<uint64_t>(chunkSize, end - offset));
+                        if (!knownChecksums || !knownChecksums(offset, length, digests[count])) {
+                            if (buffer.empty())
+                                buffer.resize(group * chunkSize);
+
+                            BYTE* slot = buffer.data() + missingCount * chunkSize;
+                            if (file->read(offset, reinterpret_cast<char*>(slot), length) != length)
+                                return false; // The file shrank or became unreadable
+
+                            data[missingCount] = slot;
+                            sizes[missingCount] = length;
+                            missing[missingCount++] = count;
+                        }
+                        offset += length;
+                    }
+
+                    ChecksumHelper::computeMany(checksumAlgorithm, data, sizes, missingCount, computed);
+                    for (size_t i = 0; i < missingCount; ++i)
+                        digests[missing[i]] = std::move(computed[i]);
+                    for (size_t i = 0; i < count; ++i)
+                        content.insert(content.end(), digests[i].begin(), digests[i].end());
+                }
+
+                packet.data = helper.buildServerPacket(
+                    protocol, "sums", argument, uuid, totalBytes, amountOfPackets, packetNumber,
+                    ChecksumHelper::compute(checksumAlgorithm, content), content, checksumAlgorithm, firstOffset);
+                return true;
+            });
+        }
+
+        // "sync" answer: the delta of a file against the signature of the client's copy (see DeltaHelper),
+        // about `packetSize` bytes of instructions per packet. The file is read and matched lazily; the
+        // last packet ends with END and is the one whose PACKET_NUMBER equals AMOUNT_OF_PACKETS.
+        PacketQueue getPacketSync(const std::string& uuid, const std::string& argument, std::shared_ptr<const FileHelper::File> file,
+                                  const Protocol protocol, DeltaHelper::Signature signature, const size_t packetSize,
+                                  const ChecksumHelper::Algorithm checksumAlgorithm) {
+            auto encoder = std::make_shared<DeltaHelper::Encoder>(parent.cryptHelper, std::move(file), std::move(signature));
+
+            PacketHelper& helper = parent;
+            return PacketQueue([=, &helper, packetNumber = size_t{0}](OutgoingPacket& packet) mutable {
+                if (encoder->done())
+                    return false;
+
+                std::vector<BYTE> content;
+                if (!encoder->encode(content, packetSize))
+                    return false; // The file shrank or became unreadable
+                ++packetNumber;
+
+                const size_t amountOfPackets = encoder->done() ? packetNumber : packetNumber + 1;
+                packet.data = helper.buildServerPacket(
+                    protocol, "sync", argument, uuid, encoder->fileSize(), amountOfPackets, packetNumber,
+                    ChecksumHelper::compute(checksumAlgorithm, content), content, checksumAlgorithm);
+                return true;
+            });
+        }
+
     private:
+        // Takes the next chunks of a "get" and checksums them: one chunk at a time, or with
+        // SHA-256 as many as fit in CHECKSUM_READ_AHEAD (up to the kernel's lane count), hashed
+        // together. The batch is one view of the mapped file, or one read into the transfer's
+        // buffer if the file is not mapped. Checksums found by knownChecksums are not computed.
+        template <typename Transfer>
+        static bool readBatch(Transfer& transfer, const uint64_t end, const ChunkSizer& nextChunkSize,
+                              const ChecksumHelper::Algorithm checksumAlgorithm, const ChecksumLookup& knownChecksums) {
+            transfer.chunkCount = 0;
+            transfer.nextChunk = 0;
+
+            // Chunk boundaries come first, so that the batch can be taken from the file at once
+            size_t lengths[HashHelper::SHA256_LANES];
+            size_t lengthCount = 0;
+            size_t batchBytes = 0;
+            size_t batch = 1;
+            while (transfer.bytesRead + batchBytes < end && lengthCount < batch) {
+                transfer.chunkSize = std::max<size_t>(nextChunkSize(), 1);
+                lengths[lengthCount] = static_cast<size_t>(std::min<uint64_t>(transfer.chunkSize, end - transfer.bytesRead - batchBytes));
+                batchBytes += lengths[lengthCount++];
+
+                if (lengthCount == 1 && checksumAlgorithm == ChecksumHelper::Algorithm::Sha256)
+                    batch = std::clamp<size_t>(CHECKSUM_READ_AHEAD / transfer.chunkSize, 1, HashHelper::SHA256_LANES);
+            }
+
+            std::span<const BYTE> data;
+            if (transfer.file->isMapped()) {
+                data = transfer.file->view(transfer.bytesRead, batchBytes);
+            } else {
+                transfer.buffer.resize(batchBytes);
+                const size_t bytesRead = transfer.file->file().read(transfer.bytesRead, reinterpret_cast<char*>(transfer.buffer.data()), batchBytes);
+                data = std::span<const BYTE>(transfer.buffer.data(), bytesRead);
+            }
+
+            // A file that shrank ends the batch early, possibly with a partial chunk
+            transfer.chunks.resize(std::max(transfer.chunks.size(), lengthCount));
+            transfer.checksums.resize(transfer.chunks.size());
+
+            size_t missing[HashHelper::SHA256_LANES]; // Chunks whose checksum is computed here
+            size_t missingCount = 0;
+
+            size_t position = 0;
+            for (; transfer.chunkCount < lengthCount && position < data.size(); ++transfer.chunkCount) {
+                const auto chunk = data.subspan(position, std::min(lengths[transfer.chunkCount], data.size() - position));
+                transfer.chunks[transfer.chunkCount] = chunk;
+
+                if (!knownChecksums || !knownChecksums(transfer.bytesRead + position, chunk.size(), transfer.checksums[transfer.chunkCount]))
+                    missing[missingCount++] = transfer.chunkCount;
+                position += chunk.size();
+            }
+            transfer.bytesRead += position;
+
+            if (transfer.chunkCount == 0)
+                return false;
+
+            const BYTE* chunkData[HashHelper::SHA256_LANES] = {};
+            size_t sizes[HashHelper::SHA256_LANES] = {};
+            std::vector<BYTE> computed[HashHelper::SHA256_LANES];
+            for (size_t i = 0; i < missingCount; ++i) {
+                chunkData[i] = transfer.chunks[missing[i]].data();
+                sizes[i] = transfer.chunks[missing[i]].size();
+            }
+
+            ChecksumHelper::computeMany(checksumAlgorithm, chunkData, sizes, missingCount, computed);
+            for (size_t i = 0; i < missingCount; ++i)
+                transfer.checksums[missing[i]] = std::move(computed[i]);
+            return true;
+        }
+
         PacketHelper& parent;
     };
 
@@ -183,18 +834,59 @@ public:
     public:
         Client(PacketHelper& parent) : parent(parent) {}
 
-        std::string getPacketList() {
+        // Offer binary framing to the server; always sent as text
+        std::string getPacketHello() {
+            const std::string uuid = parent.generateUUID();
+            return parent.buildClientPacket("hello", uuid, std::string(PROTOCOL_BINARY) + "," + std::string(PROTOCOL_TEXT));
+        }
+
+        // `argument` selects a page, see ListPage
+        std::string getPacketList(const std::string& argument = "") {
+            const std::string uuid = parent.generateUUID();
+            return parent.buildClientPacket(protocol, "list", uuid, argument, 0, 0, checksumAlgorithm);
+        }
+
+        // The whole file, or only `range` of it
+        std::string getPacketGet(const std::string& fileName, const Range& range = Range()) {
+            const std::string uuid = parent.generateUUID();
+            return parent.buildClientPacket(protocol, "get", uuid, fileName, BINARY_FLAG_RAW_PAYLOAD, chunkSize, checksumAlgorithm, range,
+                                            {}, compression);
+        }
+
+        // Delta of a file against the signature of the local copy, see Server::getPacketSync
+        std::string getPacketSync(const std::string& fileName, const std::vector<BYTE>& signature) {
             const std::string uuid = parent.generateUUID();
-            return parent.buildClientPacket("list", uuid, "");
+            return parent.buildClientPacket(protocol, "sync", uuid, fileName, 0, 0, checksumAlgorithm, Range(), signature);
         }
 
-        std::string getPacketGet(const std::string& fileName) {
+        // Chunk checksums of a file, see Server::getPacketSums; the server picks the chunk size
+        std::string getPacketSums(const std::string& fileName) {
             const std::string uuid = parent.generateUUID();
-            return parent.buildClientPacket("get", uuid, fileName);
+            return parent.buildClientPacket(protocol, "sums", uuid, fileName, 0, 0, checksumAlgorithm);
         }
 
+        // Wire format negotiated with the server; text until a "hello" reply says otherwise
+        Protocol getProtocol() const { return protocol; }
+        void setProtocol(const Protocol protocol) { this->protocol = protocol; }
+
+        // Content bytes per "get" packet to ask the server for; 0 leaves it to the server
+        size_t getChunkSize() const { return chunkSize; }
+        void setChunkSize(const size_t chunkSize) { this->chunkSize = chunkSize; }
+
+        // Checksum to ask the server for; None leaves it to the server
+        ChecksumHelper::Algorithm getChecksumAlgorithm() const { return checksumAlgorithm; }
+        void setChecksumAlgorithm(const ChecksumHelper::Algorithm algorithm) { checksumAlgorithm = algorithm; }
+
+        // Codec the content of "get" answers may be compressed with; None asks for it uncompressed
+        CompressionHelper::Codec getCompression() const { return compression; }
+        void setCompression(const CompressionHelper::Codec codec) { compression = codec; }
+
     private:
         PacketHelper& parent;
+        Protocol protocol = Protocol::Text;
+        size_t chunkSize = 0;
+        ChecksumHelper::Algorithm checksumAlgorithm = ChecksumHelper::Algorithm::None;
+        CompressionHelper::Codec compression = CompressionHelper::Codec::None;
     };
 
     class ServerPacket {
@@ -206,8 +898,12 @@ public:
         size_t amountOfPackets_ = 0;
         size_t packetNumber_ = 0;
         size_t contentBytes_ = 0;
+        ChecksumHelper::Algorithm checksumAlgorithm_ = ChecksumHelper::Algorithm::None;
         std::vector<BYTE> contentChecksum_;
         std::vector<BYTE> content_;
+        std::optional<uint64_t> offset_;
+        CompressionHelper::Codec compression_ = CompressionHelper::Codec::None;
+        bool notFound_ = false;
 
     public:
         const std::string& getId() const { return id_; }
@@ -217,8 +913,15 @@ public:
         const size_t getAmountOfPackets() const { return amountOfPackets_; }
         const size_t getPacketNumber() const { return packetNumber_; }
         const size_t getContentBytes() const { return contentBytes_; }
+        ChecksumHelper::Algorithm getChecksumAlgorithm() const { return checksumAlgorithm_; }
         const std::vector<BYTE>& getContentChecksum() const { return contentChecksum_; }
         const std::vector<BYTE>& getContent() const { return content_; }
+        // File offset of the content of a "get" packet; unset for servers that do not send it
+        std::optional<uint64_t> getOffset() const { return offset_; }
+        // Codec the content arrived in; the parser has already restored it, CONTENT_BYTES still counts it compressed
+        CompressionHelper::Codec getCompression() const { return compression_; }
+        // The server has no such file; TOTAL_BYTES 0 alone would also describe an empty one
+        bool isNotFound() const { return notFound_; }
 
         void setId(const std::string& id) { id_ = id; }
         void setArgument(const std::string& argument) { argument_ = argument; }
@@ -227,8 +930,12 @@ public:
         void setAmountOfPackets(size_t amount) { amountOfPackets_ = amount; }
         void setPacketNumber(size_t number) { packetNumber_ = number; }
         void setContentBytes(size_t bytes) { contentBytes_ = bytes; }
+        void setChecksumAlgorithm(ChecksumHelper::Algorithm algorithm) { checksumAlgorithm_ = algorithm; }
         void setContentChecksum(const std::vector<BYTE>& checksum) { contentChecksum_ = checksum; }
-        void setContent(const std::vector<BYTE>& content) { content_ = content; }
+        void setContent(std::vector<BYTE> content) { content_ = std::move(content); }
+        void setOffset(uint64_t offset) { offset_ = offset; }
+        void setCompression(CompressionHelper::Codec codec) { compression_ = codec; }
+        void setNotFound(bool notFound) { notFound_ = notFound; }
     };
 
     // Client-specific parsed packet
@@ -237,52 +944,163 @@ public:
         std::string id_;
         std::string uuid_;
         std::string argument_;
+        bool acceptsRawPayload_ = false;
+        size_t chunkSize_ = 0;
+        ChecksumHelper::Algorithm checksumAlgorithm_ = ChecksumHelper::Algorithm::None;
+        Range range_;
+        std::vector<BYTE> content_;
+        CompressionHelper::Codec compression_ = CompressionHelper::Codec::None;
 
     public:
         const std::string& getId() const { return id_; }
         const std::string& getUuid() const { return uuid_; }
         const std::string& getArgument() const { return argument_; }
+        bool acceptsRawPayload() const { return acceptsRawPayload_; }
+        size_t getChunkSize() const { return chunkSize_; }
+        ChecksumHelper::Algorithm getChecksumAlgorithm() const { return checksumAlgorithm_; }
+        const Range& getRange() const { return range_; }
+        // Data sent along with a request, e.g. the signature of a "sync"
+        const std::vector<BYTE>& getContent() const { return content_; }
+        // Codec the client accepts the answer's content in
+        CompressionHelper::Codec getCompression() const { return compression_; }
 
         void setId(const std::string& id) { id_ = id; }
         void setUuid(const std::string& uuid) { uuid_ = uuid; }
         void setArgument(const std::string& argument) { argument_ = argument; }
+        void setAcceptsRawPayload(bool accepts) { acceptsRawPayload_ = accepts; }
+        void setChunkSize(size_t chunkSize) { chunkSize_ = chunkSize; }
+        void setChecksumAlgorithm(ChecksumHelper::Algorithm algorithm) { checksumAlgorithm_ = algorithm; }
+        void setRange(const Range& range) { range_ = range; }
+        void setContent(std::vector<BYTE> content) { content_ = std::move(content); }
+        void setCompression(CompressionHelper::Codec codec) { compression_ = codec; }
     };
 
-    // Parser for server packets
-    ServerPacket parseServerPacket(const std::string& packetStr) {
+    // Servers that predate checksum negotiation send SHA-256 without naming it
+    static void defaultChecksumAlgorithm(ServerPacket& packet) {
+        if (packet.getChecksumAlgorithm() == ChecksumHelper::Algorithm::None && !packet.getContentChecksum().empty())
+            packet.setChecksumAlgorithm(ChecksumHelper::Algorithm::Sha256);
+    }
+
+    // Restores compressed content. Content that cannot be decompressed is dropped, which its
+    // checksum then reports; without a checksum the packet's data is simply missing.
+    static void decompressContent(ServerPacket& packet) {
+        if (packet.getCompression() == CompressionHelper::Codec::None)
+            return;
+
+        std::vector<BYTE> content;
+        if (!CompressionHelper::decompress(packet.getContent(), content))
+            content.clear();
+        packet.setContent(std::move(content));
+    }
+
+    // Parser for server packets (text or binary)
+    ServerPacket parseServerPacket(const std::string_view packetStr) {
         ServerPacket parsedPacket;
-        std::istringstream iss(packetStr);
-        std::string line;
 
-        if (!std::getline(iss, line) || line != "START_PACKET") {
+        if (isBinaryPacket(packetStr)) {
+            const char* header = packetStr.data();
+            if (binaryPacketSize(packetStr) == 0 || binaryPacketSize(packetStr) > packetStr.size() ||
+                static_cast<uint8_t>(header[4]) != BINARY_VERSION ||
+                static_cast<BinaryPacketType>(header[5]) != BinaryPacketType::Server)
+                return parsedPacket;
+
+            const size_t checksumBytes = std::min<size_t>(static_cast<uint8_t>(header[6]), BINARY_CHECKSUM_SIZE);
+            const size_t argumentBytes = readLE<uint16_t>(header + 32);
+            const size_t contentBytes = readLE<uint32_t>(header + 36);
+            const auto* payload = reinterpret_cast<const BYTE*>(header + BINARY_HEADER_SIZE);
+
+            size_t offsetBytes = 0;
+            if ((static_cast<uint8_t>(header[7]) & BINARY_FLAG_OFFSET) && argumentBytes >= sizeof(uint64_t)) {
+                offsetBytes = sizeof(uint64_t);
+                parsedPacket.setOffset(readLE<uint64_t>(header + BINARY_HEADER_SIZE));
+            }
+
+            parsedPacket.setId(std::string(header + 8, strnlen(header + 8, BINARY_ID_SIZE)));
+            parsedPacket.setUuid(unpackUuid(header + 16));
+            parsedPacket.setArgument(std::string(header + BINARY_HEADER_SIZE + offsetBytes, argumentBytes - offsetBytes));
+            parsedPacket.setTotalBytes(readLE<uint64_t>(header + 40));
+            parsedPacket.setAmountOfPackets(readLE<uint64_t>(header + 48));
+            parsedPacket.setPacketNumber(readLE<uint64_t>(header + 56));
+            parsedPacket.setContentBytes(contentBytes);
+            parsedPacket.setChecksumAlgorithm(ChecksumHelper::fromValue(static_cast<uint8_t>(header[34])));
+            parsedPacket.setContentChecksum(std::vector<BYTE>(header + 64, header + 64 + checksumBytes));
+            parsedPacket.setContent(std::vector<BYTE>(payload + argumentBytes, payload + argumentBytes + contentBytes));
+            parsedPacket.setCompression(CompressionHelper::fromValue(static_cast<uint8_t>(header[35])));
+            parsedPacket.setNotFound(static_cast<uint8_t>(header[7]) & BINARY_FLAG_NOT_FOUND);
+            defaultChecksumAlgorithm(parsedPacket);
+            decompressContent(parsedPacket);
             return parsedPacket;
         }
 
-        while (std::getline(iss, line)) {
+        // Lines are viewed in place, so the (large) CONTENT line is only read by the hex decoder
+        std::string_view rest = packetStr;
+        const auto nextLine = [&rest](std::string_view& line) {
+            if (rest.empty())
+                return false;
+            const size_t end = rest.find('\n');
+            line = rest.substr(0, end);
+            rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+            return true;
+        };
+
+        std::string_view line;
+        if (!nextLine(line) || line != "START_PACKET") {
+            return parsedPacket;
+        }
+
+        while (nextLine(line)) {
             if (line == "END_PACKET") break;
             const size_t colonPos = line.find(": ");
-            if (colonPos == std::string::npos) continue;
+            if (colonPos == std::string_view::npos) continue;
 
-            std::string key = line.substr(0, colonPos);
-            std::string value = line.substr(colonPos + 2);
+            const std::string_view key = line.substr(0, colonPos);
+            const std::string_view value = line.substr(colonPos + 2);
 
-            if (key == "ID") parsedPacket.setId(value);
-            else if (key == "ARGUMENT") parsedPacket.setArgument(value);
-            else if (key == "UUID") parsedPacket.setUuid(value);
-            else if (key == "TOTAL_BYTES") parsedPacket.setTotalBytes(std::stoul(value));
-            else if (key == "AMOUNT_OF_PACKETS") parsedPacket.setAmountOfPackets(std::stoul(value));
-            else if (key == "PACKET_NUMBER") parsedPacket.setPacketNumber(std::stoul(value));
-            else if (key == "CONTENT_BYTES") parsedPacket.setContentBytes(std::stoul(value));
+            if (key == "ID") parsedPacket.setId(std::string(value));
+            else if (key == "ARGUMENT") parsedPacket.setArgument(std::string(value));
+            else if (key == "UUID") parsedPacket.setUuid(std::string(value));
+            else if (key == "TOTAL_BYTES") parsedPacket.setTotalBytes(parseSize(value));
+            else if (key == "AMOUNT_OF_PACKETS") parsedPacket.setAmountOfPackets(parseSize(value));
+            else if (key == "PACKET_NUMBER") parsedPacket.setPacketNumber(parseSize(value));
+            else if (key == "CONTENT_BYTES") parsedPacket.setContentBytes(parseSize(value));
+            else if (key == "OFFSET") parsedPacket.setOffset(parseSize(value));
+            else if (key == "NOT_FOUND") parsedPacket.setNotFound(value == "1");
+            else if (key == "CHECKSUM_ALGORITHM") parsedPacket.setChecksumAlgorithm(ChecksumHelper::fromName(value));
+            else if (key == "COMPRESSION") parsedPacket.setCompression(CompressionHelper::fromName(value));
             else if (key == "CONTENT_CHECKSUM") parsedPacket.setContentChecksum(parseHexStringToBytes(value));
             else if (key == "CONTENT") parsedPacket.setContent(parseHexStringToBytes(value));
         }
 
+        defaultChecksumAlgorithm(parsedPacket);
+        decompressContent(parsedPacket);
         return parsedPacket;
     }
 
-    // Parser for client packets
+    // Parser for client packets (text or binary)
     ClientPacket parseClientPacket(const std::string& packetStr) {
         ClientPacket parsedPacket;
+
+        if (isBinaryPacket(packetStr)) {
+            const char* header = packetStr.data();
+            if (binaryPacketSize(packetStr) == 0 || binaryPacketSize(packetStr) > packetStr.size() ||
+                static_cast<uint8_t>(header[4]) != BINARY_VERSION ||
+                static_cast<BinaryPacketType>(header[5]) != BinaryPacketType::Client)
+                return parsedPacket;
+
+            parsedPacket.setId(std::string(header + 8, strnlen(header + 8, BINARY_ID_SIZE)));
+            parsedPacket.setUuid(unpackUuid(header + 16));
+            const size_t argumentBytes = readLE<uint16_t>(header + 32);
+            const auto* content = reinterpret_cast<const BYTE*>(header + BINARY_HEADER_SIZE + argumentBytes);
+            parsedPacket.setArgument(std::string(header + BINARY_HEADER_SIZE, argumentBytes));
+            parsedPacket.setContent(std::vector<BYTE>(content, content + readLE<uint32_t>(header + 36)));
+            parsedPacket.setAcceptsRawPayload(static_cast<uint8_t>(header[7]) & BINARY_FLAG_RAW_PAYLOAD);
+            parsedPacket.setChunkSize(static_cast<size_t>(readLE<uint64_t>(header + 40)));
+            parsedPacket.setChecksumAlgorithm(ChecksumHelper::fromValue(static_cast<uint8_t>(header[34])));
+            parsedPacket.setRange(Range(readLE<uint64_t>(header + 48), readLE<uint64_t>(header + 56)));
+            parsedPacket.setCompression(CompressionHelper::fromValue(static_cast<uint8_t>(header[35])));
+            return parsedPacket;
+        }
+
         std::istringstream iss(packetStr);
         std::string line;
 
@@ -301,6 +1119,12 @@ public:
             if (key == "ID") parsedPacket.setId(value);
             else if (key == "UUID") parsedPacket.setUuid(value);
             else if (key == "ARGUMENT") parsedPacket.setArgument(value);
+            else if (key == "CHUNK_SIZE") parsedPacket.setChunkSize(std::strtoull(value.c_str(), nullptr, 10));
+            else if (key == "CHECKSUM_ALGORITHM") parsedPacket.setChecksumAlgorithm(ChecksumHelper::fromName(value));
+            else if (key == "COMPRESSION") parsedPacket.setCompression(CompressionHelper::fromName(value));
+            else if (key == "RANGE_OFFSET") parsedPacket.setRange(Range(parseSize(value), parsedPacket.getRange().length));
+            else if (key == "RANGE_LENGTH") parsedPacket.setRange(Range(parsedPacket.getRange().offset, parseSize(value)));
+            else if (key == "CONTENT") parsedPacket.setContent(parseHexStringToBytes(value));
         }
 
         return parsedPacket;
@@ -0,0 +1,102 @@
+#ifndef PACKETQUEUE_H
+#define PACKETQUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <utility>
+
+#include "FileHelper.h"
+#include "MemoryPool.h"
+
+// Bytes of a frame, drawn from the buffer pool so that building, sending and reassembling
+// packets does not go through the general-purpose heap
+using PacketBuffer = std::basic_string<char, std::char_traits<char>, BufferPool::Allocator<char>>;
+
+// A packet ready to be sent. When `file` is set, `data` only holds the header and the
+// payload is `fileLength` bytes of the file from `fileOffset`, which the send path moves
+// to the socket without copying it through user space where the platform allows it.
+struct OutgoingPacket {
+    PacketBuffer data;
+    std::shared_ptr<const FileHelper::File> file;
+    uint64_t fileOffset = 0;
+    size_t fileLength = 0;
+
+    OutgoingPacket() = default;
+    OutgoingPacket(PacketBuffer data) : data(std::move(data)) {}
+
+    size_t size() const { return data.size() + (file ? fileLength : 0); }
+};
+
+// Scheduling class of a response; lower values are sent first
+enum class TrafficClass : uint8_t {
+    Interactive = 0, // Small answers a client waits on (hello, list, sums)
+    Bulk = 1         // File transfers
+};
+
+// FIFO of outgoing packets with the std::queue interface used by the send path.
+// Besides packets pushed up front it can own a producer that generates the remaining
+// packets one at a time as the queue drains, so a long transfer only keeps the packet
+// being sent and the next one in memory.
+class PacketQueue {
+public:
+    // Writes the next packet and returns true, or returns false once exhausted
+    using Producer = std::function<bool(OutgoingPacket&)>;
+
+    PacketQueue() = default;
+    explicit PacketQueue(Producer producer) : m_producer(std::move(producer)) {}
+
+    void push(OutgoingPacket packet) {
+        if (m_packets.empty())
+            m_frontBytes = packet.data.size();
+        m_bufferedBytes += packet.data.size();
+        m_packets.push(std::move(packet));
+    }
+
+    // May run the producer to find out whether another packet follows
+    bool empty() {
+        fill();
+        return m_packets.empty();
+    }
+
+    OutgoingPacket& front() {
+        fill();
+        return m_packets.front();
+    }
+
+    // The front packet may have been moved out; what it held is known from when it became the front
+    void pop() {
+        m_bufferedBytes -= m_frontBytes;
+        m_packets.pop();
+        m_frontBytes = m_packets.empty() ? 0 : m_packets.front().data.size();
+    }
+
+    // Memory held by the packets in the queue (file payloads stay in the file until sent)
+    size_t bufferedBytes() const { return m_bufferedBytes; }
+
+    TrafficClass trafficClass() const { return m_trafficClass; }
+    void setTrafficClass(const TrafficClass trafficClass) { m_trafficClass = trafficClass; }
+
+private:
+    void fill() {
+        if (!m_packets.empty() || !m_producer)
+            return;
+
+        OutgoingPacket packet;
+        if (m_producer(packet))
+            push(std::move(packet));
+        else
+            m_producer = nullptr; // Release whatever the producer holds (open files, buffers)
+    }
+
+    std::queue<OutgoingPacket, std::deque<OutgoingPacket, BufferPool::Allocator<OutgoingPacket>>> m_packets; // Packets ready to send, pushed ones first
+    Producer m_producer;                  // Generates the rest on demand; empty once exhausted
+    TrafficClass m_trafficClass = TrafficClass::Interactive;
+    size_t m_bufferedBytes = 0;           // Data bytes of m_packets
+    size_t m_frontBytes = 0;              // Data bytes of m_packets.front() when it became the front
+};
+
+#endif //PACKETQUEUE_H
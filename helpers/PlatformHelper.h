@@ -0,0 +1,193 @@
+#ifndef PLATFORMHELPER_H
+#define PLATFORMHELPER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <windows.h>
+#include <ws2tcpip.h>
+#include <mstcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cerrno>
+#include <csignal>
+#include <pthread.h>
+#include <sched.h>
+
+// POSIX counterparts of the WinSock types used across the project
+using SOCKET = int;
+using BYTE = unsigned char;
+
+constexpr SOCKET INVALID_SOCKET = -1;
+constexpr int SOCKET_ERROR = -1;
+
+inline int closesocket(const SOCKET s) {
+    return ::close(s);
+}
+#endif
+
+class PlatformHelper {
+public:
+    // Congestion state of a connected TCP socket
+    struct TcpStats {
+        uint64_t rttUs = 0;     // Smoothed round-trip time
+        uint64_t cwndBytes = 0; // Congestion window: bytes the connection may have in flight per round trip
+    };
+
+    // Initialize the socket library (WSAStartup on Windows, no-op elsewhere)
+    static bool initSockets() {
+#ifdef _WIN32
+        WSADATA wsaData;
+        const int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
+        if (result != 0) {
+            printf("WSAStartup failed: %d\n", result);
+            return false;
+        }
+#else
+        // sendfile() and splice() have no MSG_NOSIGNAL; report closed peers as EPIPE instead
+        signal(SIGPIPE, SIG_IGN);
+#endif
+        return true;
+    }
+
+    static void cleanupSockets() {
+#ifdef _WIN32
+        WSACleanup();
+#endif
+    }
+
+    // Last socket error code (WSAGetLastError on Windows, errno elsewhere)
+    static int lastSocketError() {
+#ifdef _WIN32
+        return WSAGetLastError();
+#else
+        return errno;
+#endif
+    }
+
+    // Read the congestion state of a connected socket; false if the OS does not report it
+    static bool getTcpStats(const SOCKET socket, TcpStats& stats) {
+#ifdef _WIN32
+        DWORD version = 0;
+        TCP_INFO_v0 info{};
+        DWORD bytesReturned = 0;
+        if (WSAIoctl(socket, SIO_TCP_INFO, &version, sizeof(version), &info, sizeof(info), &bytesReturned, nullptr, nullptr) != 0)
+            return false;
+
+        stats.rttUs = info.RttUs;
+        stats.cwndBytes = info.Cwnd;
+#else
+        tcp_info info{};
+        socklen_t length = sizeof(info);
+        if (getsockopt(socket, IPPROTO_TCP, TCP_INFO, &info, &length) != 0)
+            return false;
+
+        stats.rttUs = info.tcpi_rtt;
+        stats.cwndBytes = static_cast<uint64_t>(info.tcpi_snd_cwnd) * info.tcpi_snd_mss;
+#endif
+        return true;
+    }
+
+    // Turn Nagle's algorithm off (true) or on for a connected socket
+    static bool setNoDelay(const SOCKET socket, const bool noDelay) {
+        const int value = noDelay ? 1 : 0;
+        return setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&value), sizeof(value)) == 0;
+    }
+
+    // Let several sockets listen on the same port, the kernel spreading new connections over them;
+    // false where the OS has no SO_REUSEPORT (Windows)
+    static constexpr bool supportsReusePort() {
+#ifdef SO_REUSEPORT
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static bool setReusePort(const SOCKET socket) {
+#ifdef SO_REUSEPORT
+        constexpr int value = 1;
+        return setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value)) == 0;
+#else
+        (void)socket;
+        return false;
+#endif
+    }
+
+    // Hardware threads the process may run on
+    static size_t availableCpus() {
+#ifdef _WIN32
+        return std::max<size_t>(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS), 1);
+#else
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            return std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        return std::max(CPU_COUNT(&allowed), 1);
+#endif
+    }
+
+    // Pin the calling thread to the `index`-th hardware thread the process may run on, wrapping
+    // around. Both OSes place the memory a thread touches first on its own NUMA node, so what a
+    // pinned thread allocates stays local to it. On Windows, processors are counted across groups.
+    static bool pinThread(size_t index) {
+#ifdef _WIN32
+        index %= availableCpus();
+        const WORD groups = GetActiveProcessorGroupCount();
+        for (WORD group = 0; group < groups; group++) {
+            const DWORD count = GetActiveProcessorCount(group);
+            if (index < count) {
+                GROUP_AFFINITY affinity{};
+                affinity.Group = group;
+                affinity.Mask = static_cast<KAFFINITY>(1) << index;
+                return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+            }
+            index -= count;
+        }
+        return false;
+#else
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+            return false;
+        }
+
+        index %= static_cast<size_t>(CPU_COUNT(&allowed));
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (!CPU_ISSET(cpu, &allowed)) continue;
+            if (index > 0) {
+                index--;
+                continue;
+            }
+
+            cpu_set_t pinned;
+            CPU_ZERO(&pinned);
+            CPU_SET(cpu, &pinned);
+            return pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned) == 0;
+        }
+        return false;
+#endif
+    }
+
+    // Wake up threads blocked in accept() on the given listening socket
+    static void shutdownListenSocket(const SOCKET listenSocket) {
+#ifdef _WIN32
+        closesocket(listenSocket);
+#else
+        shutdown(listenSocket, SHUT_RDWR);
+        closesocket(listenSocket);
+#endif
+    }
+};
+
+#endif //PLATFORMHELPER_H
@@ -0,0 +1,156 @@
+#ifndef WORKSTEALINGEXECUTOR_H
+#define WORKSTEALINGEXECUTOR_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Runs tasks on a fixed set of threads, each with its own deque. Tasks submitted from outside are
+// spread over the deques round-robin; a task submitted by one of the threads goes to the front of
+// its own deque and runs next, while what it needs is still in cache. A thread whose deque is empty
+// steals from the far end of another's, so one long task does not hold up the ones queued behind it.
+// Threads with nothing to run or steal sleep until a task is submitted.
+class WorkStealingExecutor {
+public:
+    using Task = std::function<void()>;
+
+    WorkStealingExecutor() = default;
+    WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+    WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+
+    ~WorkStealingExecutor() {
+        stop();
+    }
+
+    void start(const size_t threadCount) {
+        m_running = true;
+
+        m_workers.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; i++) {
+            m_workers.push_back(std::make_unique<Worker>());
+        }
+
+        m_threads.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; i++) {
+            m_threads.emplace_back(&WorkStealingExecutor::run, this, i);
+        }
+    }
+
+    // Run the queued tasks, and any they submit in turn, then let the threads finish. Tasks may
+    // hold on to things only running them gives back, so none is dropped.
+    void stop() {
+        if (!m_running) return;
+
+        {
+            std::lock_guard lock(m_idleMutex);
+            m_running = false;
+        }
+        m_idleCondition.notify_all();
+
+        for (auto& thread : m_threads) {
+            thread.join();
+        }
+        m_threads.clear();
+        m_workers.clear();
+        m_queued = 0;
+    }
+
+    size_t threadCount() const {
+        return m_threads.size();
+    }
+
+    void submit(Task task) {
+        const size_t index = t_executor == this ? t_worker : m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size();
+        {
+            Worker& worker = *m_workers[index];
+            std::lock_guard lock(worker.mutex);
+            if (t_executor == this) {
+                worker.tasks.push_front(std::move(task));
+            } else {
+                worker.tasks.push_back(std::move(task));
+            }
+        }
+
+        // A thread going to sleep counts itself before it looks at m_queued, so one of the two sees the other
+        m_queued.fetch_add(1);
+        if (m_sleeping.load() > 0) {
+            { std::lock_guard lock(m_idleMutex); }
+            m_idleCondition.notify_one();
+        }
+    }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks; // Runs from the front, stolen from the back
+    };
+
+    void run(const size_t index) {
+        t_executor = this;
+        t_worker = index;
+
+        Task task;
+        while (true) {
+            if (take(index, task) || steal(index, task)) {
+                m_queued.fetch_sub(1);
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            // Stopped and nothing left here or to steal; a task still running elsewhere queues what it submits for its own thread
+            if (!m_running) break;
+
+            std::unique_lock lock(m_idleMutex);
+            m_sleeping.fetch_add(1);
+            m_idleCondition.wait(lock, [this] { return m_queued.load() > 0 || !m_running; });
+            m_sleeping.fetch_sub(1);
+        }
+
+        t_executor = nullptr;
+    }
+
+    bool take(const size_t index, Task& task) {
+        Worker& worker = *m_workers[index];
+        std::lock_guard lock(worker.mutex);
+        if (worker.tasks.empty()) return false;
+
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        return true;
+    }
+
+    bool steal(const size_t thief, Task& task) {
+        for (size_t i = 1; i < m_workers.size(); i++) {
+            Worker& victim = *m_workers[(thief + i) % m_workers.size()];
+            std::lock_guard lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            return true;
+        }
+        return false;
+    }
+
+    static inline thread_local WorkStealingExecutor* t_executor = nullptr; // Executor the calling thread works for, if any
+    static inline thread_local size_t t_worker = 0;
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    std::atomic<size_t> m_nextWorker{0};
+    std::atomic<size_t> m_queued{0};   // Tasks in all deques
+    std::atomic<size_t> m_sleeping{0}; // Threads waiting on m_idleCondition
+    std::atomic<bool> m_running{false};
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleCondition;
+};
+
+#endif //WORKSTEALINGEXECUTOR_H
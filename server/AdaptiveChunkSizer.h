@@ -0,0 +1,47 @@
+#ifndef ADAPTIVECHUNKSIZER_H
+#define ADAPTIVECHUNKSIZER_H
+
+#include <algorithm>
+#include <cstdint>
+
+#include "PlatformHelper.h"
+
+// Sizes "get" chunks from the connection's TCP statistics.
+// The bandwidth estimate is cwnd / RTT; each packet carries what the connection delivers
+// in one round trip (but at least MIN_INTERVAL_US worth), so fast or distant clients get
+// few large packets while slow ones keep small packets that interleave with other responses.
+class AdaptiveChunkSizer {
+public:
+    static constexpr uint64_t MIN_INTERVAL_US = 1000;
+    static constexpr size_t ALIGNMENT = 4096; // Keep file offsets page aligned for sendfile
+
+    AdaptiveChunkSizer(const SOCKET socket, const size_t fallbackSize, const size_t minSize, const size_t maxSize)
+        : m_socket(socket), m_fallbackSize(fallbackSize), m_minSize(minSize), m_maxSize(maxSize) {
+    }
+
+    size_t operator()() {
+        PlatformHelper::TcpStats stats;
+        if (!PlatformHelper::getTcpStats(m_socket, stats) || stats.rttUs == 0 || stats.cwndBytes == 0) {
+            return std::clamp(m_fallbackSize, m_minSize, m_maxSize);
+        }
+
+        const double bytesPerUs = static_cast<double>(stats.cwndBytes) / static_cast<double>(stats.rttUs);
+        const double target = bytesPerUs * static_cast<double>(std::max(stats.rttUs, MIN_INTERVAL_US));
+
+        // Smooth out single noisy samples
+        m_estimate = m_estimate == 0 ? target : (3 * m_estimate + target) / 4;
+
+        size_t size = static_cast<size_t>(std::min(m_estimate, static_cast<double>(m_maxSize)));
+        if (size >= ALIGNMENT) size -= size % ALIGNMENT;
+        return std::clamp(size, m_minSize, m_maxSize);
+    }
+
+private:
+    SOCKET m_socket;
+    size_t m_fallbackSize; // Used while the OS reports no statistics
+    size_t m_minSize;
+    size_t m_maxSize;
+    double m_estimate = 0; // Smoothed target size in bytes
+};
+
+#endif //ADAPTIVECHUNKSIZER_H
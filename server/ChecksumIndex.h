@@ -0,0 +1,327 @@
+#ifndef CHECKSUMINDEX_H
+#define CHECKSUMINDEX_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ChecksumHelper.h"
+#include "FileHelper.h"
+#include "HashHelper.h"
+
+// Chunk checksums of the served files, kept in sidecar files so that "get" does not hash
+// files that did not change. One index covers one (algorithm, chunk size) pair, the server's
+// configured defaults; transfers with other settings compute their checksums as before.
+//
+// Sidecar layout (little-endian, fixed width so the file can be mapped as is):
+//   u32 magic | u16 version | u8 algorithm | u8 digest size | u64 chunk size |
+//   u64 file size | i64 modified | u64 file id | u64 chunk count | u8[16] reserved |
+//   chunk count * digest size bytes of digests
+// An index is only used while the file's size, modification time and file id still match.
+class ChecksumIndex {
+public:
+    static constexpr uint32_t MAGIC = 0x49534357; // "WCSI"
+    static constexpr uint16_t VERSION = 1;
+    static constexpr size_t HEADER_SIZE = 64;
+    static constexpr size_t BUILD_BUFFER_SIZE = 4 * 1024 * 1024; // File bytes read per hashing pass
+
+    class Entry {
+    public:
+        Entry(const FileHelper::Identity& identity, const uint64_t chunkSize, const size_t digestSize, std::vector<BYTE> digests)
+            : m_identity(identity), m_chunkSize(chunkSize), m_digestSize(digestSize), m_digests(std::move(digests)) {}
+
+        const FileHelper::Identity& identity() const { return m_identity; }
+        const std::vector<BYTE>& digests() const { return m_digests; }
+
+        // Digest of the chunk at offset, if the chunk lines up with the indexed ones
+        bool lookup(const uint64_t offset, const size_t length, std::vector<BYTE>& checksum) const {
+            if (offset % m_chunkSize != 0 || offset >= m_identity.size)
+                return false;
+            if (length != std::min<uint64_t>(m_chunkSize, m_identity.size - offset))
+                return false;
+
+            const BYTE* digest = m_digests.data() + offset / m_chunkSize * m_digestSize;
+            checksum.assign(digest, digest + m_digestSize);
+            return true;
+        }
+
+    private:
+        FileHelper::Identity m_identity;
+        uint64_t m_chunkSize;
+        size_t m_digestSize;
+        std::vector<BYTE> m_digests;
+    };
+
+    ChecksumIndex(std::string filesDir, std::string indexDir, const ChecksumHelper::Algorithm algorithm, const size_t chunkSize)
+        : m_filesDir(std::move(filesDir)), m_indexDir(std::move(indexDir)), m_algorithm(algorithm), m_chunkSize(chunkSize) {
+    }
+
+    ~ChecksumIndex() {
+        stop();
+    }
+
+    // Starts the indexer thread; with eager, every file already present is queued right away
+    void start(const bool eager) {
+        if (!enabled() || m_thread.joinable())
+            return;
+
+        FileHelper::createAllSubdirectories(m_indexDir);
+        m_stopping = false;
+        m_thread = std::thread(&ChecksumIndex::indexerThread, this);
+
+        if (eager) {
+            std::error_code ec;
+            for (const auto& entry : std::filesystem::directory_iterator(m_filesDir, ec)) {
+                if (entry.is_regular_file(ec))
+                    enqueue(entry.path().filename().string());
+            }
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stopping = true;
+        }
+        m_condition.notify_all();
+
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    // Index of a file if it is up to date; otherwise queues it for (re)building and returns null
+    std::shared_ptr<const Entry> find(const std::string& fileName, const ChecksumHelper::Algorithm algorithm) {
+        if (!enabled() || algorithm != m_algorithm || !isPlainName(fileName))
+            return nullptr;
+
+        FileHelper::Identity identity;
+        if (!FileHelper::getIdentity(filePath(fileName), identity) || identity.size == 0)
+            return nullptr;
+
+        {
+            std::lock_guard lock(m_mutex);
+            const auto it = m_entries.find(fileName);
+            if (it != m_entries.end() && it->second->identity() == identity)
+                return it->second;
+        }
+
+        // Not in memory yet: the sidecar may have been written by an earlier run
+        if (auto entry = load(fileName, identity)) {
+            std::lock_guard lock(m_mutex);
+            m_entries[fileName] = entry;
+            return entry;
+        }
+
+        enqueue(fileName);
+        return nullptr;
+    }
+
+private:
+    bool enabled() const {
+        return !m_indexDir.empty() && m_algorithm != ChecksumHelper::Algorithm::None;
+    }
+
+    // Only names of files directly in filesDir are indexed
+    static bool isPlainName(const std::string& fileName) {
+        return !fileName.empty() && std::filesystem::path(fileName).filename().string() == fileName &&
+               fileName != "." && fileName != "..";
+    }
+
+    std::string filePath(const std::string& fileName) const {
+        return (std::filesystem::path(m_filesDir) / fileName).string();
+    }
+
+    std::string sidecarPath(const std::string& fileName) const {
+        return (std::filesystem::path(m_indexDir) /
+                (fileName + "." + ChecksumHelper::name(m_algorithm) + "-" + std::to_string(m_chunkSize) + ".idx")).string();
+    }
+
+    void enqueue(const std::string& fileName) {
+        {
+            std::lock_guard lock(m_mutex);
+            if (m_stopping || !m_queued.insert(fileName).second)
+                return;
+            m_queue.push_back(fileName);
+        }
+        m_condition.notify_one();
+    }
+
+    void indexerThread() {
+        while (true) {
+            std::string fileName;
+            {
+                std::unique_lock lock(m_mutex);
+                m_condition.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+                if (m_stopping)
+                    return;
+
+                fileName = std::move(m_queue.front());
+                m_queue.pop_front();
+            }
+
+            if (auto entry = build(fileName)) {
+                std::lock_guard lock(m_mutex);
+                m_entries[fileName] = std::move(entry);
+            }
+
+            std::lock_guard lock(m_mutex);
+            m_queued.erase(fileName);
+        }
+    }
+
+    // Hashes the whole file and writes its sidecar; null if the file changed meanwhile
+    std::shared_ptr<const Entry> build(const std::string& fileName) {
+        FileHelper::Identity before;
+        if (!FileHelper::getIdentity(filePath(fileName), before) || before.size == 0)
+            return nullptr;
+
+        // An up-to-date sidecar may already exist, e.g. when a lazy request raced an eager scan
+        if (auto entry = load(fileName, before))
+            return entry;
+
+        const FileHelper::File file(filePath(fileName));
+        if (!file.isOpen())
+            return nullptr;
+
+        const uint64_t chunkCount = (before.size + m_chunkSize - 1) / m_chunkSize;
+        const size_t digestSize = ChecksumHelper::digestSize(m_algorithm);
+        std::vector<BYTE> digests(chunkCount * digestSize);
+
+        // Hash up to as many chunks per pass as the multi-buffer kernel takes
+        const auto batch = static_cast<size_t>(std::clamp<uint64_t>(BUILD_BUFFER_SIZE / m_chunkSize, 1, HashHelper::SHA256_LANES));
+        std::vector<BYTE> buffer(batch * m_chunkSize);
+        std::vector<BYTE> computed[HashHelper::SHA256_LANES];
+        const BYTE* data[HashHelper::SHA256_LANES];
+        size_t sizes[HashHelper::SHA256_LANES];
+
+        for (uint64_t first = 0; first < chunkCount; first += batch) {
+            if (m_stopping)
+                return nullptr;
+
+            const size_t count = static_cast<size_t>(std::min<uint64_t>(batch, chunkCount - first));
+            for (size_t i = 0; i < count; ++i) {
+                const uint64_t offset = (first + i) * m_chunkSize;
+                const auto length = static_cast<size_t>(std::min<uint64_t>(m_chunkSize, before.size - offset));
+                data[i] = buffer.data() + i * m_chunkSize;
+                sizes[i] = length;
+                if (file.read(offset, reinterpret_cast<char*>(buffer.data() + i * m_chunkSize), length) != length)
+                    return nullptr; // Shrank while indexing
+            }
+
+            ChecksumHelper::computeMany(m_algorithm, data, sizes, count, computed);
+            for (size_t i = 0; i < count; ++i)
+                memcpy(digests.data() + (first + i) * digestSize, computed[i].data(), digestSize);
+        }
+
+        FileHelper::Identity after;
+        if (!FileHelper::getIdentity(filePath(fileName), after) || after != before)
+            return nullptr;
+
+        auto entry = std::make_shared<const Entry>(before, m_chunkSize, digestSize, std::move(digests));
+        save(fileName, *entry, chunkCount, digestSize);
+        return entry;
+    }
+
+    std::shared_ptr<const Entry> load(const std::string& fileName, const FileHelper::Identity& identity) const {
+        std::ifstream in(sidecarPath(fileName), std::ios::binary);
+        if (!in)
+            return nullptr;
+
+        char header[HEADER_SIZE];
+        if (!in.read(header, HEADER_SIZE))
+            return nullptr;
+
+        const uint64_t chunkCount = readLE<uint64_t>(header + 48);
+        const size_t digestSize = static_cast<uint8_t>(header[7]);
+        const FileHelper::Identity stored{
+            readLE<uint64_t>(header + 16), static_cast<int64_t>(readLE<uint64_t>(header + 24)), readLE<uint64_t>(header + 32)
+        };
+
+        if (readLE<uint32_t>(header) != MAGIC || readLE<uint16_t>(header + 4) != VERSION ||
+            static_cast<uint8_t>(header[6]) != static_cast<uint8_t>(m_algorithm) ||
+            readLE<uint64_t>(header + 8) != m_chunkSize || stored != identity ||
+            chunkCount != (identity.size + m_chunkSize - 1) / m_chunkSize || digestSize == 0)
+            return nullptr;
+
+        std::vector<BYTE> digests(chunkCount * digestSize);
+        if (!in.read(reinterpret_cast<char*>(digests.data()), static_cast<std::streamsize>(digests.size())))
+            return nullptr;
+
+        return std::make_shared<const Entry>(identity, m_chunkSize, digestSize, std::move(digests));
+    }
+
+    // Written to a temporary file and renamed, so readers never see a partial sidecar
+    void save(const std::string& fileName, const Entry& entry, const uint64_t chunkCount, const size_t digestSize) const {
+        const std::string path = sidecarPath(fileName);
+        const std::string temporary = path + ".tmp";
+
+        char header[HEADER_SIZE] = {};
+        writeLE<uint32_t>(header, MAGIC);
+        writeLE<uint16_t>(header + 4, VERSION);
+        header[6] = static_cast<char>(m_algorithm);
+        header[7] = static_cast<char>(digestSize);
+        writeLE<uint64_t>(header + 8, m_chunkSize);
+        writeLE<uint64_t>(header + 16, entry.identity().size);
+        writeLE<uint64_t>(header + 24, static_cast<uint64_t>(entry.identity().modified));
+        writeLE<uint64_t>(header + 32, entry.identity().fileId);
+        writeLE<uint64_t>(header + 48, chunkCount);
+
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out.write(header, HEADER_SIZE);
+            out.write(reinterpret_cast<const char*>(entry.digests().data()), static_cast<std::streamsize>(entry.digests().size()));
+            if (!out)
+                return;
+        }
+
+        std::error_code ec;
+        std::filesystem::rename(temporary, path, ec);
+        if (ec) {
+            printf("Failed to write checksum index %s: %s\n", path.c_str(), ec.message().c_str());
+            std::filesystem::remove(temporary, ec);
+        }
+    }
+
+    template <typename T>
+    static void writeLE(char* out, T value) {
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            out[i] = static_cast<char>(value & 0xff);
+            value = static_cast<T>(value >> 8);
+        }
+    }
+
+    template <typename T>
+    static T readLE(const char* in) {
+        T value = 0;
+        for (size_t i = sizeof(T); i-- > 0;)
+            value = static_cast<T>(value << 8 | static_cast<unsigned char>(in[i]));
+        return value;
+    }
+
+    std::string m_filesDir;
+    std::string m_indexDir;                  // Where sidecars live; empty disables the index
+    ChecksumHelper::Algorithm m_algorithm;   // What the index holds
+    uint64_t m_chunkSize;
+
+    std::mutex m_mutex;                      // Guards everything below
+    std::condition_variable m_condition;
+    std::unordered_map<std::string, std::shared_ptr<const Entry>> m_entries; // Loaded or built, by file name
+    std::deque<std::string> m_queue;         // Files waiting for the indexer thread
+    std::unordered_set<std::string> m_queued;
+    std::atomic<bool> m_stopping = false;
+    std::thread m_thread;
+};
+
+#endif //CHECKSUMINDEX_H
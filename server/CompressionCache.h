@@ -0,0 +1,105 @@
+#ifndef COMPRESSIONCACHE_H
+#define COMPRESSIONCACHE_H
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "CompressionHelper.h"
+#include "FileHelper.h"
+#include "PacketHelper.h"
+
+// Compressed "get" chunks of hot files, so that a file many clients fetch is compressed once
+// per chunk instead of once per transfer. A file is hot from its HOT_REQUESTS-th compressed
+// "get" on; chunks of other files are compressed for the transfer and not kept. Chunks are
+// keyed by the file's identity, offset, length and codec, so a changed file simply misses and
+// its old chunks age out of the LRU, which holds up to `capacity` bytes. Chunks that did not
+// compress are kept too (empty), so they are not tried again.
+class CompressionCache {
+public:
+    static constexpr uint32_t HOT_REQUESTS = 2;
+    static constexpr size_t MAX_TRACKED_FILES = 4096; // Request counts kept before they are all forgotten
+    static constexpr size_t ENTRY_OVERHEAD = 128;     // Bytes charged per chunk besides its data
+
+    explicit CompressionCache(const size_t capacity) : m_capacity(capacity) {}
+
+    // Compressor for one "get" of the file at filePath
+    PacketHelper::ChunkCompressor compressor(const std::string& fileName, const std::string& filePath, const CompressionHelper::Codec codec) {
+        FileHelper::Identity identity;
+        if (m_capacity == 0 || !FileHelper::getIdentity(filePath, identity) || !isHot(fileName)) {
+            return [codec](uint64_t, const std::span<const BYTE> chunk, std::vector<BYTE>& compressed) {
+                compressed = CompressionHelper::compress(codec, chunk.data(), chunk.size());
+                return compressed.empty() ? CompressionHelper::Codec::None : codec;
+            };
+        }
+
+        std::string prefix = fileName + '\n' + std::to_string(identity.size) + ':' + std::to_string(identity.modified) + ':' +
+                             std::to_string(identity.fileId) + ':' + std::to_string(static_cast<int>(codec)) + ':';
+        return [this, codec, prefix = std::move(prefix)](const uint64_t offset, const std::span<const BYTE> chunk, std::vector<BYTE>& compressed) {
+            const std::string key = prefix + std::to_string(offset) + ':' + std::to_string(chunk.size());
+            if (!find(key, compressed)) {
+                compressed = CompressionHelper::compress(codec, chunk.data(), chunk.size());
+                insert(key, compressed);
+            }
+            return compressed.empty() ? CompressionHelper::Codec::None : codec;
+        };
+    }
+
+private:
+    struct Entry {
+        std::string key;
+        std::vector<BYTE> data;
+    };
+
+    bool isHot(const std::string& fileName) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_requests.size() >= MAX_TRACKED_FILES && !m_requests.contains(fileName))
+            m_requests.clear();
+        return ++m_requests[fileName] >= HOT_REQUESTS;
+    }
+
+    bool find(const std::string& key, std::vector<BYTE>& data) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto it = m_entries.find(key);
+        if (it == m_entries.end())
+            return false;
+
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        data = it->second->data;
+        return true;
+    }
+
+    void insert(const std::string& key, const std::vector<BYTE>& data) {
+        const size_t cost = data.size() + key.size() + ENTRY_OVERHEAD;
+        if (cost > m_capacity)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_entries.contains(key))
+            return; // Another transfer of the same file got there first
+
+        while (m_size + cost > m_capacity && !m_lru.empty()) {
+            const Entry& oldest = m_lru.back();
+            m_size -= oldest.data.size() + oldest.key.size() + ENTRY_OVERHEAD;
+            m_entries.erase(oldest.key);
+            m_lru.pop_back();
+        }
+
+        m_lru.push_front(Entry{key, data});
+        m_entries.emplace(key, m_lru.begin());
+        m_size += cost;
+    }
+
+    const size_t m_capacity;
+    std::mutex m_mutex;
+    std::list<Entry> m_lru; // Most recently used first
+    std::unordered_map<std::string, std::list<Entry>::iterator> m_entries;
+    std::unordered_map<std::string, uint32_t> m_requests; // Compressed "get"s per file name
+    size_t m_size = 0;
+};
+
+#endif //COMPRESSIONCACHE_H
@@ -0,0 +1,124 @@
+#ifndef CONNECTIONCONTEXT_H
+#define CONNECTIONCONTEXT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FrameDecoder.h"
+#include "PacketQueue.h"
+#include "PlatformHelper.h"
+
+#ifdef _WIN32
+#include <mswsock.h>
+#else
+#include <sys/uio.h>
+#endif
+
+// A response being sent and its turn state among the responses of its connection
+struct ResponseQueue {
+    PacketQueue packets;
+    TrafficClass trafficClass;       // Starts as the handler asked; large interactive responses drop to bulk
+    int64_t deficit = 0;             // Bytes it may still send in its round-robin turn
+    uint64_t sentBytes = 0;
+
+    explicit ResponseQueue(PacketQueue queue) : packets(std::move(queue)), trafficClass(packets.trafficClass()) {}
+};
+
+using ResponseQueues = std::deque<ResponseQueue, BufferPool::Allocator<ResponseQueue>>;
+
+// Per-connection data structure shared by ServerRunner and the reactor backends
+struct ConnectionContext {
+    static constexpr size_t DEFAULT_BUFFER_SIZE = 4096;
+    static constexpr size_t MAX_REQUEST_SIZE = 1024 * 1024; // Larger requests close the connection
+    static constexpr size_t MAX_SEND_FRAMES = 256;          // Frames gathered into one vectored send
+
+    using SendFrames = std::vector<PacketBuffer, BufferPool::Allocator<PacketBuffer>>;
+
+    SOCKET socket;                   // Client socket
+    size_t shard = 0;                // ServerRunner shard whose reactor and worker threads serve the connection
+    std::atomic<uint32_t> references{1}; // The connection itself, a send turn taken from the scheduler, a request being handled, a posted operation
+    char recvBuffer[DEFAULT_BUFFER_SIZE]; // Buffer for receiving data, filled by the reactor for the posted receive
+    FrameDecoder requestDecoder;     // Reassembles requests from received bytes; used by one thread at a time, the one handling the receive or resuming reads
+
+    // Send and flow-control state, guarded by sendMutex. Reactors read sendFrames (and sendMore)
+    // without it while a send is posted: isSending keeps ServerRunner off them until it completes.
+    // A send turn takes messageQueues out to produce packets without the lock, and owns the
+    // round-robin position (currentQueueIndex, queueTurnStarted) while isSending is set.
+    std::mutex sendMutex;
+    bool closed = false;             // Disconnected; nothing is queued or posted any more
+    ResponseQueues messageQueues;    // Multiple message queues for interleaving, filled lazily
+    SendFrames sendFrames;           // Frames of the send in progress, taken over from their packets
+    bool sendMore = false;           // Corked: more frames are queued behind the send in progress
+    bool isSending;                  // A send is being prepared or is in progress
+    size_t currentQueueIndex;        // Current queue index for round-robin processing
+    bool queueTurnStarted = false;   // The current queue has been given its quantum for this turn
+    size_t detachedBytes = 0;        // Memory of the responses a send turn has taken out of messageQueues
+    size_t outboundBytes = 0;        // Memory held by queued and in-flight responses, as last accounted
+    bool recvPaused = false;         // Over the queue limits: no receive is posted until the queues drain
+    bool recvParked = false;         // Paused with nothing to send; woken when the global budget frees up
+
+    // Egress scheduler state, guarded by the scheduler's mutex
+    ConnectionContext* egressPrev = nullptr; // Neighbours in the ready list of egressClass
+    ConnectionContext* egressNext = nullptr;
+    bool egressReady = false;        // Waiting in a ready list
+    bool egressBusy = false;         // Taken off the ready list for a turn that has not been charged yet
+    TrafficClass egressClass = TrafficClass::Bulk;
+    int64_t egressDeficit = 0;       // Bytes the connection may still send in its round-robin turn
+
+    std::shared_ptr<const FileHelper::File> sendFile; // File payload of the pending send, held by the reactor (under ioMutex on epoll/io_uring)
+
+#ifdef _WIN32
+    // IOCP backend state
+    WSAOVERLAPPED recvOverlapped;    // Overlapped structure for recv operations
+    WSAOVERLAPPED sendOverlapped;    // Overlapped structure for send operations
+    WSABUF wsaRecvBuffer;            // WSA buffer for recv operations
+    std::vector<WSABUF, BufferPool::Allocator<WSABUF>> wsaSendBuffers; // WSA buffers for send operations, one per frame
+    TRANSMIT_FILE_BUFFERS transmitBuffers; // Frames sent ahead of a TransmitFile payload
+#else
+    // epoll/io_uring backend state, guarded by ioMutex
+    std::mutex ioMutex;              // Serializes completion handling against posted operations
+    bool recvPosted = false;         // A receive has been posted and its completion not produced yet
+    bool recvReady = false;          // epoll: socket may have unread data (edge seen while no receive was posted)
+    bool sendPosted = false;         // A send has been posted and not yet completed
+    size_t sendOffset = 0;           // Bytes of the pending send already written
+    std::vector<iovec, BufferPool::Allocator<iovec>> sendIov; // Frames of the pending send, trimmed as they are written
+    size_t sendIovIndex = 0;         // First entry of sendIov with bytes left to write
+    uint64_t sendFileOffset = 0;     // Next offset of sendFile to transfer
+    size_t sendFileRemaining = 0;    // File bytes still to transfer
+
+    uint64_t ioId = 0;               // Connection id carried in io_uring user_data and epoll event data
+    bool fixedFile = false;          // io_uring: socket is installed in the registered file table
+    bool recvArmed = false;          // io_uring: a multishot recv is active
+    bool recvInFlight = false;       // io_uring: a recv completion is being handled by ServerRunner
+    std::deque<std::pair<int, unsigned>> parkedRecvs; // io_uring: CQE (res, flags) waiting for the next postRecv
+    size_t sendLength = 0;           // io_uring: bytes of the frames
+    msghdr sendMsg{};                // io_uring: sendmsg over sendIov
+    int splicePipe[2] = { -1, -1 };  // io_uring: pipe between sendFile and the socket
+    size_t pipeCapacity = 0;         // io_uring: size of splicePipe
+    size_t pipeBytes = 0;            // io_uring: bytes spliced into the pipe and not yet out of it
+    bool spliceInFlight = false;     // io_uring: a splice from or to splicePipe has been submitted
+#endif
+
+    ConnectionContext(const SOCKET s) : socket(s), requestDecoder(MAX_REQUEST_SIZE), isSending(false), currentQueueIndex(0) {
+        memset(recvBuffer, 0, DEFAULT_BUFFER_SIZE);
+
+#ifdef _WIN32
+        ZeroMemory(&recvOverlapped, sizeof(WSAOVERLAPPED));
+        ZeroMemory(&sendOverlapped, sizeof(WSAOVERLAPPED));
+
+        wsaRecvBuffer.buf = recvBuffer;
+        wsaRecvBuffer.len = DEFAULT_BUFFER_SIZE;
+
+        ZeroMemory(&transmitBuffers, sizeof(TRANSMIT_FILE_BUFFERS));
+#endif
+    }
+};
+
+#endif //CONNECTIONCONTEXT_H
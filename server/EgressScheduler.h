@@ -0,0 +1,163 @@
+#ifndef EGRESSSCHEDULER_H
+#define EGRESSSCHEDULER_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "ConnectionContext.h"
+#include "PacketQueue.h"
+
+// Decides whose packets a shard of the server produces and sends next, across its connections and
+// across the responses of each connection. Interactive traffic always goes before bulk
+// traffic, and a response that keeps going past INTERACTIVE_BYTES counts as bulk from then
+// on, so a huge listing cannot hold back downloads for long. Within a class it is deficit
+// round-robin by bytes: every turn adds QUANTUM to a connection's (or response's) deficit and
+// lets it send while the deficit is positive. Packets are produced lazily and their size is
+// only known afterwards, so the last packet of a turn may overshoot; the deficit goes negative
+// and the following turns pay it back.
+class EgressScheduler {
+public:
+    static constexpr int64_t QUANTUM = 256 * 1024;
+    static constexpr uint64_t INTERACTIVE_BYTES = 1024 * 1024;
+
+    // Put a connection with something to send on the ready list of `trafficClass`;
+    // a connection already waiting as bulk moves over to a more urgent class. Caller holds context->sendMutex.
+    void schedule(ConnectionContext* context, const TrafficClass trafficClass) {
+        std::lock_guard lock(m_mutex);
+        if (context->egressBusy) return; // Its worker sends what is queued
+        if (context->egressReady) {
+            if (trafficClass >= context->egressClass) return;
+            unlink(context);
+        }
+
+        context->egressClass = trafficClass;
+        append(context);
+    }
+
+    void remove(ConnectionContext* context) {
+        std::lock_guard lock(m_mutex);
+        if (context->egressReady) unlink(context);
+    }
+
+    // Take the next connection to send for, with the bytes it may send in this turn. The turn holds a
+    // reference to the connection, which the caller drops when it is done with it.
+    bool next(ConnectionContext*& context, size_t& budget) {
+        std::lock_guard lock(m_mutex);
+        for (ReadyList& list : m_ready) {
+            // Every pass over the list adds a quantum to each connection on it, so this ends
+            while (list.head) {
+                ConnectionContext* candidate = list.head;
+                unlink(candidate);
+
+                candidate->egressDeficit += QUANTUM;
+                if (candidate->egressDeficit > 0) {
+                    candidate->egressBusy = true;
+                    candidate->references.fetch_add(1, std::memory_order_relaxed);
+                    context = candidate;
+                    budget = static_cast<size_t>(candidate->egressDeficit);
+                    return true;
+                }
+
+                append(candidate);
+            }
+        }
+        return false;
+    }
+
+    // Account for the bytes a connection taken with next() sent in its turn; one with nothing left
+    // to send starts afresh next time
+    void charge(ConnectionContext* context, const size_t bytes, const bool drained) {
+        std::lock_guard lock(m_mutex);
+        context->egressBusy = false;
+        // Credit left over because a send ended early (a file payload, the frame limit) carries over for one turn at most
+        context->egressDeficit = drained ? 0 : std::min(context->egressDeficit - static_cast<int64_t>(bytes), QUANTUM);
+    }
+
+    // Most urgent class among a connection's responses; false if there are none
+    static bool urgentClass(const ResponseQueues& queues, TrafficClass& trafficClass) {
+        if (queues.empty()) return false;
+
+        trafficClass = TrafficClass::Bulk;
+        for (const ResponseQueue& queue : queues)
+            trafficClass = std::min(trafficClass, queue.trafficClass);
+        return true;
+    }
+
+    // Next packet of a connection: from its most urgent responses, taking turns among them by
+    // deficit round-robin. Runs their producers, so the send turn calls it on the queues it took
+    // out of the connection, without context->sendMutex.
+    static bool take(ConnectionContext* context, ResponseQueues& queues, OutgoingPacket& message) {
+        TrafficClass trafficClass;
+        if (!urgentClass(queues, trafficClass)) return false;
+
+        while (true) {
+            if (context->currentQueueIndex >= queues.size()) {
+                context->currentQueueIndex = 0;
+                context->queueTurnStarted = false;
+            }
+
+            ResponseQueue& queue = queues[context->currentQueueIndex];
+            if (queue.trafficClass == trafficClass) {
+                if (!context->queueTurnStarted) {
+                    queue.deficit += QUANTUM;
+                    context->queueTurnStarted = true;
+                }
+
+                if (queue.deficit > 0) {
+                    message = std::move(queue.packets.front());
+                    queue.packets.pop();
+                    queue.deficit -= static_cast<int64_t>(message.size());
+                    queue.sentBytes += message.size();
+                    if (queue.trafficClass == TrafficClass::Interactive && queue.sentBytes > INTERACTIVE_BYTES)
+                        queue.trafficClass = TrafficClass::Bulk;
+
+                    // A finished response leaves the rotation; the index then points at the one after it
+                    if (queue.packets.empty()) {
+                        queues.erase(queues.begin() + static_cast<std::ptrdiff_t>(context->currentQueueIndex));
+                        context->queueTurnStarted = false;
+                    } else if (queue.deficit <= 0 || queue.trafficClass != trafficClass) {
+                        ++context->currentQueueIndex;
+                        context->queueTurnStarted = false;
+                    }
+                    return true;
+                }
+            }
+
+            ++context->currentQueueIndex;
+            context->queueTurnStarted = false;
+        }
+    }
+
+private:
+    struct ReadyList {
+        ConnectionContext* head = nullptr;
+        ConnectionContext* tail = nullptr;
+    };
+
+    // Caller holds m_mutex
+    void append(ConnectionContext* context) {
+        ReadyList& list = m_ready[static_cast<size_t>(context->egressClass)];
+        context->egressPrev = list.tail;
+        context->egressNext = nullptr;
+        (list.tail ? list.tail->egressNext : list.head) = context;
+        list.tail = context;
+        context->egressReady = true;
+    }
+
+    // Caller holds m_mutex
+    void unlink(ConnectionContext* context) {
+        ReadyList& list = m_ready[static_cast<size_t>(context->egressClass)];
+        (context->egressPrev ? context->egressPrev->egressNext : list.head) = context->egressNext;
+        (context->egressNext ? context->egressNext->egressPrev : list.tail) = context->egressPrev;
+        context->egressPrev = context->egressNext = nullptr;
+        context->egressReady = false;
+    }
+
+    std::mutex m_mutex;
+    std::array<ReadyList, 2> m_ready; // Connections ready to send, by TrafficClass in priority order
+};
+
+#endif //EGRESSSCHEDULER_H
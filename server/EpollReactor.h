@@ -0,0 +1,372 @@
+#ifndef EPOLLREACTOR_H
+#define EPOLLREACTOR_H
+
+#ifndef _WIN32
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <fcntl.h>
+#include <climits>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "Reactor.h"
+
+// Linux edge-triggered epoll backend.
+// Readiness events are turned into IOCP-like completions: a posted recv/send is
+// performed by whichever thread observes the socket becoming ready, and finished
+// operations that were not produced inside waitForCompletion() are handed to the
+// waiting threads through a ready queue signalled by an eventfd. Events carry a
+// connection id rather than the context, so that one harvested just before the
+// connection was dissociated finds nothing instead of a context that may be gone.
+class EpollReactor : public Reactor {
+public:
+    EpollReactor() : m_epollFd(-1), m_eventFd(-1) {}
+
+    ~EpollReactor() override {
+        close();
+    }
+
+    const char* name() const override {
+        return "epoll";
+    }
+
+    bool open() override {
+        m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (m_epollFd < 0) {
+            printf("epoll_create1 failed: %d\n", errno);
+            return false;
+        }
+
+        // Semaphore semantics: every token read hands out exactly one ready completion
+        m_eventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK | EFD_SEMAPHORE);
+        if (m_eventFd < 0) {
+            printf("eventfd failed: %d\n", errno);
+            close();
+            return false;
+        }
+
+        // Level-triggered so that every waiting thread keeps seeing pending tokens
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = EVENTFD_ID;
+        if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_eventFd, &event) < 0) {
+            printf("epoll_ctl for eventfd failed: %d\n", errno);
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close() override {
+        if (m_eventFd >= 0) {
+            ::close(m_eventFd);
+            m_eventFd = -1;
+        }
+
+        if (m_epollFd >= 0) {
+            ::close(m_epollFd);
+            m_epollFd = -1;
+        }
+
+        std::lock_guard contextsLock(m_contextsMutex);
+        m_contexts.clear();
+
+        std::lock_guard lock(m_readyMutex);
+        m_readyQueue.clear();
+    }
+
+    bool associate(ConnectionContext* context) override {
+        // Edge-triggered notifications require non-blocking sockets
+        const int flags = fcntl(context->socket, F_GETFL, 0);
+        if (flags < 0 || fcntl(context->socket, F_SETFL, flags | O_NONBLOCK) < 0) {
+            printf("fcntl O_NONBLOCK failed: %d\n", errno);
+            return false;
+        }
+
+        std::lock_guard contextsLock(m_contextsMutex);
+        context->ioId = m_nextId++;
+
+        epoll_event event{};
+        event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.u64 = context->ioId;
+
+        if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, context->socket, &event) < 0) {
+            printf("epoll_ctl for client socket failed: %d\n", errno);
+            return false;
+        }
+
+        m_contexts[context->ioId] = context;
+        return true;
+    }
+
+    size_t dissociate(ConnectionContext* context) override {
+        std::lock_guard contextsLock(m_contextsMutex);
+        if (m_contexts.erase(context->ioId) == 0) return 0;
+
+        size_t dropped = 0;
+        {
+            std::lock_guard lock(context->ioMutex);
+            epoll_ctl(m_epollFd, EPOLL_CTL_DEL, context->socket, nullptr);
+            dropped += context->recvPosted + context->sendPosted;
+            context->recvPosted = false;
+            context->sendPosted = false;
+            context->sendFile.reset();
+            context->sendFileRemaining = 0;
+        }
+
+        // Cancel completions that are still queued for this connection; their tokens stay
+        // in the eventfd and are delivered as empty completions. Completions produced by
+        // waitForCompletion() are queued under m_contextsMutex, so none can arrive after this.
+        std::lock_guard lock(m_readyMutex);
+        for (auto& completion : m_readyQueue) {
+            if (completion.context == context) {
+                completion = {};
+                ++dropped;
+            }
+        }
+        return dropped;
+    }
+
+    bool postRecv(ConnectionContext* context) override {
+        IoCompletion completion;
+        {
+            std::lock_guard lock(context->ioMutex);
+            context->recvPosted = true;
+
+            // Edge-triggered: data that arrived before the post will not be signalled again
+            if (!context->recvReady || !tryRecv(context, completion)) {
+                return true;
+            }
+        }
+
+        enqueue(completion);
+        return true;
+    }
+
+    bool postSend(ConnectionContext* context) override {
+        return startSend(context, nullptr, 0, 0);
+    }
+
+    bool supportsSendFile() const override {
+        return true;
+    }
+
+    bool postSendFile(ConnectionContext* context, std::shared_ptr<const FileHelper::File> file, const uint64_t offset, const size_t length) override {
+        return startSend(context, std::move(file), offset, length);
+    }
+
+    bool waitForCompletion(IoCompletion& completion) override {
+        while (true) {
+            epoll_event event{};
+            const int count = epoll_wait(m_epollFd, &event, 1, -1);
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                printf("epoll_wait failed: %d\n", errno);
+                return false;
+            }
+
+            if (count == 0) continue;
+
+            // Token on the eventfd: take one completion from the ready queue
+            if (event.data.u64 == EVENTFD_ID) {
+                uint64_t token = 0;
+                if (read(m_eventFd, &token, sizeof(token)) != sizeof(token)) {
+                    continue; // Another thread took it
+                }
+
+                std::lock_guard lock(m_readyMutex);
+                completion = m_readyQueue.front();
+                m_readyQueue.pop_front();
+                return true;
+            }
+
+            // The event may have been harvested just before its connection was dissociated
+            std::shared_lock contextsLock(m_contextsMutex);
+            const auto it = m_contexts.find(event.data.u64);
+            if (it == m_contexts.end()) continue;
+
+            ConnectionContext* context = it->second;
+            IoCompletion recvCompletion, sendCompletion;
+            bool hasRecv = false, hasSend = false;
+            {
+                std::lock_guard lock(context->ioMutex);
+
+                if (event.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    context->recvReady = true;
+                    if (context->recvPosted) {
+                        hasRecv = tryRecv(context, recvCompletion);
+                    }
+                }
+
+                if (event.events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+                    if (context->sendPosted) {
+                        hasSend = trySend(context, sendCompletion);
+                    }
+                }
+            }
+
+            if (hasRecv && hasSend) {
+                enqueue(sendCompletion);
+            }
+
+            if (hasRecv) {
+                completion = recvCompletion;
+                return true;
+            }
+
+            if (hasSend) {
+                completion = sendCompletion;
+                return true;
+            }
+        }
+    }
+
+    void wakeup(const size_t count) override {
+        for (size_t i = 0; i < count; i++) {
+            enqueue({});
+        }
+    }
+
+private:
+    // Post a send of sendFrames, optionally followed by `length` bytes of `file`
+    bool startSend(ConnectionContext* context, std::shared_ptr<const FileHelper::File> file, const uint64_t offset, const size_t length) {
+        IoCompletion completion;
+        {
+            std::lock_guard lock(context->ioMutex);
+            context->sendPosted = true;
+            context->sendOffset = 0;
+            prepareSendIov(context);
+            context->sendFile = std::move(file);
+            context->sendFileOffset = offset;
+            context->sendFileRemaining = context->sendFile ? length : 0;
+
+            // Write as much as possible right away; the rest continues on EPOLLOUT
+            if (!trySend(context, completion)) {
+                return true;
+            }
+        }
+
+        enqueue(completion);
+        return true;
+    }
+
+    // Perform the posted receive; returns true if it finished (with data, EOF or error).
+    // Caller holds context->ioMutex.
+    static bool tryRecv(ConnectionContext* context, IoCompletion& completion) {
+        const ssize_t received = recv(context->socket, context->recvBuffer, ConnectionContext::DEFAULT_BUFFER_SIZE, 0);
+
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            context->recvReady = false;
+            return false;
+        }
+
+        context->recvPosted = false;
+
+        completion = {};
+        completion.context = context;
+        completion.operation = IoOperation::Recv;
+        completion.success = received >= 0;
+        completion.bytesTransferred = received > 0 ? static_cast<size_t>(received) : 0;
+        completion.data = context->recvBuffer;
+
+        // The socket may hold more data than fit in the buffer; the next postRecv tries again
+        context->recvReady = received > 0;
+        return true;
+    }
+
+    // Continue the posted send; returns true if it finished (fully written or failed).
+    // Caller holds context->ioMutex.
+    static bool trySend(ConnectionContext* context, IoCompletion& completion) {
+        while (context->sendIovIndex < context->sendIov.size()) {
+            msghdr message{};
+            message.msg_iov = context->sendIov.data() + context->sendIovIndex;
+            message.msg_iovlen = std::min<size_t>(context->sendIov.size() - context->sendIovIndex, IOV_MAX);
+
+            // Keep the frames in the socket until the file payload (or, corked, the next send) joins them
+            const int flags = MSG_NOSIGNAL | (context->sendFileRemaining > 0 || context->sendMore ? MSG_MORE : 0);
+            const ssize_t sent = sendmsg(context->socket, &message, flags);
+
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+
+                printf("sendmsg failed: %d\n", errno);
+                return finishSend(context, completion, false);
+            }
+
+            context->sendOffset += static_cast<size_t>(sent);
+            advanceSendIov(context, static_cast<size_t>(sent));
+        }
+
+        // File payload straight from the page cache
+        while (context->sendFileRemaining > 0) {
+            auto offset = static_cast<off_t>(context->sendFileOffset);
+            const ssize_t sent = sendfile(context->socket, context->sendFile->handle(), &offset, context->sendFileRemaining);
+
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+
+                printf("sendfile failed: %d\n", errno);
+                return finishSend(context, completion, false);
+            }
+
+            // The file shrank under us; the packet cannot be completed
+            if (sent == 0) {
+                printf("sendfile hit end of file\n");
+                return finishSend(context, completion, false);
+            }
+
+            context->sendFileOffset += static_cast<uint64_t>(sent);
+            context->sendFileRemaining -= static_cast<size_t>(sent);
+            context->sendOffset += static_cast<size_t>(sent);
+        }
+
+        return finishSend(context, completion, true);
+    }
+
+    // Caller holds context->ioMutex
+    static bool finishSend(ConnectionContext* context, IoCompletion& completion, const bool success) {
+        context->sendPosted = false;
+        context->sendFile.reset();
+        context->sendFileRemaining = 0;
+
+        completion = {};
+        completion.context = context;
+        completion.operation = IoOperation::Send;
+        completion.success = success;
+        completion.bytesTransferred = success ? context->sendOffset : 0;
+        return true;
+    }
+
+    void enqueue(const IoCompletion& completion) {
+        {
+            std::lock_guard lock(m_readyMutex);
+            m_readyQueue.push_back(completion);
+        }
+
+        constexpr uint64_t token = 1;
+        if (write(m_eventFd, &token, sizeof(token)) != sizeof(token)) {
+            printf("eventfd write failed: %d\n", errno);
+        }
+    }
+
+    static constexpr uint64_t EVENTFD_ID = 0; // Event data of the eventfd; connection ids start at 1
+
+    int m_epollFd;                        // epoll instance
+    int m_eventFd;                        // Counts completions waiting in m_readyQueue
+    std::deque<IoCompletion> m_readyQueue; // Completions produced outside waitForCompletion()
+    std::mutex m_readyMutex;              // Mutex to protect m_readyQueue
+    std::unordered_map<uint64_t, ConnectionContext*> m_contexts; // Associated connections by id
+    std::shared_mutex m_contextsMutex;    // Shared while an event is handled, exclusive to add or remove connections
+    uint64_t m_nextId = EVENTFD_ID + 1;   // Guarded by m_contextsMutex
+};
+
+#endif //_WIN32
+
+#endif //EPOLLREACTOR_H
@@ -0,0 +1,53 @@
+#ifndef FILEMAPPINGS_H
+#define FILEMAPPINGS_H
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "FileHelper.h"
+
+// Mapped files of the "get"s in progress. Transfers of the same unchanged file at the same time
+// (e.g. the ranges of a parallel download, or many clients fetching one file) share a single
+// open file and mapping instead of each opening their own. A mapping lives as long as its last
+// transfer, so idle files are not kept open (which on Windows would lock them against writers).
+class FileMappings {
+public:
+    static constexpr size_t PRUNE_SIZE = 1024; // Entries of finished transfers are dropped beyond this
+
+    std::shared_ptr<const FileHelper::MappedFile> open(const std::string& path) {
+        FileHelper::Identity identity;
+        const bool known = FileHelper::getIdentity(path, identity);
+
+        if (known) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const auto it = m_mappings.find(path);
+            if (it != m_mappings.end() && it->second.identity == identity) {
+                if (auto mapped = it->second.mapping.lock())
+                    return mapped;
+            }
+        }
+
+        auto mapped = std::make_shared<const FileHelper::MappedFile>(path);
+        if (!known || !mapped->isOpen())
+            return mapped;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_mappings.size() >= PRUNE_SIZE)
+            std::erase_if(m_mappings, [](const auto& entry) { return entry.second.mapping.expired(); });
+        m_mappings.insert_or_assign(path, Entry{identity, mapped});
+        return mapped;
+    }
+
+private:
+    struct Entry {
+        FileHelper::Identity identity;
+        std::weak_ptr<const FileHelper::MappedFile> mapping;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_mappings; // By path
+};
+
+#endif //FILEMAPPINGS_H
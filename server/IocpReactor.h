@@ -0,0 +1,207 @@
+#ifndef IOCPREACTOR_H
+#define IOCPREACTOR_H
+
+#ifdef _WIN32
+
+#include <winsock2.h>
+#include <windows.h>
+#include <mswsock.h>
+
+#include "Reactor.h"
+
+// Windows I/O completion port backend
+class IocpReactor : public Reactor {
+public:
+    IocpReactor() : m_completionPort(nullptr) {}
+
+    ~IocpReactor() override {
+        close();
+    }
+
+    const char* name() const override {
+        return "iocp";
+    }
+
+    bool open() override {
+        m_completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
+        if (m_completionPort == nullptr) {
+            printf("CreateIoCompletionPort failed: %d\n", GetLastError());
+            return false;
+        }
+
+        return true;
+    }
+
+    void close() override {
+        if (m_completionPort != nullptr) {
+            CloseHandle(m_completionPort);
+            m_completionPort = nullptr;
+        }
+    }
+
+    bool associate(ConnectionContext* context) override {
+        if (CreateIoCompletionPort(reinterpret_cast<HANDLE>(context->socket), m_completionPort, reinterpret_cast<ULONG_PTR>(context), 0) == nullptr) {
+            printf("CreateIoCompletionPort for client socket failed: %d\n", GetLastError());
+            return false;
+        }
+
+        return true;
+    }
+
+    size_t dissociate(ConnectionContext*) override {
+        // Closing the socket detaches it from the completion port; its pending operations still complete, with an error
+        return 0;
+    }
+
+    bool postRecv(ConnectionContext* context) override {
+        DWORD flags = 0;
+        DWORD bytesRecvd = 0;
+
+        // Reset the recv buffer
+        ZeroMemory(context->recvBuffer, ConnectionContext::DEFAULT_BUFFER_SIZE);
+        ZeroMemory(&context->recvOverlapped, sizeof(WSAOVERLAPPED));
+
+        // Post the receive operation
+        const int result = WSARecv(
+            context->socket,
+            &context->wsaRecvBuffer,
+            1,
+            &bytesRecvd,
+            &flags,
+            &context->recvOverlapped,
+            nullptr
+        );
+
+        if (result == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING) {
+            printf("WSARecv failed: %d\n", WSAGetLastError());
+            return false;
+        }
+
+        return true;
+    }
+
+    bool postSend(ConnectionContext* context) override {
+        // One WSA buffer per frame; an overlapped send on a stream socket completes once all of them are sent
+        context->wsaSendBuffers.clear();
+        for (auto& frame : context->sendFrames) {
+            context->wsaSendBuffers.push_back({ static_cast<ULONG>(frame.size()), frame.data() });
+        }
+
+        // Reset the overlapped structure
+        ZeroMemory(&context->sendOverlapped, sizeof(WSAOVERLAPPED));
+
+        // Post the send operation
+        DWORD bytesSent = 0;
+        const int result = WSASend(
+            context->socket,
+            context->wsaSendBuffers.data(),
+            static_cast<DWORD>(context->wsaSendBuffers.size()),
+            &bytesSent,
+            0,
+            &context->sendOverlapped,
+            nullptr
+        );
+
+        if (result == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING) {
+            printf("WSASend failed: %d\n", WSAGetLastError());
+            return false;
+        }
+
+        return true;
+    }
+
+    bool supportsSendFile() const override {
+        return true;
+    }
+
+    bool postSendFile(ConnectionContext* context, std::shared_ptr<const FileHelper::File> file, const uint64_t offset, const size_t length) override {
+        // The frames go out as the head buffer of the same TransmitFile call; it takes only one,
+        // so frames gathered ahead of the payload's header are joined into the first
+        auto& frames = context->sendFrames;
+        for (size_t i = 1; i < frames.size(); i++) {
+            frames.front() += frames[i];
+        }
+        frames.resize(1);
+
+        context->transmitBuffers.Head = frames.front().data();
+        context->transmitBuffers.HeadLength = static_cast<DWORD>(frames.front().size());
+        context->transmitBuffers.Tail = nullptr;
+        context->transmitBuffers.TailLength = 0;
+
+        // The file offset travels in the overlapped structure
+        ZeroMemory(&context->sendOverlapped, sizeof(WSAOVERLAPPED));
+        context->sendOverlapped.Offset = static_cast<DWORD>(offset);
+        context->sendOverlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+        context->sendFile = std::move(file);
+
+        const BOOL result = TransmitFile(
+            context->socket,
+            context->sendFile->handle(),
+            static_cast<DWORD>(length),
+            0,
+            &context->sendOverlapped,
+            &context->transmitBuffers,
+            0
+        );
+
+        if (!result && WSAGetLastError() != WSA_IO_PENDING && WSAGetLastError() != ERROR_IO_PENDING) {
+            printf("TransmitFile failed: %d\n", WSAGetLastError());
+            context->sendFile.reset();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool waitForCompletion(IoCompletion& completion) override {
+        DWORD bytesTransferred = 0;
+        ConnectionContext* context = nullptr;
+        LPOVERLAPPED overlapped = nullptr;
+
+        // Wait for a completion packet
+        const BOOL result = GetQueuedCompletionStatus(
+            m_completionPort,
+            &bytesTransferred,
+            reinterpret_cast<PULONG_PTR>(&context),
+            &overlapped,
+            INFINITE
+        );
+
+        if (!result && overlapped == nullptr) {
+            return false;
+        }
+
+        completion = {};
+        completion.context = context;
+        completion.bytesTransferred = bytesTransferred;
+        completion.success = result != FALSE;
+
+        if (context) {
+            if (overlapped == &context->recvOverlapped) {
+                completion.operation = IoOperation::Recv;
+                completion.data = context->recvBuffer;
+            }
+            else if (overlapped == &context->sendOverlapped) {
+                completion.operation = IoOperation::Send;
+                context->sendFile.reset();
+            }
+        }
+
+        return true;
+    }
+
+    void wakeup(const size_t count) override {
+        // Post completion packets to wake up worker threads
+        for (size_t i = 0; i < count; i++) {
+            PostQueuedCompletionStatus(m_completionPort, 0, static_cast<ULONG_PTR>(NULL), nullptr);
+        }
+    }
+
+private:
+    HANDLE m_completionPort;         // IOCP handle
+};
+
+#endif //_WIN32
+
+#endif //IOCPREACTOR_H
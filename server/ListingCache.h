@@ -0,0 +1,331 @@
+#ifndef LISTINGCACHE_H
+#define LISTINGCACHE_H
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+#include "ChecksumHelper.h"
+#include "PacketHelper.h"
+#include "PacketQueue.h"
+
+// In-memory listing of filesDir for "list". The names are kept up to date from directory
+// change notifications (inotify on Linux, ReadDirectoryChangesW on Windows) instead of
+// scanning the directory per request, and the encoded answer is kept per protocol and
+// checksum, so a full "list" only copies the packets and patches in the request's UUID;
+// a page ("--after"/"--limit") is encoded from the sorted names without touching the disk.
+// Without a working watcher every "list" scans the directory as before.
+class ListingCache {
+public:
+    ListingCache(std::string filesDir, PacketHelper& packetHelper)
+        : m_filesDir(std::move(filesDir)), m_packetHelper(packetHelper) {}
+
+    ~ListingCache() {
+        stop();
+    }
+
+    // Reads the directory once and starts watching it; false if changes cannot be watched
+    bool start() {
+        if (m_thread.joinable())
+            return true;
+
+        // Watch first so that nothing created during the initial scan is missed
+        if (!openWatch()) {
+            printf("Listing cache disabled, cannot watch %s\n", m_filesDir.c_str());
+            return false;
+        }
+
+        {
+            std::lock_guard lock(m_mutex);
+            rescan();
+        }
+
+        m_watching = true;
+        m_thread = std::thread(&ListingCache::watcherThread, this);
+        return true;
+    }
+
+    void stop() {
+        if (!m_thread.joinable())
+            return;
+
+#ifdef _WIN32
+        SetEvent(m_stopEvent);
+#else
+        const uint64_t one = 1;
+        (void)!write(m_stopEvent, &one, sizeof(one));
+#endif
+        m_thread.join();
+        m_watching = false;
+        closeWatch();
+    }
+
+    // Packets answering a "list" with the given UUID
+    PacketQueue list(const std::string& uuid, const PacketHelper::Protocol protocol, const ChecksumHelper::Algorithm algorithm,
+                     const PacketHelper::ListPage& page = {}) {
+        if (!m_watching)
+            return m_packetHelper.server.getPacketList(uuid, m_filesDir, protocol, algorithm, page);
+
+        if (page.limit > 0 || !page.after.empty()) {
+            PacketHelper::ListPage next;
+            std::vector<std::string> names;
+            {
+                std::lock_guard lock(m_mutex);
+                names = PacketHelper::Server::takeListPage(m_names.upper_bound(page.after), m_names.end(), page, next);
+            }
+            return m_packetHelper.server.getPacketList(uuid, names, protocol, algorithm, next);
+        }
+
+        std::shared_ptr<const Packets> cached = packets(protocol, algorithm);
+
+        // Copied one at a time as the queue drains; the snapshot stays valid if the listing changes meanwhile
+        size_t next = 0;
+        return PacketQueue([cached = std::move(cached), uuid, next](OutgoingPacket& packet) mutable {
+            if (next >= cached->size())
+                return false;
+
+            packet.data = (*cached)[next++];
+            PacketHelper::setPacketUuid(packet.data, uuid);
+            return true;
+        });
+    }
+
+private:
+    using Packets = std::vector<PacketBuffer>;
+
+    // Stand-in UUID of the cached packets; the same length as generated ones
+    static inline const std::string PLACEHOLDER_UUID = std::string(32, '0');
+
+    std::shared_ptr<const Packets> packets(const PacketHelper::Protocol protocol, const ChecksumHelper::Algorithm algorithm) {
+        std::lock_guard lock(m_mutex);
+
+        const auto key = std::make_pair(protocol, algorithm);
+        auto& cached = m_packets[key];
+        if (!cached) {
+            const std::vector<std::string> names(m_names.begin(), m_names.end());
+            auto queue = m_packetHelper.server.getPacketList(PLACEHOLDER_UUID, names, protocol, algorithm);
+            auto built = std::make_shared<Packets>();
+            while (!queue.empty()) {
+                built->push_back(std::move(queue.front().data));
+                queue.pop();
+            }
+            cached = std::move(built);
+        }
+        return cached;
+    }
+
+    // Callers hold m_mutex
+    void add(const std::string& name) {
+        std::error_code ec;
+        if (m_names.contains(name) || !std::filesystem::is_regular_file(std::filesystem::path(m_filesDir) / name, ec))
+            return;
+
+        m_names.insert(name);
+        m_packets.clear();
+    }
+
+    void remove(const std::string& name) {
+        if (m_names.erase(name) > 0)
+            m_packets.clear();
+    }
+
+    void rescan() {
+        m_names.clear();
+        m_packets.clear();
+
+        std::error_code ec;
+        for (const auto& entry : std::filesystem::directory_iterator(m_filesDir, ec)) {
+            if (entry.is_regular_file(ec))
+                add(entry.path().filename().string());
+        }
+    }
+
+#ifdef _WIN32
+    bool openWatch() {
+        m_directory = CreateFileA(m_filesDir.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                  nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (m_directory == INVALID_HANDLE_VALUE)
+            return false;
+
+        m_stopEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+        m_changeEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+        if (!m_stopEvent || !m_changeEvent) {
+            closeWatch();
+            return false;
+        }
+        return true;
+    }
+
+    void closeWatch() {
+        if (m_directory != INVALID_HANDLE_VALUE)
+            CloseHandle(m_directory);
+        if (m_stopEvent)
+            CloseHandle(m_stopEvent);
+        if (m_changeEvent)
+            CloseHandle(m_changeEvent);
+        m_directory = INVALID_HANDLE_VALUE;
+        m_stopEvent = nullptr;
+        m_changeEvent = nullptr;
+    }
+
+    static std::string narrow(const WCHAR* name, const int length) {
+        const int size = WideCharToMultiByte(CP_ACP, 0, name, length, nullptr, 0, nullptr, nullptr);
+        std::string result(size, '\0');
+        WideCharToMultiByte(CP_ACP, 0, name, length, result.data(), size, nullptr, nullptr);
+        return result;
+    }
+
+    void watcherThread() {
+        alignas(DWORD) BYTE buffer[64 * 1024];
+
+        while (true) {
+            OVERLAPPED overlapped = {};
+            overlapped.hEvent = m_changeEvent;
+            ResetEvent(m_changeEvent);
+
+            if (!ReadDirectoryChangesW(m_directory, buffer, sizeof(buffer), FALSE, FILE_NOTIFY_CHANGE_FILE_NAME, nullptr, &overlapped, nullptr)) {
+                printf("ReadDirectoryChangesW failed: %lu, listing cache disabled\n", GetLastError());
+                m_watching = false;
+                return;
+            }
+
+            const HANDLE events[] = {m_changeEvent, m_stopEvent};
+            if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                CancelIoEx(m_directory, &overlapped);
+                DWORD ignored;
+                GetOverlappedResult(m_directory, &overlapped, &ignored, TRUE);
+                return;
+            }
+
+            DWORD bytes = 0;
+            if (!GetOverlappedResult(m_directory, &overlapped, &bytes, FALSE)) {
+                printf("Watching %s failed: %lu, listing cache disabled\n", m_filesDir.c_str(), GetLastError());
+                m_watching = false;
+                return;
+            }
+
+            std::lock_guard lock(m_mutex);
+
+            // Zero bytes: more changes than the buffer could hold
+            if (bytes == 0) {
+                rescan();
+                continue;
+            }
+
+            const BYTE* current = buffer;
+            while (true) {
+                const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(current);
+                const std::string name = narrow(info->FileName, static_cast<int>(info->FileNameLength / sizeof(WCHAR)));
+
+                if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+                    add(name);
+                else if (info->Action == FILE_ACTION_REMOVED || info->Action == FILE_ACTION_RENAMED_OLD_NAME)
+                    remove(name);
+
+                if (info->NextEntryOffset == 0)
+                    break;
+                current += info->NextEntryOffset;
+            }
+        }
+    }
+
+    HANDLE m_directory = INVALID_HANDLE_VALUE;
+    HANDLE m_stopEvent = nullptr;
+    HANDLE m_changeEvent = nullptr;
+#else
+    bool openWatch() {
+        m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_inotify < 0)
+            return false;
+
+        const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+        m_stopEvent = eventfd(0, EFD_CLOEXEC);
+        if (inotify_add_watch(m_inotify, m_filesDir.c_str(), mask) < 0 || m_stopEvent < 0) {
+            closeWatch();
+            return false;
+        }
+        return true;
+    }
+
+    void closeWatch() {
+        if (m_inotify >= 0)
+            close(m_inotify);
+        if (m_stopEvent >= 0)
+            close(m_stopEvent);
+        m_inotify = -1;
+        m_stopEvent = -1;
+    }
+
+    void watcherThread() {
+        alignas(inotify_event) char buffer[64 * 1024];
+
+        while (true) {
+            pollfd fds[] = {{m_inotify, POLLIN, 0}, {m_stopEvent, POLLIN, 0}};
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR)
+                    continue;
+                perror("poll");
+                m_watching = false;
+                return;
+            }
+            if (fds[1].revents & POLLIN)
+                return;
+
+            std::lock_guard lock(m_mutex);
+            ssize_t length;
+            while ((length = read(m_inotify, buffer, sizeof(buffer))) > 0) {
+                for (char* current = buffer; current < buffer + length;) {
+                    const auto* event = reinterpret_cast<const inotify_event*>(current);
+                    current += sizeof(inotify_event) + event->len;
+
+                    if (event->mask & IN_Q_OVERFLOW) {
+                        rescan();
+                    } else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                        printf("%s is gone, listing cache disabled\n", m_filesDir.c_str());
+                        m_watching = false;
+                        return;
+                    } else if (event->len > 0 && !(event->mask & IN_ISDIR)) {
+                        if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                            add(event->name);
+                        else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                            remove(event->name);
+                    }
+                }
+            }
+        }
+    }
+
+    int m_inotify = -1;
+    int m_stopEvent = -1;
+#endif
+
+    std::string m_filesDir;
+    PacketHelper& m_packetHelper;
+
+    std::mutex m_mutex;
+    std::set<std::string> m_names;                            // Regular files in filesDir, sorted for paging
+    std::map<std::pair<PacketHelper::Protocol, ChecksumHelper::Algorithm>, std::shared_ptr<const Packets>> m_packets; // Encoded answers; cleared on change
+    std::atomic<bool> m_watching = false;                     // Names are being kept up to date
+    std::thread m_thread;
+};
+
+#endif //LISTINGCACHE_H
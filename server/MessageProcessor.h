@@ -1,11 +1,21 @@
 #ifndef MESSAGEPROCESSOR_H
 #define MESSAGEPROCESSOR_H
 
+#include <algorithm>
+#include <filesystem>
 #include <functional>
 #include <iostream>
-#include <queue>
+#include <memory>
 #include <string>
+#include <utility>
 
+#include "AdaptiveChunkSizer.h"
+#include "ChecksumIndex.h"
+#include "CompressionCache.h"
+#include "DeltaHelper.h"
+#include "FileHelper.h"
+#include "FileMappings.h"
+#include "ListingCache.h"
 #include "PacketHelper.h"
 #include "ServerConfig.h"
 #include "ServerRunner.h"
@@ -14,26 +24,167 @@ class MessageProcessor {
 private:
     ServerConfig& serverConfig;
     PacketHelper& packetHelper;
+    ChecksumIndex& checksumIndex;
+    ListingCache& listingCache;
+    CompressionCache& compressionCache;
+    FileMappings& fileMappings;
+
+    // Chunk size for a "get": what the client asked for, else adaptive or the configured size
+    PacketHelper::ChunkSizer chunkSizer(const PacketHelper::ClientPacket& request, const SOCKET clientSocket) const {
+        if (request.getChunkSize() > 0) {
+            const size_t size = std::clamp(request.getChunkSize(), serverConfig.minChunkSize, serverConfig.maxChunkSize);
+            return [size] { return size; };
+        }
+
+        if (serverConfig.adaptiveChunks)
+            return AdaptiveChunkSizer(clientSocket, serverConfig.chunkSize, serverConfig.minChunkSize, serverConfig.maxChunkSize);
+
+        return [size = serverConfig.chunkSize] { return size; };
+    }
+
+    // Path of a requested file in filesDir. Names that are absolute or lead out of filesDir get an
+    // empty path, which opens nothing, so they are answered like a missing file.
+    std::string resolveFilePath(const std::string& fileName) const {
+        const std::filesystem::path name(fileName);
+        if (fileName.empty() || name.has_root_path()) {
+            std::cout << "Rejected path: " << fileName << std::endl;
+            return {};
+        }
+
+        const auto base = std::filesystem::path(serverConfig.filesDir).lexically_normal();
+        const auto path = (base / name).lexically_normal();
+        const auto relative = path.lexically_relative(base);
+        if (relative.empty() || *relative.begin() == ".." || relative == ".") {
+            std::cout << "Rejected path: " << fileName << std::endl;
+            return {};
+        }
+
+        return path.string();
+    }
+
+    // Checksums from the index for a transfer of `file`, as long as the open file is the one the index
+    // was built from. The path may name another file by the time it is opened, and the file may be
+    // rewritten in place while it is sent; from the first lookup that sees a different identity on,
+    // checksums are taken from the bytes read instead.
+    PacketHelper::ChecksumLookup indexLookup(const std::string& fileName, const ChecksumHelper::Algorithm algorithm,
+                                             std::shared_ptr<const FileHelper::File> file) const {
+        auto index = checksumIndex.find(fileName, algorithm);
+        if (!index)
+            return nullptr;
+
+        return [index = std::move(index), file = std::move(file), current = true](const uint64_t offset, const size_t length,
+                                                                                 std::vector<BYTE>& checksum) mutable {
+            FileHelper::Identity identity;
+            current = current && FileHelper::getIdentity(*file, identity) && identity == index->identity();
+            return current && index->lookup(offset, length, checksum);
+        };
+    }
+
+    // Checksum for a "list" or "get": what the client asked for, else the configured one
+    ChecksumHelper::Algorithm checksumAlgorithm(const PacketHelper::ClientPacket& request) const {
+        const auto requested = request.getChecksumAlgorithm();
+        return requested != ChecksumHelper::Algorithm::None ? requested : serverConfig.checksumAlgorithm;
+    }
 
 public:
-    MessageProcessor(ServerConfig& serverConfig, PacketHelper& packetHelper)
-        : serverConfig(serverConfig), packetHelper(packetHelper) {}
+    MessageProcessor(ServerConfig& serverConfig, PacketHelper& packetHelper, ChecksumIndex& checksumIndex, ListingCache& listingCache,
+                     CompressionCache& compressionCache, FileMappings& fileMappings)
+        : serverConfig(serverConfig), packetHelper(packetHelper), checksumIndex(checksumIndex), listingCache(listingCache),
+          compressionCache(compressionCache), fileMappings(fileMappings) {}
 
     MessageHandler messageHandler = [&](const std::string& message, SOCKET clientSocket) {
-        std::cout << "Received: \n" << message << " | From client: " << clientSocket << std::endl;
-
         const auto clientPacket = packetHelper.parseClientPacket(message);
         const auto& clientPacketUUID = clientPacket.getUuid();
 
-        std::queue<std::string> serverPackets;
-        if (clientPacket.getId() == "list") {
-            const auto dir = serverConfig.filesDir;
-            serverPackets = packetHelper.server.getPacketList(clientPacketUUID, dir);
+        // Answer in the framing the request came in; clients switch to binary only after "hello"
+        const auto protocol = PacketHelper::isBinaryPacket(message) ? PacketHelper::Protocol::Binary : PacketHelper::Protocol::Text;
+
+        if (protocol == PacketHelper::Protocol::Binary)
+            std::cout << "Received binary: " << clientPacket.getId() << " " << clientPacket.getArgument() << " | From client: " << clientSocket << std::endl;
+        else
+            std::cout << "Received: \n" << message << " | From client: " << clientSocket << std::endl;
+
+        PacketQueue serverPackets;
+        if (clientPacket.getId() == "hello") {
+            serverPackets = packetHelper.server.getPacketHello(clientPacketUUID, clientPacket.getArgument());
+        } else if (clientPacket.getId() == "list") {
+            const auto page = PacketHelper::ListPage::parse(clientPacket.getArgument());
+            serverPackets = listingCache.list(clientPacketUUID, protocol, checksumAlgorithm(clientPacket), page);
         } else if (clientPacket.getId() == "get") {
             const auto& fileName = clientPacket.getArgument();
-            std::string filePath = serverConfig.filesDir + "\\" + fileName;
-            std::fstream file(filePath, std::ios::in | std::ios::binary);
-            serverPackets = packetHelper.server.getPacketGet(clientPacketUUID, fileName, file);
+            const auto filePath = resolveFilePath(fileName);
+
+            auto nextChunkSize = chunkSizer(clientPacket, clientSocket);
+
+            // Compressed chunks have to pass through memory, so a client asking for them gets no raw payload
+            const auto codec = serverConfig.compression ? clientPacket.getCompression() : CompressionHelper::Codec::None;
+
+            if (protocol == PacketHelper::Protocol::Binary && clientPacket.acceptsRawPayload() && codec == CompressionHelper::Codec::None) {
+                auto file = std::make_shared<const FileHelper::File>(filePath);
+                if (!file->isOpen())
+                    serverPackets = packetHelper.server.getPacketNotFound(clientPacketUUID, "get", fileName, protocol);
+                else
+                    serverPackets = packetHelper.server.getPacketGetRaw(clientPacketUUID, fileName, std::move(file), std::move(nextChunkSize),
+                                                                        clientPacket.getRange());
+            } else {
+                const auto algorithm = checksumAlgorithm(clientPacket);
+
+                PacketHelper::ChunkCompressor compressor;
+                if (codec != CompressionHelper::Codec::None)
+                    compressor = compressionCache.compressor(fileName, filePath, codec);
+
+                // Unchanged files take their checksums from the index instead of hashing every chunk
+                auto file = fileMappings.open(filePath);
+                if (!file->isOpen()) {
+                    serverPackets = packetHelper.server.getPacketNotFound(clientPacketUUID, "get", fileName, protocol);
+                } else {
+                    auto knownChecksums = indexLookup(fileName, algorithm, std::shared_ptr<const FileHelper::File>(file, &file->file()));
+                    serverPackets = packetHelper.server.getPacketGet(clientPacketUUID, fileName, std::move(file), protocol,
+                                                                     std::move(nextChunkSize), algorithm, std::move(knownChecksums),
+                                                                     clientPacket.getRange(), std::move(compressor));
+                }
+            }
+
+            // File contents yield to listings and metadata on the way out
+            serverPackets.setTrafficClass(TrafficClass::Bulk);
+        } else if (clientPacket.getId() == "sync") {
+            const auto& fileName = clientPacket.getArgument();
+            const auto filePath = resolveFilePath(fileName);
+
+            // A signature that cannot be read matches nothing, so the whole file goes literally
+            DeltaHelper::Signature signature;
+            if (!DeltaHelper::parseSignature(clientPacket.getContent(), signature))
+                signature = {};
+
+            // The delta of a file that cannot be opened is empty and would leave the client an empty copy
+            auto file = std::make_shared<const FileHelper::File>(filePath);
+            if (!file->isOpen())
+                serverPackets = packetHelper.server.getPacketNotFound(clientPacketUUID, "sync", fileName, protocol);
+            else
+                serverPackets = packetHelper.server.getPacketSync(clientPacketUUID, fileName, std::move(file), protocol, std::move(signature),
+                                                                  serverConfig.chunkSize, checksumAlgorithm(clientPacket));
+            serverPackets.setTrafficClass(TrafficClass::Bulk);
+        } else if (clientPacket.getId() == "sums") {
+            const auto& fileName = clientPacket.getArgument();
+            const auto filePath = resolveFilePath(fileName);
+
+            // Checksums only make sense with an algorithm; the index's chunk size unless one was asked for
+            auto algorithm = checksumAlgorithm(clientPacket);
+            if (algorithm == ChecksumHelper::Algorithm::None)
+                algorithm = ChecksumHelper::Algorithm::Sha256;
+            const size_t chunkSize = clientPacket.getChunkSize() > 0
+                ? std::clamp(clientPacket.getChunkSize(), serverConfig.minChunkSize, serverConfig.maxChunkSize)
+                : serverConfig.chunkSize;
+
+            // A resume must not take a missing file for an empty one and cut the local copy down to nothing
+            auto file = std::make_shared<const FileHelper::File>(filePath);
+            if (!file->isOpen()) {
+                serverPackets = packetHelper.server.getPacketNotFound(clientPacketUUID, "sums", fileName, protocol);
+            } else {
+                auto knownChecksums = indexLookup(fileName, algorithm, file);
+                serverPackets = packetHelper.server.getPacketSums(clientPacketUUID, fileName, std::move(file), protocol, chunkSize, algorithm,
+                                                                  std::move(knownChecksums), clientPacket.getRange());
+            }
         }
 
         return serverPackets;
@@ -0,0 +1,108 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "ConnectionContext.h"
+#include "FileHelper.h"
+
+// Kind of operation a completion refers to
+enum class IoOperation {
+    None,   // Wake-up packet or cancelled completion
+    Recv,
+    Send,
+    Accept  // Only produced by backends that support asynchronous accept
+};
+
+// Result of a previously posted operation, modelled after an IOCP completion packet
+struct IoCompletion {
+    static constexpr unsigned NO_BUFFER = ~0u;
+
+    ConnectionContext* context = nullptr; // nullptr for wake-up packets and accepts
+    IoOperation operation = IoOperation::None;
+    size_t bytesTransferred = 0;
+    bool success = false;
+    const char* data = nullptr;           // Received bytes for Recv completions
+    unsigned bufferId = NO_BUFFER;        // Backend-owned receive buffer, see Reactor::releaseRecvBuffer
+    SOCKET acceptedSocket = INVALID_SOCKET; // New connection for Accept completions
+};
+
+// OS event mechanism behind ServerRunner.
+// Every posted operation completes exactly once through waitForCompletion(), unless dissociate()
+// drops it, regardless of whether the backend is completion-based (IOCP) or readiness-based (epoll).
+class Reactor {
+public:
+    virtual ~Reactor() = default;
+
+    virtual const char* name() const = 0;
+
+    virtual bool open() = 0;
+    virtual void close() = 0;
+
+    // Start/stop delivering events for a connection. dissociate() returns how many of the connection's
+    // posted operations it dropped, still pending or completed and queued: these will not come out of
+    // waitForCompletion() after all.
+    virtual bool associate(ConnectionContext* context) = 0;
+    virtual size_t dissociate(ConnectionContext* context) = 0;
+
+    // Accept connections on the listening socket asynchronously; backends that return
+    // false from supportsAccept() are fed by ServerRunner's blocking accept thread instead
+    virtual bool supportsAccept() const { return false; }
+    virtual bool postAccept(SOCKET) { return false; }
+
+    // Request the next receive completion for the connection.
+    // Completion data lives in context->recvBuffer or in a backend-owned buffer.
+    virtual bool postRecv(ConnectionContext* context) = 0;
+
+    // Return a backend-owned receive buffer once the completion data has been consumed
+    virtual void releaseRecvBuffer(const IoCompletion&) {}
+
+    // Send context->sendFrames as one vectored write; completes as a single Send once all of it is written.
+    // The frames stay untouched until then.
+    virtual bool postSend(ConnectionContext* context) = 0;
+
+    // Send context->sendFrames followed by `length` bytes of `file` from `offset`,
+    // moved by the kernel without a user-space copy; completes as a single Send.
+    // The backend keeps the file open until the kernel is done with it.
+    virtual bool supportsSendFile() const { return false; }
+    virtual bool postSendFile(ConnectionContext*, std::shared_ptr<const FileHelper::File>, uint64_t /*offset*/, size_t /*length*/) { return false; }
+
+    // Block until a completion is available; returns false on failure of the wait itself
+    virtual bool waitForCompletion(IoCompletion& completion) = 0;
+
+    // Queue `count` wake-up packets (completions with a null context)
+    virtual void wakeup(size_t count) = 0;
+
+protected:
+#ifndef _WIN32
+    // Point context->sendIov at the frames of a new send; returns their total size
+    static size_t prepareSendIov(ConnectionContext* context) {
+        size_t total = 0;
+        context->sendIov.clear();
+        context->sendIovIndex = 0;
+        for (auto& frame : context->sendFrames) {
+            if (frame.empty()) continue;
+            context->sendIov.push_back({ frame.data(), frame.size() });
+            total += frame.size();
+        }
+        return total;
+    }
+
+    // Drop `bytes` written by a short write from the front of context->sendIov
+    static void advanceSendIov(ConnectionContext* context, size_t bytes) {
+        while (bytes > 0 && context->sendIovIndex < context->sendIov.size()) {
+            iovec& entry = context->sendIov[context->sendIovIndex];
+            const size_t taken = std::min(bytes, entry.iov_len);
+            entry.iov_base = static_cast<char*>(entry.iov_base) + taken;
+            entry.iov_len -= taken;
+            bytes -= taken;
+            if (entry.iov_len == 0) ++context->sendIovIndex;
+        }
+    }
+#endif
+};
+
+#endif //REACTOR_H
@@ -1,26 +1,83 @@
 #ifndef SERVERCONFIG_H
 #define SERVERCONFIG_H
 
+#include <algorithm>
+#include <string>
+
+#include "ChecksumHelper.h"
 #include "ConfigHelper.h"
 #include "FileHelper.h"
 
 class ServerConfig {
 public:
     unsigned short serverPort;
+    std::string ioEngine;
+    size_t ioThreads;                // Worker threads waiting on the reactors, 0 for one per hardware thread
+    bool sharded;                    // A reactor, listener and pinned hardware thread per worker thread
+    size_t cpuThreads;               // Threads producing packets, 0 for one per hardware thread
+    size_t diskThreads;              // Threads running request handlers
     std::string filesDir;
+    bool listCache;                  // Answer "list" from a watched in-memory listing
+    size_t chunkSize;                // Content bytes per "get" packet unless the client asks otherwise
+    size_t minChunkSize;             // Bounds for sizes requested by clients or picked adaptively
+    size_t maxChunkSize;
+    bool adaptiveChunks;             // Size chunks from the connection's RTT and bandwidth
+    ChecksumHelper::Algorithm checksumAlgorithm; // Packet checksum unless the client asks otherwise
+    size_t sendBatchBytes;           // Queued frames gathered into one vectored send, up to this many bytes
+    bool tcpNoDelay;                 // Disable Nagle's algorithm on client connections
+    bool tcpCork;                    // Hold the end of a send back while more is queued (Linux)
+    size_t connectionQueueBytes;     // Responses a connection may have queued before it is no longer read from
+    size_t totalQueueBytes;          // The same for all connections together
+    bool compression;                // Compress "get" chunks for clients that ask for it
+    size_t compressionCacheSize;     // Bytes of compressed chunks of hot files kept in memory, 0 disables
+    std::string indexDir;            // Sidecar chunk checksum index; empty disables it
+    bool eagerIndexing;              // Index all files at startup instead of on first "get"
 
     ServerConfig(ConfigHelper& config) {
         const auto serverPort = config.readIni("Server", "port");
         this->serverPort = static_cast<unsigned short>(std::stoi(serverPort));
+        this->ioEngine = config.readIni("Server", "engine", "auto");
+        this->ioThreads = std::stoull(config.readIni("Server", "io_threads", "0"));
+        this->sharded = config.readIni("Server", "sharded", "false") == "true";
+        this->cpuThreads = std::stoull(config.readIni("Server", "cpu_threads", "0"));
+        this->diskThreads = std::max<size_t>(std::stoull(config.readIni("Server", "disk_threads", "4")), 1);
 
         this->filesDir = config.readIni("Files", "dir");
         FileHelper::createAllSubdirectories(filesDir);
+        this->listCache = config.readIni("Files", "list_cache", "true") == "true";
+
+        this->minChunkSize = std::max<size_t>(std::stoull(config.readIni("Transfer", "min_chunk_size", "512")), 1);
+        this->maxChunkSize = std::max<size_t>(std::stoull(config.readIni("Transfer", "max_chunk_size", "4194304")), minChunkSize);
+        this->chunkSize = std::clamp<size_t>(std::stoull(config.readIni("Transfer", "chunk_size", "262144")), minChunkSize, maxChunkSize);
+        this->adaptiveChunks = config.readIni("Transfer", "adaptive", "false") == "true";
+        this->checksumAlgorithm = ChecksumHelper::fromName(config.readIni("Transfer", "checksum", "sha256"));
+        this->sendBatchBytes = std::max<size_t>(std::stoull(config.readIni("Transfer", "send_batch", "262144")), 1);
+        this->tcpNoDelay = config.readIni("Transfer", "tcp_nodelay", "true") == "true";
+        this->tcpCork = config.readIni("Transfer", "tcp_cork", "false") == "true";
+        this->connectionQueueBytes = std::stoull(config.readIni("Transfer", "queue_limit", "8388608"));
+        this->totalQueueBytes = std::stoull(config.readIni("Transfer", "queue_budget", "268435456"));
+        this->compression = config.readIni("Transfer", "compression", "true") == "true";
+        this->compressionCacheSize = std::stoull(config.readIni("Transfer", "compression_cache", "67108864"));
+
+        this->indexDir = config.readIni("Index", "dir", "");
+        this->eagerIndexing = config.readIni("Index", "mode", "lazy") == "eager";
     }
 
     std::string toString() {
         std::string result;
         result += "serverPort: " + std::to_string(serverPort) + "\n";
+        result += "ioEngine: " + ioEngine + "\n";
+        result += "ioThreads: " + (ioThreads > 0 ? std::to_string(ioThreads) : std::string("auto")) + (sharded ? " (sharded)" : "") + "\n";
+        result += "handlerThreads: " + (cpuThreads > 0 ? std::to_string(cpuThreads) : std::string("auto")) + " cpu, " + std::to_string(diskThreads) + " disk\n";
         result += "filesDir: " + filesDir + "\n";
+        result += "listCache: " + std::string(listCache ? "true" : "false") + "\n";
+        result += "chunkSize: " + std::to_string(chunkSize) + " (" + std::to_string(minChunkSize) + "-" + std::to_string(maxChunkSize) + ")" + "\n";
+        result += "adaptiveChunks: " + std::string(adaptiveChunks ? "true" : "false") + "\n";
+        result += "checksum: " + std::string(ChecksumHelper::name(checksumAlgorithm)) + "\n";
+        result += "sendBatch: " + std::to_string(sendBatchBytes) + " bytes (nodelay " + (tcpNoDelay ? "true" : "false") + ", cork " + (tcpCork ? "true" : "false") + ")\n";
+        result += "queueLimit: " + std::to_string(connectionQueueBytes) + " bytes (budget " + std::to_string(totalQueueBytes) + ")\n";
+        result += "compression: " + (compression ? "true (cache " + std::to_string(compressionCacheSize) + " bytes)" : std::string("false")) + "\n";
+        result += "indexDir: " + (indexDir.empty() ? std::string("disabled") : indexDir + (eagerIndexing ? " (eager)" : " (lazy)")) + "\n";
         return result;
     }
 };
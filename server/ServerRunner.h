@@ -3,10 +3,6 @@
 
 #pragma once
 
-#include <winsock2.h>
-#include <windows.h>
-#include <mswsock.h>
-#include <ws2tcpip.h>
 #include <ranges>
 #include <string>
 #include <queue>
@@ -14,51 +10,65 @@
 #include <mutex>
 #include <atomic>
 #include <memory>
+#include <thread>
 #include <functional>
 #include <unordered_map>
 #include <deque>
 
+#include "PlatformHelper.h"
+#include "LockFreeQueue.h"
+#include "MemoryPool.h"
+#include "PacketQueue.h"
+#include "ConnectionContext.h"
+#include "EgressScheduler.h"
+#include "Reactor.h"
+#include "IocpReactor.h"
+#include "EpollReactor.h"
+#include "UringReactor.h"
+#include "WorkStealingExecutor.h"
+
 // Callback function type for processing received messages
-using MessageHandler = std::function<std::queue<std::string>(const std::string&, SOCKET)>;
+using MessageHandler = std::function<PacketQueue(const std::string&, SOCKET)>;
+
+// Connection contexts are recycled through a slab pool rather than allocated per connection
+using ConnectionPool = SlabPool<ConnectionContext>;
 
 class ServerRunner {
 public:
     // Define constants for buffer sizes and thread pool size
-    static constexpr size_t DEFAULT_BUFFER_SIZE = 4096;
+    static constexpr size_t DEFAULT_BUFFER_SIZE = ConnectionContext::DEFAULT_BUFFER_SIZE;
     static constexpr int DEFAULT_THREAD_COUNT = 2;
     static constexpr int DEFAULT_PORT = 8080;
-    static constexpr int INTERLEAVE_BATCH_SIZE = 10; // Number of messages to process from each queue before switching
-
-    // Per-connection data structure
-    struct ConnectionContext {
-        SOCKET socket;                   // Client socket
-        WSAOVERLAPPED recvOverlapped;    // Overlapped structure for recv operations
-        WSAOVERLAPPED sendOverlapped;    // Overlapped structure for send operations
-        char recvBuffer[DEFAULT_BUFFER_SIZE]; // Buffer for receiving data
-        std::vector<char> sendBuffer;    // Buffer for sending data
-        WSABUF wsaRecvBuffer;            // WSA buffer for recv operations
-        WSABUF wsaSendBuffer;            // WSA buffer for send operations
-        std::deque<std::queue<std::string>> messageQueues; // Multiple message queues for interleaving
-        std::mutex sendMutex;            // Mutex to protect messageQueues
-        bool isSending;                  // Flag to indicate if a send operation is in progress
-        size_t currentQueueIndex;        // Current queue index for round-robin processing
-
-        ConnectionContext(const SOCKET s) : socket(s), isSending(false), currentQueueIndex(0) {
-            ZeroMemory(&recvOverlapped, sizeof(WSAOVERLAPPED));
-            ZeroMemory(&sendOverlapped, sizeof(WSAOVERLAPPED));
-            ZeroMemory(recvBuffer, DEFAULT_BUFFER_SIZE);
-
-            wsaRecvBuffer.buf = recvBuffer;
-            wsaRecvBuffer.len = DEFAULT_BUFFER_SIZE;
-
-            wsaSendBuffer.buf = nullptr;
-            wsaSendBuffer.len = 0;
-        }
+    static constexpr size_t DEFAULT_SEND_BATCH_BYTES = 256 * 1024;
+    static constexpr size_t MIN_SENDFILE_BYTES = 64 * 1024; // Smaller file payloads are read into the batch instead
+    static constexpr size_t DEFAULT_CONNECTION_QUEUE_BYTES = 8 * 1024 * 1024;
+    static constexpr size_t DEFAULT_TOTAL_QUEUE_BYTES = 256 * 1024 * 1024;
+    static constexpr size_t RESPONSE_OVERHEAD = 4096; // Charged per queued response for its producer's state
+    static constexpr size_t DEFAULT_DISK_THREADS = 4;
+
+    // How queued frames are put on the wire
+    struct SendOptions {
+        size_t batchBytes = DEFAULT_SEND_BATCH_BYTES; // Frames are gathered into one vectored send until it holds this many bytes
+        bool noDelay = true;                          // TCP_NODELAY: the end of a send goes out without waiting for ACKs
+        bool cork = false;                            // Keep the end of a send in the socket while more is queued (MSG_MORE, Linux only)
+    };
+
+    // Memory the outbound queues may hold; a connection over either limit is not read from until it drains
+    struct QueueLimits {
+        size_t connectionBytes = DEFAULT_CONNECTION_QUEUE_BYTES; // Responses of one connection
+        size_t totalBytes = DEFAULT_TOTAL_QUEUE_BYTES;           // Responses of all connections together
     };
 
-    // Constructor
-    ServerRunner(const unsigned short port = DEFAULT_PORT, const size_t threadCount = DEFAULT_THREAD_COUNT)
-        : m_port(port), m_threadCount(threadCount), m_running(false), m_completionPort(nullptr), m_listenSocket(INVALID_SOCKET) {
+    // Executors that take work off the I/O threads
+    struct HandlerOptions {
+        size_t cpuThreads = 0;                     // Produce packets (hashing, compressing, encoding); 0: one per hardware thread
+        size_t diskThreads = DEFAULT_DISK_THREADS; // Run request handlers (opening files, scanning directories)
+    };
+
+    // Constructor; ioEngine selects the reactor backend ("auto", "iocp", "epoll" or "io_uring"), and a
+    // threadCount of 0 runs one worker thread per hardware thread
+    ServerRunner(const unsigned short port = DEFAULT_PORT, const size_t threadCount = DEFAULT_THREAD_COUNT, const std::string& ioEngine = "auto")
+        : m_port(port), m_threadCount(threadCount > 0 ? threadCount : PlatformHelper::availableCpus()), m_ioEngine(ioEngine), m_running(false) {
     }
 
     // Destructor
@@ -66,110 +76,96 @@ public:
         stop();
     }
 
-    // Start the server
-    bool start(const MessageHandler &handler) {
-        m_messageHandler = handler;
+    // Set before start()
+    void setSendOptions(const SendOptions& options) {
+        m_sendOptions = options;
+    }
 
-        // Initialize Winsock
-        WSADATA wsaData;
-        int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
-        if (result != 0) {
-            printf("WSAStartup failed: %d\n", result);
-            return false;
-        }
+    // Set before start()
+    void setQueueLimits(const QueueLimits& limits) {
+        m_queueLimits = limits;
+    }
 
-        // Create completion port
-        m_completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 0);
-        if (m_completionPort == nullptr) {
-            printf("CreateIoCompletionPort failed: %d\n", GetLastError());
-            WSACleanup();
-            return false;
-        }
+    // Set before start()
+    void setHandlerOptions(const HandlerOptions& options) {
+        m_handlerOptions = options;
+    }
 
-        // Create listening socket
-        m_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-        if (m_listenSocket == INVALID_SOCKET) {
-            printf("socket failed: %d\n", WSAGetLastError());
-            CloseHandle(m_completionPort);
-            WSACleanup();
-            return false;
-        }
+    // Set before start(). Sharded, every worker thread gets a reactor and listener of its own and is
+    // pinned to a hardware thread; otherwise all worker threads share one reactor and listener.
+    void setSharded(const bool sharded) {
+        m_sharded = sharded;
+    }
 
-        // Set up server address
-        sockaddr_in serverAddr{};
-        serverAddr.sin_family = AF_INET;
-        serverAddr.sin_addr.s_addr = INADDR_ANY;
-        serverAddr.sin_port = htons(m_port);
+    // Start the server
+    bool start(const MessageHandler &handler) {
+        m_messageHandler = handler;
 
-        // Bind socket
-        result = bind(m_listenSocket, reinterpret_cast<sockaddr *>(&serverAddr), sizeof(serverAddr));
-        if (result == SOCKET_ERROR) {
-            printf("bind failed: %d\n", WSAGetLastError());
-            closesocket(m_listenSocket);
-            CloseHandle(m_completionPort);
-            WSACleanup();
+        // Initialize the socket library
+        if (!PlatformHelper::initSockets()) {
             return false;
         }
 
-        // Start listening
-        result = listen(m_listenSocket, SOMAXCONN);
-        if (result == SOCKET_ERROR) {
-            printf("listen failed: %d\n", WSAGetLastError());
-            closesocket(m_listenSocket);
-            CloseHandle(m_completionPort);
-            WSACleanup();
-            return false;
+        // Create the OS event mechanism of every shard
+        const size_t shardCount = m_sharded ? m_threadCount : 1;
+        for (size_t i = 0; i < shardCount; i++) {
+            auto shard = std::make_unique<Shard>();
+            shard->index = i;
+            shard->reactor = openReactor(m_ioEngine);
+            if (!shard->reactor) {
+                closeShards();
+                return false;
+            }
+            m_shards.push_back(std::move(shard));
         }
 
-        // Associate the listen socket with the completion port
-        if (CreateIoCompletionPort(reinterpret_cast<HANDLE>(m_listenSocket), m_completionPort, 0, 0) == nullptr) {
-            printf("CreateIoCompletionPort for listen socket failed: %d\n", GetLastError());
-            closesocket(m_listenSocket);
-            CloseHandle(m_completionPort);
-            WSACleanup();
-            return false;
+        // With SO_REUSEPORT every shard listens on the port itself and the kernel spreads connections
+        // over them; otherwise the first shard's listener hands connections to the shards in turn
+        m_listenerPerShard = shardCount > 1 && PlatformHelper::supportsReusePort();
+        for (const auto& shard : m_shards) {
+            shard->listenSocket = openListener(m_listenerPerShard);
+            if (shard->listenSocket == INVALID_SOCKET) {
+                closeShards();
+                return false;
+            }
+
+            if (!m_listenerPerShard) {
+                break;
+            }
         }
 
         m_running = true;
 
-        // Start the accept thread
-        m_acceptThread = CreateThread(
-            nullptr,                         // Default security attributes
-            0,                               // Default stack size
-            &ServerRunner::acceptThreadFunc, // Thread function
-            this,                            // Parameter to thread function
-            0,                               // Run immediately
-            &m_acceptThreadId                // Thread identifier
-        );
-
-        if (m_acceptThread == nullptr) {
-            printf("Failed to create accept thread: %d\n", GetLastError());
-            stop();
-            return false;
+        // Accept through the reactors that can; the others get accept threads below
+        for (const auto& shard : m_shards) {
+            if (shard->listenSocket != INVALID_SOCKET && shard->reactor->supportsAccept() && !shard->reactor->postAccept(shard->listenSocket)) {
+                printf("Failed to post accept\n");
+                m_running = false;
+                closeShards();
+                return false;
+            }
         }
 
-        // Start worker threads
-        m_workerThreads.resize(m_threadCount);
-        m_workerThreadIds.resize(m_threadCount);
+        // Start the executors, then the threads that hand work to them
+        const size_t cpuThreads = m_handlerOptions.cpuThreads > 0 ? m_handlerOptions.cpuThreads : PlatformHelper::availableCpus();
+        m_cpuExecutor.start(cpuThreads);
+        m_diskExecutor.start(std::max<size_t>(m_handlerOptions.diskThreads, 1));
 
-        for (size_t i = 0; i < m_threadCount; i++) {
-            m_workerThreads[i] = CreateThread(
-                nullptr,                          // Default security attributes
-                0,                                // Default stack size
-                &ServerRunner::workerThreadFunc,  // Thread function
-                this,                             // Parameter to thread function
-                0,                                // Run immediately
-                &m_workerThreadIds[i]             // Thread identifier
-            );
+        for (const auto& shard : m_shards) {
+            if (shard->listenSocket != INVALID_SOCKET && !shard->reactor->supportsAccept()) {
+                shard->acceptThread = std::thread(&ServerRunner::acceptThreadProc, this, std::ref(*shard));
+            }
 
-            if (m_workerThreads[i] == nullptr) {
-                printf("Failed to create worker thread %zu: %d\n", i, GetLastError());
-                stop();
-                return false;
+            const size_t workerCount = m_sharded ? 1 : m_threadCount;
+            shard->workerThreads.reserve(workerCount);
+            for (size_t i = 0; i < workerCount; i++) {
+                shard->workerThreads.emplace_back(&ServerRunner::workerThreadProc, this, std::ref(*shard));
             }
         }
 
-        printf("Server started on port %d with %llu worker threads\n", m_port, m_threadCount);
+        printf("Server started on port %d with %zu worker threads in %zu %s (%s), %zu CPU and %zu disk handler threads\n", m_port,
+               m_threadCount, m_shards.size(), m_shards.size() == 1 ? "shard" : "shards", m_shards.front()->reactor->name(),
+               m_cpuExecutor.threadCount(), m_diskExecutor.threadCount());
         return true;
     }
 
@@ -179,341 +175,870 @@ public:
 
         m_running = false;
 
-        // Close the listen socket to stop accepting new connections
-        closesocket(m_listenSocket);
-        m_listenSocket = INVALID_SOCKET;
-
-        // Post completion packets to wake up worker threads
-        for (size_t i = 0; i < m_workerThreads.size(); i++) {
-            PostQueuedCompletionStatus(m_completionPort, 0, static_cast<ULONG_PTR>(NULL), nullptr);
-        }
+        for (const auto& shard : m_shards) {
+            // Close the listen socket to stop accepting new connections
+            if (shard->listenSocket != INVALID_SOCKET) {
+                PlatformHelper::shutdownListenSocket(shard->listenSocket);
+                shard->listenSocket = INVALID_SOCKET;
+            }
 
-        // Wait for accept thread to finish
-        if (m_acceptThread != nullptr) {
-            WaitForSingleObject(m_acceptThread, INFINITE);
-            CloseHandle(m_acceptThread);
-            m_acceptThread = nullptr;
+            // Post completion packets to wake up worker threads
+            shard->reactor->wakeup(shard->workerThreads.size());
         }
 
-        // Wait for worker threads to finish
-        if (!m_workerThreads.empty()) {
-            WaitForMultipleObjects(
-                m_workerThreads.size(),
-                m_workerThreads.data(),
-                TRUE,
-                INFINITE
-            );
+        for (const auto& shard : m_shards) {
+            // Wait for accept thread to finish
+            if (shard->acceptThread.joinable()) {
+                shard->acceptThread.join();
+            }
 
-            // Close thread handles
-            for (const auto& thread : m_workerThreads) {
-                CloseHandle(thread);
+            // Wait for worker threads to finish
+            for (auto& thread : shard->workerThreads) {
+                thread.join();
             }
-            m_workerThreads.clear();
-            m_workerThreadIds.clear();
+            shard->workerThreads.clear();
         }
 
-        // Close all client connections
-        for (const auto& connectionContext: m_connections | std::views::values) {
-            closesocket(connectionContext->socket);
-            delete connectionContext;
+        // Let the executors run what is queued; the work they hand back is dropped with its references
+        m_cpuExecutor.stop();
+        m_diskExecutor.stop();
+        for (const auto& shard : m_shards) {
+            for (HandOff* handOff = shard->handOffs.takeAll(); handOff;) {
+                HandOff* next = handOff->next;
+                release(handOff->context);
+                HandOffPool::instance().destroy(handOff);
+                handOff = next;
+            }
+        }
+        for (ConnectionContext* context : m_parked) {
+            release(context);
         }
-        m_connections.clear();
+        m_parked.clear();
+        m_parkedCount = 0;
 
-        // Clean up completion port
-        if (m_completionPort != nullptr) {
-            CloseHandle(m_completionPort);
-            m_completionPort = nullptr;
+        // Close all client connections
+        for (const auto& shard : m_shards) {
+            for (const auto& connectionContext: shard->connections | std::views::values) {
+                shard->scheduler.remove(connectionContext);
+                shard->reactor->dissociate(connectionContext);
+                closesocket(connectionContext->socket);
+                ConnectionPool::instance().destroy(connectionContext);
+            }
+            shard->connections.clear();
         }
 
-        // Clean up Winsock
-        WSACleanup();
+        // Clean up the reactors and the socket library
+        closeShards();
 
         printf("Server stopped\n");
     }
 
 private:
-    // Static thread entry point functions
-    static DWORD WINAPI acceptThreadFunc(LPVOID lpParam) {
-        auto* server = static_cast<ServerRunner*>(lpParam);
-        server->acceptThreadProc();
-        return 0;
+    // Work an executor finished, handed back for an I/O thread to act on
+    // A file payload sent in a send's frames rather than from the file: read on a disk thread
+    // into the frame, which already has room for it behind the packet's header
+    struct PayloadRead {
+        size_t frame = 0;
+        size_t headerSize = 0;
+        std::shared_ptr<const FileHelper::File> file;
+        uint64_t fileOffset = 0;
+        size_t fileLength = 0;
+    };
+
+    struct HandOff {
+        enum class Kind { Responses, Send, Resume };
+
+        Kind kind = Kind::Responses;
+        ConnectionContext* context = nullptr;         // Holds a reference until the hand-off is acted on
+        PacketQueue responses;                        // Responses: what the handler returned
+        std::shared_ptr<const FileHelper::File> file; // Send: payload that follows the frames, if any
+        uint64_t fileOffset = 0;
+        size_t fileLength = 0;
+        std::vector<PayloadRead> reads;               // Send: payloads to read in behind their headers first
+        bool payloadRead = true;                      // Send: false if a payload could not be read
+        HandOff* next = nullptr;                      // Link in Shard::handOffs
+    };
+
+    using HandOffPool = SlabPool<HandOff>;
+
+    // A reactor with the worker threads that wait on it and the connections it serves. Connections
+    // stay on the shard that accepted them, and everything posted to a reactor is posted from its own
+    // worker threads.
+    struct Shard {
+        size_t index = 0;
+        std::unique_ptr<Reactor> reactor; // OS event mechanism (IOCP, epoll or io_uring)
+        SOCKET listenSocket = INVALID_SOCKET; // Own listener with SO_REUSEPORT; otherwise only the first shard has one
+        std::thread acceptThread;         // Thread for accepting connections (reactors without async accept)
+        std::vector<std::thread> workerThreads;
+        EgressScheduler scheduler;        // Order in which the shard's connections send
+        LockFreeQueue<HandOff> handOffs;  // Work the executors finished, for the worker threads
+        std::atomic<bool> handOffWakeup{false}; // A wake-up is on its way to take handOffs
+
+        // Map of active connections
+        std::unordered_map<SOCKET, ConnectionContext*> connections;
+        std::mutex connectionsMutex; // Mutex to protect connections
+    };
+
+    // Pick the event mechanism; "auto" prefers io_uring and falls back to epoll on Linux
+    static std::unique_ptr<Reactor> createReactor(const std::string& ioEngine) {
+#ifdef _WIN32
+        return std::make_unique<IocpReactor>();
+#else
+        if (ioEngine == "epoll") {
+            return std::make_unique<EpollReactor>();
+        }
+
+        if (ioEngine == "io_uring" || UringReactor::isSupported()) {
+            return std::make_unique<UringReactor>();
+        }
+
+        return std::make_unique<EpollReactor>();
+#endif
     }
 
-    static DWORD WINAPI workerThreadFunc(LPVOID lpParam) {
-        auto* server = static_cast<ServerRunner*>(lpParam);
-        server->workerThreadProc();
-        return 0;
+    // Create and open the event mechanism; "auto" falls back to epoll if io_uring passed the probe
+    // but cannot be set up after all. nullptr on failure.
+    static std::unique_ptr<Reactor> openReactor(const std::string& ioEngine) {
+        auto reactor = createReactor(ioEngine);
+        if (reactor->open()) {
+            return reactor;
+        }
+
+#ifndef _WIN32
+        if (ioEngine == "auto" && std::string(reactor->name()) == "io_uring") {
+            printf("io_uring could not be set up, falling back to epoll\n");
+            reactor = std::make_unique<EpollReactor>();
+            if (reactor->open()) {
+                return reactor;
+            }
+        }
+#endif
+
+        return nullptr;
+    }
+
+    // Create a socket listening on the server port; INVALID_SOCKET on failure
+    SOCKET openListener(const bool reusePort) {
+        SOCKET listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listenSocket == INVALID_SOCKET) {
+            printf("socket failed: %d\n", PlatformHelper::lastSocketError());
+            return INVALID_SOCKET;
+        }
+
+#ifndef _WIN32
+        // Allow quick restarts while old connections linger in TIME_WAIT
+        constexpr int reuseAddr = 1;
+        setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuseAddr, sizeof(reuseAddr));
+#endif
+
+        if (reusePort && !PlatformHelper::setReusePort(listenSocket)) {
+            printf("setsockopt SO_REUSEPORT failed: %d\n", PlatformHelper::lastSocketError());
+            closesocket(listenSocket);
+            return INVALID_SOCKET;
+        }
+
+        // Set up server address
+        sockaddr_in serverAddr{};
+        serverAddr.sin_family = AF_INET;
+        serverAddr.sin_addr.s_addr = INADDR_ANY;
+        serverAddr.sin_port = htons(m_port);
+
+        // Bind socket
+        int result = bind(listenSocket, reinterpret_cast<sockaddr *>(&serverAddr), sizeof(serverAddr));
+        if (result == SOCKET_ERROR) {
+            printf("bind failed: %d\n", PlatformHelper::lastSocketError());
+            closesocket(listenSocket);
+            return INVALID_SOCKET;
+        }
+
+        // Start listening
+        result = listen(listenSocket, SOMAXCONN);
+        if (result == SOCKET_ERROR) {
+            printf("listen failed: %d\n", PlatformHelper::lastSocketError());
+            closesocket(listenSocket);
+            return INVALID_SOCKET;
+        }
+
+        return listenSocket;
+    }
+
+    // Close the listeners and reactors of all shards, then the socket library
+    void closeShards() {
+        for (const auto& shard : m_shards) {
+            if (shard->listenSocket != INVALID_SOCKET) {
+                closesocket(shard->listenSocket);
+            }
+            shard->reactor->close();
+        }
+        m_shards.clear();
+
+        PlatformHelper::cleanupSockets();
+    }
+
+    Shard& shardOf(const ConnectionContext* context) {
+        return *m_shards[context->shard];
+    }
+
+    // Sharded, a shard's threads run on its own hardware thread
+    void pinToShard(const Shard& shard) {
+        if (m_sharded && !PlatformHelper::pinThread(shard.index)) {
+            printf("Failed to pin shard %zu to a hardware thread\n", shard.index);
+        }
     }
 
     // Thread procedure for accepting connections
-    void acceptThreadProc() {
+    void acceptThreadProc(Shard& shard) {
+        pinToShard(shard);
+
         while (m_running) {
             // Accept a new connection
             sockaddr_in clientAddr{};
-            int addrLen = sizeof(clientAddr);
-            SOCKET clientSocket = accept(m_listenSocket, reinterpret_cast<sockaddr *>(&clientAddr), &addrLen);
+            socklen_t addrLen = sizeof(clientAddr);
+            SOCKET clientSocket = accept(shard.listenSocket, reinterpret_cast<sockaddr *>(&clientAddr), &addrLen);
 
             if (clientSocket == INVALID_SOCKET) {
                 if (m_running) {
-                    printf("accept failed: %d\n", WSAGetLastError());
+                    printf("accept failed: %d\n", PlatformHelper::lastSocketError());
                 }
                 continue;
             }
 
-            // Get client IP address and port for logging
-            char clientIP[INET_ADDRSTRLEN];
-            inet_ntop(AF_INET, &(clientAddr.sin_addr), clientIP, INET_ADDRSTRLEN);
-            const int clientPort = ntohs(clientAddr.sin_port);
-            printf("New connection from %s:%d\n", clientIP, clientPort);
+            handleAccept(shard, clientSocket);
+        }
+    }
 
-            // Create a new connection context
-            auto* context = new ConnectionContext(clientSocket);
+    // Set up a newly accepted connection on the shard that accepted it, or on the next in turn if
+    // the shards share one listener
+    void handleAccept(Shard& acceptingShard, const SOCKET clientSocket) {
+        Shard& shard = m_listenerPerShard ? acceptingShard : *m_shards[m_nextShard.fetch_add(1, std::memory_order_relaxed) % m_shards.size()];
 
-            // Associate the client socket with the completion port
-            if (CreateIoCompletionPort(reinterpret_cast<HANDLE>(clientSocket), m_completionPort, reinterpret_cast<ULONG_PTR>(context), 0) == nullptr) {
-                printf("CreateIoCompletionPort for client socket failed: %d\n", GetLastError());
-                delete context;
-                closesocket(clientSocket);
-                continue;
-            }
+        // Get client IP address and port for logging
+        sockaddr_in clientAddr{};
+        socklen_t addrLen = sizeof(clientAddr);
+        getpeername(clientSocket, reinterpret_cast<sockaddr *>(&clientAddr), &addrLen);
 
-            // Store the connection context
-            {
-                std::lock_guard lock(m_connectionsMutex);
-                m_connections[clientSocket] = context;
-            }
+        char clientIP[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &(clientAddr.sin_addr), clientIP, INET_ADDRSTRLEN);
+        const int clientPort = ntohs(clientAddr.sin_port);
+        printf("New connection from %s:%d\n", clientIP, clientPort);
 
-            // Start receiving data from the client
-            postRecv(context);
+        if (!PlatformHelper::setNoDelay(clientSocket, m_sendOptions.noDelay)) {
+            printf("setsockopt TCP_NODELAY failed: %d\n", PlatformHelper::lastSocketError());
         }
+
+        // Create a new connection context
+        auto* context = ConnectionPool::instance().create(clientSocket);
+        context->shard = shard.index;
+
+        // Associate the client socket with the reactor
+        if (!shard.reactor->associate(context)) {
+            ConnectionPool::instance().destroy(context);
+            closesocket(clientSocket);
+            return;
+        }
+
+        // Store the connection context
+        {
+            std::lock_guard lock(shard.connectionsMutex);
+            shard.connections[clientSocket] = context;
+        }
+
+        // Start receiving data from the client
+        postRecv(context);
     }
 
     // Thread procedure for worker threads
-    void workerThreadProc() {
+    void workerThreadProc(Shard& shard) {
+        pinToShard(shard);
+
         while (m_running) {
-            DWORD bytesTransferred = 0;
-            ConnectionContext* context = nullptr;
-            LPOVERLAPPED overlapped = nullptr;
+            IoCompletion completion;
 
             // Wait for a completion packet
-            const BOOL result = GetQueuedCompletionStatus(
-                m_completionPort,
-                &bytesTransferred,
-                reinterpret_cast<PULONG_PTR>(&context),
-                &overlapped,
-                INFINITE
-            );
+            const bool result = shard.reactor->waitForCompletion(completion);
 
             // Check if the server is shutting down
             if (!m_running) {
                 break;
             }
 
-            // Check for errors or client disconnection
-            if (!result || (result && bytesTransferred == 0)) {
-                if (context) {
-                    handleDisconnect(context);
+            // Act on what the executors handed back meanwhile
+            takeHandOffs(shard);
+
+            if (!result) {
+                continue;
+            }
+
+            // New connection from an asynchronous accept
+            if (completion.operation == IoOperation::Accept) {
+                if (completion.success) {
+                    handleAccept(shard, completion.acceptedSocket);
+                } else {
+                    printf("accept failed\n");
                 }
                 continue;
             }
 
+            ConnectionContext* context = completion.context;
+
+            // Wake-up or cancelled completion
+            if (!context) {
+                continue;
+            }
+
+            // Check for errors or client disconnection
+            if (!completion.success || completion.bytesTransferred == 0) {
+                handleDisconnect(context);
+            }
             // Process the completion packet
-            if (context) {
-                if (overlapped == &context->recvOverlapped) {
-                    // Handle received data
-                    handleRecv(context, bytesTransferred);
-                }
-                else if (overlapped == &context->sendOverlapped) {
-                    // Handle sent data
-                    handleSend(context, bytesTransferred);
-                }
+            else if (completion.operation == IoOperation::Recv) {
+                // Handle received data
+                handleRecv(context, completion.data, completion.bytesTransferred);
             }
+            else if (completion.operation == IoOperation::Send) {
+                // Handle sent data
+                handleSend(context);
+            }
+
+            // The received bytes have been copied out; hand the buffer back to the backend
+            if (completion.operation == IoOperation::Recv) {
+                shard.reactor->releaseRecvBuffer(completion);
+            }
+
+            // The operation's reference goes once its completion has been handled
+            release(context);
+
+            // Send for whichever connection's turn it is
+            dispatch(shard);
+
+            // Read again from connections that were paused while the server was over its queue budget
+            wakeParked();
         }
     }
 
-    // Post a receive operation
+    // Post a receive operation. Like a send, it holds a reference until its completion has been handled,
+    // and is posted under sendMutex, so that it is either posted before the connection is dissociated or not at all.
     void postRecv(ConnectionContext* context) {
-        DWORD flags = 0;
-        DWORD bytesRecvd = 0;
-
-        // Reset the recv buffer
-        ZeroMemory(context->recvBuffer, DEFAULT_BUFFER_SIZE);
-        ZeroMemory(&context->recvOverlapped, sizeof(WSAOVERLAPPED));
-
-        // Post the receive operation
-        const int result = WSARecv(
-            context->socket,
-            &context->wsaRecvBuffer,
-            1,
-            &bytesRecvd,
-            &flags,
-            &context->recvOverlapped,
-            nullptr
-        );
-
-        if (result == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING) {
-            printf("WSARecv failed: %d\n", WSAGetLastError());
+        bool posted;
+        {
+            std::lock_guard lock(context->sendMutex);
+            if (context->closed) {
+                return;
+            }
+
+            retain(context);
+            posted = shardOf(context).reactor->postRecv(context);
+        }
+
+        if (!posted) {
             handleDisconnect(context);
+            release(context);
         }
     }
 
-    // Post a send operation
-    void postSend(ConnectionContext* context) {
+    // Put a connection with queued responses and no send in progress up for its turn
+    void schedule(ConnectionContext* context) {
         std::lock_guard lock(context->sendMutex);
 
-        // Check if there's a send operation in progress
-        if (context->isSending) {
-            return;
+        TrafficClass trafficClass;
+        if (!context->closed && !context->isSending && EgressScheduler::urgentClass(context->messageQueues, trafficClass)) {
+            shardOf(context).scheduler.schedule(context, trafficClass);
         }
+    }
 
-        // Check if there are any message queues
-        if (context->messageQueues.empty()) {
-            return;
+    // Give the next ready connection of the shard its turn; its frames are gathered on a CPU executor thread
+    void dispatch(Shard& shard) {
+        ConnectionContext* context;
+        size_t budget;
+        if (shard.scheduler.next(context, budget)) {
+            m_cpuExecutor.submit([this, &shard, context, budget] { sendTurns(shard, context, budget); });
         }
+    }
 
-        // Try to find a non-empty queue using round-robin approach
-        const size_t startingIndex = context->currentQueueIndex;
-        bool foundMessage = false;
-        std::string message;
-
-        // Loop through queues starting from the current index
-        for (size_t i = 0; i < context->messageQueues.size(); i++) {
-            const size_t queueIndex = (startingIndex + i) % context->messageQueues.size();
-
-            // If this queue has messages, use it
-            if (!context->messageQueues[queueIndex].empty()) {
-                message = context->messageQueues[queueIndex].front();
-                context->messageQueues[queueIndex].pop();
-                context->currentQueueIndex = (queueIndex + 1) % context->messageQueues.size(); // Move to next queue for next time
-                foundMessage = true;
-
-                // Check if the queue is now empty and can be removed
-                if (context->messageQueues[queueIndex].empty()) {
-                    // Erase this queue
-                    context->messageQueues.erase(context->messageQueues.begin() + queueIndex);
-                    // Adjust current index if needed
-                    if (queueIndex <= context->currentQueueIndex && context->currentQueueIndex > 0) {
-                        context->currentQueueIndex--;
-                    }
-                    // Reset index if all queues are processed
-                    if (context->messageQueues.empty()) {
-                        context->currentQueueIndex = 0;
-                    }
+    // Prepare the send of the connection whose turn it is, or of the next ready ones while turns end
+    // with nothing to send. Runs on a CPU executor thread.
+    void sendTurns(Shard& shard, ConnectionContext* context, size_t budget) {
+        while (true) {
+            if (HandOff* handOff = prepareSend(context, std::min(budget, m_sendOptions.batchBytes))) {
+                if (handOff->reads.empty()) {
+                    handBack(handOff);
+                } else {
+                    m_diskExecutor.submit([this, handOff] {
+                        readPayloads(handOff);
+                        handBack(handOff);
+                    });
                 }
+                return;
+            }
 
-                break;
+            release(context);
+            if (!shard.scheduler.next(context, budget)) {
+                return;
             }
         }
+    }
 
-        // If no message found, return
-        if (!foundMessage) {
-            return;
+    // Gather as many queued frames as fit the byte budget into the connection's next send, producing
+    // the lazy packets on the way. nullptr if there is nothing to send.
+    HandOff* prepareSend(ConnectionContext* context, const size_t budget) {
+        Shard& shard = shardOf(context);
+        ResponseQueues queues;
+        {
+            std::lock_guard lock(context->sendMutex);
+
+            // Check if the connection is gone, a send is in progress or nothing is queued
+            if (context->closed || context->isSending || context->messageQueues.empty()) {
+                shard.scheduler.charge(context, 0, context->messageQueues.empty());
+                return nullptr;
+            }
+
+            // Producing packets hashes, compresses and reads, which the I/O threads queueing responses and
+            // completing sends must not wait for: the turn takes the responses out and produces without the lock
+            queues.swap(context->messageQueues);
+            context->detachedBytes = queuedBytes(queues);
+            context->isSending = true;
         }
 
-        // Update the send buffer
-        context->sendBuffer.resize(message.size());
-        memcpy(context->sendBuffer.data(), message.c_str(), message.size());
+        // Large file payloads go from the page cache to the socket when the reactor can do it, which
+        // ends the batch; others are read in right behind their header on a disk thread
+        const bool zeroCopy = shard.reactor->supportsSendFile();
+        std::shared_ptr<const FileHelper::File> file;
+        uint64_t fileOffset = 0;
+        size_t fileLength = 0;
+        std::vector<PayloadRead> reads;
+
+        ConnectionContext::SendFrames frames;
+        size_t batchBytes = 0;
+        OutgoingPacket message;
+        while (frames.size() < ConnectionContext::MAX_SEND_FRAMES && batchBytes < budget &&
+               EgressScheduler::take(context, queues, message)) {
+            batchBytes += message.size();
+
+            if (message.file && zeroCopy && message.fileLength >= MIN_SENDFILE_BYTES) {
+                frames.push_back(std::move(message.data));
+                file = std::move(message.file);
+                fileOffset = message.fileOffset;
+                fileLength = message.fileLength;
+                break;
+            }
 
-        // Update the WSA buffer
-        context->wsaSendBuffer.buf = context->sendBuffer.data();
-        context->wsaSendBuffer.len = static_cast<ULONG>(context->sendBuffer.size());
+            if (message.file) {
+                const size_t headerSize = message.data.size();
+                message.data.resize(headerSize + message.fileLength);
+                reads.push_back({frames.size(), headerSize, std::move(message.file), message.fileOffset, message.fileLength});
+            }
 
-        // Reset the overlapped structure
-        ZeroMemory(&context->sendOverlapped, sizeof(WSAOVERLAPPED));
+            frames.push_back(std::move(message.data));
+        }
 
-        // Mark that a send operation is in progress
-        context->isSending = true;
+        PauseAction action = PauseAction::None;
+        {
+            std::lock_guard lock(context->sendMutex);
 
-        // Post the send operation
-        DWORD bytesSent = 0;
-        const int result = WSASend(
-            context->socket,
-            &context->wsaSendBuffer,
-            1,
-            &bytesSent,
-            0,
-            &context->sendOverlapped,
-            nullptr
-        );
+            // Responses queued during the turn go behind the ones it produced from
+            for (ResponseQueue& queue : context->messageQueues) {
+                queues.push_back(std::move(queue));
+            }
+            context->messageQueues.swap(queues);
+            context->detachedBytes = 0;
+            shard.scheduler.charge(context, batchBytes, context->messageQueues.empty());
+
+            if (!frames.empty()) {
+                context->sendFrames = std::move(frames);
+
+                // Corked, the end of the batch waits in the socket for the next one if more is queued
+                context->sendMore = m_sendOptions.cork && !context->messageQueues.empty();
+                accountOutbound(context);
+
+                HandOff* handOff = HandOffPool::instance().create();
+                handOff->kind = HandOff::Kind::Send;
+                handOff->context = context;
+                handOff->file = std::move(file);
+                handOff->fileOffset = fileOffset;
+                handOff->fileLength = fileLength;
+                handOff->reads = std::move(reads);
+                return handOff;
+            }
 
-        if (result == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING) {
-            printf("WSASend failed: %d\n", WSAGetLastError());
+            // Nothing after all; whatever was queued or paused meanwhile saw a send in progress and waits for this
+            context->isSending = false;
+            accountOutbound(context);
+            action = pauseAction(context);
+        }
+
+        schedule(context);
+        if (action == PauseAction::Resume) {
+            // Reading resumes on the connection's shard; the hand-off holds its own reference
+            retain(context);
+            HandOff* handOff = HandOffPool::instance().create();
+            handOff->kind = HandOff::Kind::Resume;
+            handOff->context = context;
+            handBack(handOff);
+        } else if (action == PauseAction::Park) {
+            park(context);
+        }
+        return nullptr;
+    }
+
+    // Read the file payloads of a prepared send into its frames. Runs on a disk executor thread; the
+    // frames are the send path's alone until the send is posted, as isSending is set.
+    static void readPayloads(HandOff* handOff) {
+        ConnectionContext* context = handOff->context;
+        for (const PayloadRead& read : handOff->reads) {
+            char* payload = context->sendFrames[read.frame].data() + read.headerSize;
+            if (read.file->read(read.fileOffset, payload, read.fileLength) != read.fileLength) {
+                handOff->payloadRead = false;
+                break;
+            }
+        }
+        handOff->reads.clear();
+    }
+
+    // Post a send an executor prepared
+    void postSend(HandOff* handOff) {
+        ConnectionContext* context = handOff->context;
+        Reactor& reactor = *shardOf(context).reactor;
+        bool posted = false;
+        {
+            std::lock_guard lock(context->sendMutex);
+            if (context->closed) {
+                return;
+            }
+
+            // Post the send operation; see postRecv()
+            if (handOff->payloadRead) {
+                retain(context);
+                posted = handOff->file
+                    ? reactor.postSendFile(context, std::move(handOff->file), handOff->fileOffset, handOff->fileLength)
+                    : reactor.postSend(context);
+                if (!posted) {
+                    release(context);
+                }
+            } else {
+                printf("Failed to read file payload\n");
+            }
+        }
+
+        if (!posted) {
             handleDisconnect(context);
         }
     }
 
-    // Handle received data
-    void handleRecv(ConnectionContext* context, DWORD bytesTransferred) {
-        if (bytesTransferred == 0) {
+    // Hand the next complete request to the disk executor, or receive more if there is none. A
+    // connection's requests are handled one at a time, so their responses queue up in arrival order.
+    void receiveRequests(ConnectionContext* context) {
+        std::string_view request;
+        if (context->requestDecoder.next(request)) {
+            retain(context);
+            m_diskExecutor.submit([this, context, request = std::string(request)] {
+                HandOff* handOff = HandOffPool::instance().create();
+                handOff->kind = HandOff::Kind::Responses;
+                handOff->context = context;
+                handOff->responses = m_messageHandler(request, context->socket);
+
+                // Produce the first packet here too rather than on a worker thread
+                handOff->responses.empty();
+                handBack(handOff);
+            });
+            return;
+        }
+
+        if (context->requestDecoder.failed()) {
+            printf("Request larger than %zu bytes\n", ConnectionContext::MAX_REQUEST_SIZE);
             handleDisconnect(context);
             return;
         }
 
-        // Convert the received data to a string
-        const std::string message(context->recvBuffer, bytesTransferred);
+        // Post another receive operation
+        postRecv(context);
+    }
+
+    // Queue the responses of a handled request, then go on with the connection's next request unless
+    // it is over its queue limits
+    void handleResponses(ConnectionContext* context, PacketQueue responses) {
+        bool over;
+        {
+            std::lock_guard lock(context->sendMutex);
+            if (context->closed) {
+                return;
+            }
+
+            // If we got responses, add them as a new queue
+            if (!responses.empty()) {
+                context->messageQueues.emplace_back(std::move(responses));
+            }
+
+            accountOutbound(context);
+            over = overLimits(context);
+            if (over) {
+                context->recvPaused = true;
+            }
+        }
+
+        // Queue the connection to send the responses
+        schedule(context);
 
-        // Process the message with the handler
-        auto responses = m_messageHandler(message, context->socket);
+        if (!over) {
+            receiveRequests(context);
+            return;
+        }
 
-        // If we got responses, add them as a new queue
-        if (!responses.empty()) {
+        // Paused; the queues may have drained on another thread already
+        PauseAction action;
+        {
             std::lock_guard lock(context->sendMutex);
-            context->messageQueues.push_back(std::move(responses));
+            action = pauseAction(context);
+        }
+        if (action == PauseAction::Park) {
+            park(context);
+        } else if (action == PauseAction::Resume) {
+            receiveRequests(context);
+        }
+    }
+
+    // Give finished work back to the worker threads of the connection's shard; one wake-up covers
+    // everything handed back until they take it
+    void handBack(HandOff* handOff) {
+        Shard& shard = shardOf(handOff->context);
+        shard.handOffs.push(handOff);
+        if (!shard.handOffWakeup.exchange(true)) {
+            shard.reactor->wakeup(1);
         }
+    }
 
-        // Start sending the responses
-        postSend(context);
+    // Act on the work the executors handed back to the shard
+    void takeHandOffs(Shard& shard) {
+        shard.handOffWakeup = false;
+        for (HandOff* handOff = shard.handOffs.takeAll(); handOff;) {
+            if (handOff->kind == HandOff::Kind::Responses) {
+                handleResponses(handOff->context, std::move(handOff->responses));
+            } else if (handOff->kind == HandOff::Kind::Send) {
+                postSend(handOff);
+            } else {
+                receiveRequests(handOff->context);
+            }
+            release(handOff->context);
 
-        // Post another receive operation
-        postRecv(context);
+            HandOff* next = handOff->next;
+            HandOffPool::instance().destroy(handOff);
+            handOff = next;
+
+            // Every connection that was scheduled gets a turn handed out
+            dispatch(shard);
+        }
+    }
+
+    void retain(ConnectionContext* context) {
+        context->references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Drop references to a connection; the last one returns it to the pool with the memory its responses held
+    void release(ConnectionContext* context, const uint32_t count = 1) {
+        if (context->references.fetch_sub(count, std::memory_order_acq_rel) == count) {
+            m_outboundBytes -= context->outboundBytes;
+            ConnectionPool::instance().destroy(context);
+        }
+    }
+
+    // Re-count the memory a connection's responses hold, queued and in flight, into its own and the
+    // server's total. Caller holds context->sendMutex.
+    void accountOutbound(ConnectionContext* context) {
+        size_t bytes = queuedBytes(context->messageQueues) + context->detachedBytes;
+        for (const auto& frame : context->sendFrames) {
+            bytes += frame.size();
+        }
+
+        // Unsigned, so a shrinking connection wraps around to a subtraction
+        m_outboundBytes += bytes - context->outboundBytes;
+        context->outboundBytes = bytes;
+    }
+
+    static size_t queuedBytes(const ResponseQueues& queues) {
+        size_t bytes = 0;
+        for (const ResponseQueue& queue : queues) {
+            bytes += queue.packets.bufferedBytes() + RESPONSE_OVERHEAD;
+        }
+        return bytes;
+    }
+
+    bool overLimits(const ConnectionContext* context) const {
+        return context->outboundBytes > m_queueLimits.connectionBytes || m_outboundBytes > m_queueLimits.totalBytes;
+    }
+
+    // Paused connections resume at half the limits, so they do not flip on every send
+    bool underResumeMark(const ConnectionContext* context) const {
+        return context->outboundBytes <= m_queueLimits.connectionBytes / 2 && m_outboundBytes <= m_queueLimits.totalBytes / 2;
+    }
+
+    // What to do about a paused connection after its queues were accounted
+    enum class PauseAction { None, Resume, Park };
+
+    // A paused connection is resumed once its queues have drained to half the limits. Still over them
+    // with nothing left to send, no send completion will come to resume it, so it is parked until the
+    // total drops. Caller holds context->sendMutex.
+    PauseAction pauseAction(ConnectionContext* context) const {
+        if (context->closed || !context->recvPaused || context->recvParked) {
+            return PauseAction::None;
+        }
+
+        if (underResumeMark(context)) {
+            context->recvPaused = false;
+            return PauseAction::Resume;
+        }
+
+        if (!context->isSending && context->messageQueues.empty()) {
+            context->recvParked = true;
+            return PauseAction::Park;
+        }
+        return PauseAction::None;
+    }
+
+    // The parked list holds a reference until the connection is woken
+    void park(ConnectionContext* context) {
+        retain(context);
+        std::lock_guard lock(m_parkedMutex);
+        m_parked.push_back(context);
+        ++m_parkedCount;
+    }
+
+    // Resume parked connections, oldest first, while the total is under half the budget
+    void wakeParked() {
+        while (m_parkedCount > 0 && m_outboundBytes <= m_queueLimits.totalBytes / 2) {
+            ConnectionContext* context;
+            {
+                std::lock_guard lock(m_parkedMutex);
+                if (m_parked.empty()) {
+                    return;
+                }
+                context = m_parked.front();
+                m_parked.pop_front();
+                --m_parkedCount;
+            }
+
+            PauseAction action;
+            {
+                std::lock_guard lock(context->sendMutex);
+                context->recvParked = false;
+                action = pauseAction(context);
+            }
+
+            // The connection reads again on its own shard; the hand-off takes over the parked list's reference
+            if (action == PauseAction::Resume) {
+                HandOff* handOff = HandOffPool::instance().create();
+                handOff->kind = HandOff::Kind::Resume;
+                handOff->context = context;
+                handBack(handOff);
+                continue;
+            }
+
+            const bool parked = action == PauseAction::Park;
+            if (parked) {
+                park(context);
+            }
+            release(context);
+
+            if (parked) {
+                return;
+            }
+        }
+    }
+
+    // Handle received data
+    void handleRecv(ConnectionContext* context, const char* data, const size_t bytesTransferred) {
+        if (bytesTransferred == 0) {
+            handleDisconnect(context);
+            return;
+        }
+
+        // A receive may hold part of a request or several pipelined ones; handle every
+        // complete request in arrival order and keep the rest for the next receive
+        context->requestDecoder.append(data, bytesTransferred);
+        receiveRequests(context);
     }
 
     // Handle sent data
-    void handleSend(ConnectionContext* context, DWORD bytesTransferred) {
+    void handleSend(ConnectionContext* context) {
+        PauseAction action;
         {
             std::lock_guard lock(context->sendMutex);
             context->isSending = false;
+
+            // The frames have been sent; they go back to the pool, also while the connection idles
+            for (auto& frame : context->sendFrames) {
+                PacketBuffer().swap(frame);
+            }
+            context->sendFrames.clear();
+
+            accountOutbound(context);
+            action = pauseAction(context);
         }
 
-        // Send the next message if there are any
-        postSend(context);
+        // Queue the connection to send the next messages if there are any
+        schedule(context);
+
+        // A paused connection that drained below the limits reads again
+        if (action == PauseAction::Resume) {
+            receiveRequests(context);
+        } else if (action == PauseAction::Park) {
+            park(context);
+        }
     }
 
     // Handle client disconnection
-    void handleDisconnect(const ConnectionContext* context) {
+    void handleDisconnect(ConnectionContext* context) {
+        // A receive and a send can fail at once; only the first closes the connection
+        {
+            std::lock_guard lock(context->sendMutex);
+            if (context->closed) {
+                return;
+            }
+            context->closed = true;
+        }
+
         printf("Client disconnected\n");
 
+        Shard& shard = shardOf(context);
+
+        // Stop delivering events for the socket; operations it drops give their references back below
+        const size_t dropped = shard.reactor->dissociate(context);
+
         // Close the socket
         closesocket(context->socket);
 
         // Remove the connection from the map
         {
-            std::lock_guard lock(m_connectionsMutex);
-            m_connections.erase(context->socket);
+            std::lock_guard lock(shard.connectionsMutex);
+            shard.connections.erase(context->socket);
         }
 
-        // Delete the context
-        delete context;
+        // Turns, requests and operations in progress hold their own references; the last one returns the context to the pool
+        shard.scheduler.remove(context);
+        release(context, static_cast<uint32_t>(dropped) + 1);
     }
 
 private:
     unsigned short m_port;           // Server port
     size_t m_threadCount;            // Number of worker threads
+    std::string m_ioEngine;          // Requested reactor backend
     std::atomic<bool> m_running;     // Flag to indicate if the server is running
-    HANDLE m_completionPort;         // IOCP handle
-    SOCKET m_listenSocket;           // Listening socket
+    bool m_sharded = false;          // A reactor, listener and pinned hardware thread per worker thread
 
-    // Windows thread handles and IDs
-    HANDLE m_acceptThread;           // Thread for accepting connections
-    DWORD m_acceptThreadId;          // Accept thread ID
-    std::vector<HANDLE> m_workerThreads; // Worker threads
-    std::vector<DWORD> m_workerThreadIds; // Worker thread IDs
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    bool m_listenerPerShard = false; // Every shard accepts on its own SO_REUSEPORT listener
+    std::atomic<size_t> m_nextShard{0}; // Shard the shared listener hands the next connection to
 
     MessageHandler m_messageHandler; // Handler for processing messages
-
-    // Map of active connections
-    std::unordered_map<SOCKET, ConnectionContext*> m_connections;
-    std::mutex m_connectionsMutex; // Mutex to protect m_connections
+    HandlerOptions m_handlerOptions;
+    WorkStealingExecutor m_cpuExecutor;  // Produces packets for send turns
+    WorkStealingExecutor m_diskExecutor; // Runs the message handler
+    SendOptions m_sendOptions;       // Batching and corking of sends
+    QueueLimits m_queueLimits;       // Memory the outbound queues may hold
+    std::atomic<size_t> m_outboundBytes{0}; // Held by the outbound queues of all connections
+
+    // Connections paused over the total budget with nothing to send
+    std::deque<ConnectionContext*> m_parked;
+    std::atomic<size_t> m_parkedCount{0};
+    std::mutex m_parkedMutex;
 };
 
 #endif //SERVERRUNNER_H
\ No newline at end of file
@@ -0,0 +1,944 @@
+#ifndef URINGREACTOR_H
+#define URINGREACTOR_H
+
+#ifndef _WIN32
+
+#include <linux/io_uring.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <unordered_map>
+#include <vector>
+
+#include "Reactor.h"
+
+// Linux io_uring backend (kernel 6.0+).
+// - Multishot accept replaces the blocking accept() thread.
+// - Each connection has one multishot recv that picks buffers from a provided-buffer ring;
+//   completions beyond the one currently handed to ServerRunner are parked per connection,
+//   so postRecv() keeps its IOCP meaning of "deliver the next receive". A connection that is not
+//   asked for receives (paused by ServerRunner) has its recv cancelled after a few parked ones,
+//   so it leaves the shared buffers to others and its data waits in the socket.
+// - Sockets live in the registered file table. Frames go out as one sendmsg straight from where
+//   ServerRunner built them, with MSG_NOSIGNAL, so a peer that reset the connection fails the
+//   send instead of raising SIGPIPE.
+// - File payloads are spliced file -> pipe -> socket, one pipe per connection.
+// - Submissions are batched: SQEs posted while handling a completion are flushed together,
+//   and the thread that reaps the completion queue submits and waits in a single io_uring_enter().
+class UringReactor : public Reactor {
+public:
+    static constexpr unsigned RING_ENTRIES = 4096;
+    static constexpr unsigned RECV_BUFFER_COUNT = 1024;      // Provided buffers, power of two
+    static constexpr size_t MAX_PARKED_RECVS = 4;            // A connection's recv is cancelled beyond this until it is asked for again
+    static constexpr unsigned short RECV_BUFFER_GROUP = 0;
+    static constexpr unsigned FIXED_FILE_COUNT = 16384;      // Sockets with fd below this use the fixed file table
+    static constexpr unsigned SETUP_FLAGS = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    static constexpr int SPLICE_PIPE_SIZE = 1024 * 1024;     // Requested pipe capacity; the default 64 KiB is kept if refused
+
+    UringReactor() = default;
+
+    ~UringReactor() override {
+        close();
+    }
+
+    // Check whether the running kernel has everything open() and the operations rely on: io_uring may
+    // be disabled by sysctl or seccomp, and older kernels lack setup flags and opcodes. Multishot recv
+    // has no probe bit of its own; it came in the same release (6.0) as SEND_ZC, which does.
+    static bool isSupported() {
+        io_uring_params params{};
+        params.flags = SETUP_FLAGS;
+        params.cq_entries = 4;
+        const int fd = static_cast<int>(syscall(__NR_io_uring_setup, 2, &params));
+        if (fd < 0) return false;
+
+        // Completions must never be dropped on CQ overflow: every posted operation completes once
+        bool supported = params.features & IORING_FEAT_NODROP;
+
+        std::vector<uint64_t> buffer((sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op) + 7) / 8);
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        supported = supported && syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) >= 0;
+
+        constexpr uint8_t required[] = { IORING_OP_NOP, IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_SENDMSG,
+                                         IORING_OP_SPLICE, IORING_OP_ASYNC_CANCEL, IORING_OP_SEND_ZC };
+        for (const uint8_t op : required) {
+            supported = supported && op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        }
+
+        ::close(fd);
+        return supported;
+    }
+
+    const char* name() const override {
+        return "io_uring";
+    }
+
+    bool open() override {
+        io_uring_params params{};
+        params.flags = SETUP_FLAGS;
+        params.cq_entries = RING_ENTRIES * 4;
+
+        m_ringFd = static_cast<int>(syscall(__NR_io_uring_setup, RING_ENTRIES, &params));
+        if (m_ringFd < 0) {
+            printf("io_uring_setup failed: %d\n", errno);
+            return false;
+        }
+
+        if (!mapRings(params) || !setupBufferRing()) {
+            close();
+            return false;
+        }
+
+        // Registered files are an optimization; run without them if they are refused
+        m_fixedFiles = registerFiles();
+        return true;
+    }
+
+    void close() override {
+        m_acceptEnabled = false;
+
+        if (m_ringFd >= 0) {
+            // Closing the ring cancels every outstanding request
+            ::close(m_ringFd);
+            m_ringFd = -1;
+        }
+
+        unmap(m_sqRing, m_sqRingSize);
+        if (m_cqRing != m_sqRing) unmap(m_cqRing, m_cqRingSize);
+        m_cqRing = nullptr;
+        unmap(m_sqes, m_sqesSize);
+        unmap(m_bufRing, m_bufRingSize);
+        unmap(m_recvBuffers, static_cast<size_t>(RECV_BUFFER_COUNT) * ConnectionContext::DEFAULT_BUFFER_SIZE);
+
+        m_orphanSends.clear();
+        for (auto& orphan : m_orphanSplices | std::views::values) {
+            closePipe(orphan.pipe);
+        }
+        m_orphanSplices.clear();
+        m_starved.clear();
+        m_contexts.clear();
+
+        std::lock_guard lock(m_readyMutex);
+        m_readyQueue.clear();
+    }
+
+    bool supportsAccept() const override {
+        return true;
+    }
+
+    bool postAccept(const SOCKET listenSocket) override {
+        m_listenSocket = listenSocket;
+        m_acceptEnabled = true;
+
+        if (!armAccept()) return false;
+        flushSubmissions();
+        return true;
+    }
+
+    bool associate(ConnectionContext* context) override {
+        std::lock_guard lock(m_contextsMutex);
+
+        context->ioId = m_nextId++;
+        context->fixedFile = m_fixedFiles && context->socket < static_cast<SOCKET>(FIXED_FILE_COUNT) && updateFixedFile(context->socket, context->socket);
+
+        m_contexts[context->ioId] = context;
+        return true;
+    }
+
+    size_t dissociate(ConnectionContext* context) override {
+        std::lock_guard contextsLock(m_contextsMutex);
+        if (m_contexts.erase(context->ioId) == 0) return 0;
+
+        // Late CQEs find no context, so a receive or send that has not completed yet never will
+        size_t dropped = 0;
+        {
+            std::lock_guard lock(context->ioMutex);
+            dropped += context->recvPosted + context->sendPosted;
+
+            // Give buffers of receives that were never handed out back to the ring
+            for (const auto& [result, flags] : context->parkedRecvs) {
+                if (flags & IORING_CQE_F_BUFFER) recycleRecvBuffer(flags >> IORING_CQE_BUFFER_SHIFT);
+            }
+            context->parkedRecvs.clear();
+
+            // The kernel may still read from the frames; free them when the cancelled send completes
+            if (context->sendPosted && context->sendOffset < context->sendLength) {
+                m_orphanSends[context->ioId].frames = std::move(context->sendFrames);
+            }
+
+            // A submitted splice resolves its pipe descriptor when it runs; keep the pipe and
+            // the file open until it completes so that reused descriptors are never touched
+            if (context->spliceInFlight) {
+                OrphanSplice& orphan = m_orphanSplices[context->ioId];
+                orphan.pipe[0] = context->splicePipe[0];
+                orphan.pipe[1] = context->splicePipe[1];
+                orphan.file = std::move(context->sendFile);
+                context->splicePipe[0] = context->splicePipe[1] = -1;
+            } else {
+                closePipe(context->splicePipe);
+            }
+            context->sendFile.reset();
+            context->spliceInFlight = false;
+
+            context->recvArmed = false;
+            context->recvPosted = false;
+            context->sendPosted = false;
+        }
+
+        cancel(userData(context->ioId, TAG_RECV));
+        cancel(userData(context->ioId, TAG_SEND));
+        cancel(userData(context->ioId, TAG_SPLICE_IN));
+        cancel(userData(context->ioId, TAG_SPLICE_OUT));
+        flushSubmissions();
+
+        if (context->fixedFile) {
+            updateFixedFile(context->socket, -1);
+            context->fixedFile = false;
+        }
+
+        // Cancel completions that are still queued for this connection; they are delivered as empty
+        // completions. The reaper queues under m_contextsMutex, so none can arrive after this.
+        std::lock_guard lock(m_readyMutex);
+        for (auto& completion : m_readyQueue) {
+            if (completion.context == context) {
+                if (completion.bufferId != IoCompletion::NO_BUFFER) {
+                    recycleRecvBuffer(static_cast<unsigned short>(completion.bufferId));
+                }
+                completion = {};
+                ++dropped;
+            }
+        }
+        return dropped;
+    }
+
+    bool postRecv(ConnectionContext* context) override {
+        IoCompletion completion;
+        {
+            std::lock_guard lock(context->ioMutex);
+            context->recvInFlight = false;
+
+            // Hand out the next receive that arrived while the previous one was being handled
+            if (!context->parkedRecvs.empty()) {
+                const auto [result, flags] = context->parkedRecvs.front();
+                context->parkedRecvs.pop_front();
+                context->recvInFlight = true;
+                completion = makeRecvCompletion(context, result, flags);
+            } else {
+                if (!context->recvArmed) {
+                    if (!armRecv(context)) return false;
+                    context->recvArmed = true;
+                }
+                context->recvPosted = true;
+                return true;
+            }
+        }
+
+        enqueue(completion);
+        return true;
+    }
+
+    bool postSend(ConnectionContext* context) override {
+        std::lock_guard lock(context->ioMutex);
+        prepareFrames(context);
+        context->sendFileRemaining = 0;
+        context->sendPosted = submitSend(context);
+        return context->sendPosted;
+    }
+
+    bool supportsSendFile() const override {
+        return true;
+    }
+
+    // The frames go out as a normal send, then the payload alternates between
+    // file -> pipe and pipe -> socket splices until it is through
+    bool postSendFile(ConnectionContext* context, std::shared_ptr<const FileHelper::File> file, const uint64_t offset, const size_t length) override {
+        std::lock_guard lock(context->ioMutex);
+        if (context->splicePipe[0] < 0 && !createPipe(context)) return false;
+
+        prepareFrames(context);
+        context->sendFile = std::move(file);
+        context->sendFileOffset = offset;
+        context->sendFileRemaining = length;
+        context->pipeBytes = 0;
+        context->sendPosted = submitSend(context);
+        return context->sendPosted;
+    }
+
+    void releaseRecvBuffer(const IoCompletion& completion) override {
+        if (completion.bufferId == IoCompletion::NO_BUFFER) return;
+
+        recycleRecvBuffer(completion.bufferId);
+
+        // Connections that ran out of buffers can receive again
+        std::vector<uint64_t> starved;
+        {
+            std::lock_guard lock(m_starvedMutex);
+            starved.swap(m_starved);
+        }
+
+        if (starved.empty()) return;
+
+        std::lock_guard contextsLock(m_contextsMutex);
+        for (const uint64_t id : starved) {
+            const auto it = m_contexts.find(id);
+            if (it == m_contexts.end()) continue;
+
+            ConnectionContext* context = it->second;
+            std::lock_guard lock(context->ioMutex);
+            if (!context->recvArmed && !context->recvInFlight && context->parkedRecvs.empty()) {
+                context->recvArmed = armRecv(context);
+            }
+        }
+    }
+
+    bool waitForCompletion(IoCompletion& completion) override {
+        std::unique_lock lock(m_readyMutex);
+
+        while (true) {
+            if (!m_readyQueue.empty()) {
+                completion = m_readyQueue.front();
+                m_readyQueue.pop_front();
+                lock.unlock();
+
+                // Submit whatever the previous handler posted before running the next one
+                flushSubmissions();
+                return true;
+            }
+
+            if (!m_reaping) {
+                m_reaping = true;
+                lock.unlock();
+
+                const bool result = reap();
+
+                lock.lock();
+                m_reaping = false;
+                m_readyCondition.notify_all();
+
+                if (!result) return false;
+                continue;
+            }
+
+            // Another thread is waiting in the kernel; make sure it has our submissions
+            lock.unlock();
+            flushSubmissions();
+            lock.lock();
+
+            if (m_readyQueue.empty() && m_reaping) {
+                m_readyCondition.wait(lock);
+            }
+        }
+    }
+
+    void wakeup(const size_t count) override {
+        for (size_t i = 0; i < count; i++) {
+            std::lock_guard lock(m_submitMutex);
+            io_uring_sqe* sqe = getSqe();
+            if (!sqe) break;
+
+            sqe->opcode = IORING_OP_NOP;
+            sqe->user_data = userData(0, TAG_WAKEUP);
+            publishSqe();
+        }
+
+        flushSubmissions();
+    }
+
+private:
+    // user_data layout: connection id in the upper bits, operation tag in the lower three
+    enum Tag : uint64_t {
+        TAG_WAKEUP = 0,
+        TAG_RECV = 1,
+        TAG_SEND = 2,
+        TAG_ACCEPT = 3,
+        TAG_IGNORE = 4,
+        TAG_SPLICE_IN = 5,  // File -> pipe
+        TAG_SPLICE_OUT = 6  // Pipe -> socket
+    };
+
+    // Frames of a send that was still running when its connection went away
+    struct OrphanSend {
+        ConnectionContext::SendFrames frames;
+    };
+
+    // Pipe and file of a splice that was still running when its connection went away
+    struct OrphanSplice {
+        int pipe[2] = { -1, -1 };
+        std::shared_ptr<const FileHelper::File> file;
+    };
+
+    static constexpr int TAG_BITS = 3;
+
+    static uint64_t userData(const uint64_t id, const Tag tag) {
+        return id << TAG_BITS | tag;
+    }
+
+    static void unmap(auto*& address, const size_t size) {
+        if (address != nullptr && reinterpret_cast<void*>(address) != MAP_FAILED) {
+            munmap(reinterpret_cast<void*>(address), size);
+        }
+        address = nullptr;
+    }
+
+    int enter(const unsigned toSubmit, const unsigned minComplete, const unsigned flags) const {
+        return static_cast<int>(syscall(__NR_io_uring_enter, m_ringFd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    int registerResource(const unsigned opcode, const void* arg, const unsigned count) const {
+        return static_cast<int>(syscall(__NR_io_uring_register, m_ringFd, opcode, arg, count));
+    }
+
+    bool mapRings(const io_uring_params& params) {
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+
+        m_sqRing = static_cast<char*>(mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING));
+        if (m_sqRing == MAP_FAILED) {
+            m_sqRing = nullptr;
+            printf("mmap of io_uring SQ ring failed: %d\n", errno);
+            return false;
+        }
+
+        if (singleMmap) {
+            m_cqRing = m_sqRing;
+        } else {
+            m_cqRing = static_cast<char*>(mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING));
+            if (m_cqRing == MAP_FAILED) {
+                m_cqRing = nullptr;
+                printf("mmap of io_uring CQ ring failed: %d\n", errno);
+                return false;
+            }
+        }
+
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe*>(mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES));
+        if (m_sqes == MAP_FAILED) {
+            m_sqes = nullptr;
+            printf("mmap of io_uring SQEs failed: %d\n", errno);
+            return false;
+        }
+
+        m_sqHead = reinterpret_cast<unsigned*>(m_sqRing + params.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned*>(m_sqRing + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned*>(m_sqRing + params.sq_off.ring_mask);
+        m_sqEntries = params.sq_entries;
+        m_sqLocalTail = *m_sqTail;
+
+        // Identity mapping: SQE n always lives in slot n
+        auto* sqArray = reinterpret_cast<unsigned*>(m_sqRing + params.sq_off.array);
+        for (unsigned i = 0; i < m_sqEntries; i++) {
+            sqArray[i] = i;
+        }
+
+        m_cqHead = reinterpret_cast<unsigned*>(m_cqRing + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(m_cqRing + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned*>(m_cqRing + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(m_cqRing + params.cq_off.cqes);
+        return true;
+    }
+
+    bool setupBufferRing() {
+        m_bufRingSize = RECV_BUFFER_COUNT * sizeof(io_uring_buf);
+        m_bufRing = static_cast<io_uring_buf_ring*>(mmap(nullptr, m_bufRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+        const size_t buffersSize = static_cast<size_t>(RECV_BUFFER_COUNT) * ConnectionContext::DEFAULT_BUFFER_SIZE;
+        m_recvBuffers = static_cast<char*>(mmap(nullptr, buffersSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+
+        if (m_bufRing == MAP_FAILED || m_recvBuffers == MAP_FAILED) {
+            printf("mmap of receive buffers failed: %d\n", errno);
+            return false;
+        }
+
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(m_bufRing);
+        reg.ring_entries = RECV_BUFFER_COUNT;
+        reg.bgid = RECV_BUFFER_GROUP;
+
+        if (registerResource(IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+            printf("IORING_REGISTER_PBUF_RING failed: %d\n", errno);
+            return false;
+        }
+
+        m_bufRingTail = 0;
+        for (unsigned short bid = 0; bid < RECV_BUFFER_COUNT; bid++) {
+            recycleRecvBuffer(bid);
+        }
+
+        return true;
+    }
+
+    bool registerFiles() {
+        io_uring_rsrc_register reg{};
+        reg.nr = FIXED_FILE_COUNT;
+        reg.flags = IORING_RSRC_REGISTER_SPARSE;
+
+        if (registerResource(IORING_REGISTER_FILES2, &reg, sizeof(reg)) < 0) {
+            printf("io_uring fixed files unavailable: %d\n", errno);
+            return false;
+        }
+
+        return true;
+    }
+
+    bool updateFixedFile(const SOCKET slot, const int fd) {
+        int fds[1] = { fd };
+        io_uring_files_update update{};
+        update.offset = static_cast<unsigned>(slot);
+        update.fds = reinterpret_cast<uint64_t>(fds);
+
+        return registerResource(IORING_REGISTER_FILES_UPDATE, &update, 1) == 1;
+    }
+
+    void recycleRecvBuffer(const unsigned short bid) {
+        std::lock_guard lock(m_bufRingMutex);
+
+        // Index the entries directly: in C++ the empty struct in the kernel's flex-array wrapper shifts `bufs`
+        io_uring_buf& buf = reinterpret_cast<io_uring_buf*>(m_bufRing)[m_bufRingTail & (RECV_BUFFER_COUNT - 1)];
+        buf.addr = reinterpret_cast<uint64_t>(m_recvBuffers + static_cast<size_t>(bid) * ConnectionContext::DEFAULT_BUFFER_SIZE);
+        buf.len = ConnectionContext::DEFAULT_BUFFER_SIZE;
+        buf.bid = bid;
+
+        __atomic_store_n(&m_bufRing->tail, ++m_bufRingTail, __ATOMIC_RELEASE);
+    }
+
+    // Caller holds m_submitMutex
+    io_uring_sqe* getSqe() {
+        unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        if (m_sqLocalTail - head >= m_sqEntries) {
+            // Ring full: hand everything to the kernel right away
+            enter(m_unsubmitted, 0, 0);
+            m_unsubmitted = 0;
+
+            head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+            if (m_sqLocalTail - head >= m_sqEntries) {
+                printf("io_uring submission queue is full\n");
+                return nullptr;
+            }
+        }
+
+        io_uring_sqe* sqe = &m_sqes[m_sqLocalTail & m_sqMask];
+        memset(sqe, 0, sizeof(*sqe));
+        return sqe;
+    }
+
+    // Caller holds m_submitMutex
+    void publishSqe() {
+        __atomic_store_n(m_sqTail, ++m_sqLocalTail, __ATOMIC_RELEASE);
+        m_unsubmitted++;
+    }
+
+    unsigned takeUnsubmitted() {
+        std::lock_guard lock(m_submitMutex);
+        const unsigned count = m_unsubmitted;
+        m_unsubmitted = 0;
+        return count;
+    }
+
+    void flushSubmissions() {
+        const unsigned count = takeUnsubmitted();
+        if (count > 0 && enter(count, 0, 0) < 0) {
+            printf("io_uring_enter failed: %d\n", errno);
+        }
+    }
+
+    void setTarget(io_uring_sqe* sqe, const ConnectionContext* context) const {
+        if (context->fixedFile) {
+            sqe->fd = context->socket; // Slot index equals the descriptor
+            sqe->flags |= IOSQE_FIXED_FILE;
+        } else {
+            sqe->fd = context->socket;
+        }
+    }
+
+    bool armAccept() {
+        std::lock_guard lock(m_submitMutex);
+        io_uring_sqe* sqe = getSqe();
+        if (!sqe) return false;
+
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->fd = m_listenSocket;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        sqe->user_data = userData(0, TAG_ACCEPT);
+        publishSqe();
+        return true;
+    }
+
+    // Caller holds context->ioMutex
+    bool armRecv(const ConnectionContext* context) {
+        std::lock_guard lock(m_submitMutex);
+        io_uring_sqe* sqe = getSqe();
+        if (!sqe) return false;
+
+        sqe->opcode = IORING_OP_RECV;
+        setTarget(sqe, context);
+        sqe->flags |= IOSQE_BUFFER_SELECT;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->buf_group = RECV_BUFFER_GROUP;
+        sqe->user_data = userData(context->ioId, TAG_RECV);
+        publishSqe();
+        return true;
+    }
+
+    // Set up the send of context->sendFrames from where they are. Caller holds context->ioMutex.
+    void prepareFrames(ConnectionContext* context) {
+        context->sendOffset = 0;
+        context->sendLength = prepareSendIov(context);
+    }
+
+    // Caller holds context->ioMutex
+    bool submitSend(ConnectionContext* context) {
+        std::lock_guard lock(m_submitMutex);
+        io_uring_sqe* sqe = getSqe();
+        if (!sqe) return false;
+
+        setTarget(sqe, context);
+
+        // The kernel copies the header when it takes the request; the frames stay put until the completion
+        context->sendMsg = {};
+        context->sendMsg.msg_iov = context->sendIov.data() + context->sendIovIndex;
+        context->sendMsg.msg_iovlen = context->sendIov.size() - context->sendIovIndex;
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL | (context->sendFileRemaining > 0 || context->sendMore ? MSG_MORE : 0);
+        sqe->addr = reinterpret_cast<uint64_t>(&context->sendMsg);
+        sqe->len = 1;
+
+        sqe->user_data = userData(context->ioId, TAG_SEND);
+        publishSqe();
+        return true;
+    }
+
+    static void closePipe(int (&pipe)[2]) {
+        for (int& fd : pipe) {
+            if (fd >= 0) ::close(fd);
+            fd = -1;
+        }
+    }
+
+    // Caller holds context->ioMutex
+    static bool createPipe(ConnectionContext* context) {
+        if (pipe2(context->splicePipe, O_CLOEXEC) < 0) {
+            printf("pipe2 failed: %d\n", errno);
+            return false;
+        }
+
+        fcntl(context->splicePipe[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE);
+        const int capacity = fcntl(context->splicePipe[1], F_GETPIPE_SZ);
+        context->pipeCapacity = capacity > 0 ? static_cast<size_t>(capacity) : 64 * 1024;
+        return true;
+    }
+
+    // Move the next piece of the file payload: fill the pipe from the file when it is empty,
+    // drain it into the socket otherwise. Caller holds context->ioMutex.
+    bool submitSplice(ConnectionContext* context) {
+        std::lock_guard lock(m_submitMutex);
+        io_uring_sqe* sqe = getSqe();
+        if (!sqe) return false;
+
+        sqe->opcode = IORING_OP_SPLICE;
+
+        if (context->pipeBytes == 0) {
+            sqe->splice_fd_in = context->sendFile->handle();
+            sqe->splice_off_in = context->sendFileOffset;
+            sqe->fd = context->splicePipe[1];
+            sqe->off = static_cast<uint64_t>(-1);
+            sqe->len = static_cast<uint32_t>(std::min(context->sendFileRemaining, context->pipeCapacity));
+            sqe->user_data = userData(context->ioId, TAG_SPLICE_IN);
+        } else {
+            sqe->splice_fd_in = context->splicePipe[0];
+            sqe->splice_off_in = static_cast<uint64_t>(-1);
+            setTarget(sqe, context);
+            sqe->off = static_cast<uint64_t>(-1);
+            sqe->len = static_cast<uint32_t>(context->pipeBytes);
+            sqe->user_data = userData(context->ioId, TAG_SPLICE_OUT);
+        }
+
+        sqe->splice_flags = SPLICE_F_MOVE | (context->sendFileRemaining > 0 ? SPLICE_F_MORE : 0);
+        publishSqe();
+
+        context->spliceInFlight = true;
+        return true;
+    }
+
+    void cancel(const uint64_t target) {
+        std::lock_guard lock(m_submitMutex);
+        io_uring_sqe* sqe = getSqe();
+        if (!sqe) return;
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = target;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = userData(0, TAG_IGNORE);
+        publishSqe();
+    }
+
+    IoCompletion makeRecvCompletion(ConnectionContext* context, const int result, const unsigned flags) const {
+        IoCompletion completion;
+        completion.context = context;
+        completion.operation = IoOperation::Recv;
+        completion.success = result >= 0;
+        completion.bytesTransferred = result > 0 ? static_cast<size_t>(result) : 0;
+
+        if (flags & IORING_CQE_F_BUFFER) {
+            completion.bufferId = static_cast<unsigned short>(flags >> IORING_CQE_BUFFER_SHIFT);
+            completion.data = m_recvBuffers + static_cast<size_t>(completion.bufferId) * ConnectionContext::DEFAULT_BUFFER_SIZE;
+        }
+
+        return completion;
+    }
+
+    void enqueue(const IoCompletion& completion) {
+        std::lock_guard lock(m_readyMutex);
+        m_readyQueue.push_back(completion);
+        m_readyCondition.notify_one();
+    }
+
+    // Submit pending SQEs, wait for at least one CQE and queue the whole batch translated
+    bool reap() {
+        const unsigned toSubmit = takeUnsubmitted();
+        const bool hasCompletions = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE) != *m_cqHead;
+
+        if (toSubmit > 0 || !hasCompletions) {
+            const int result = enter(toSubmit, hasCompletions ? 0 : 1, hasCompletions ? 0 : IORING_ENTER_GETEVENTS);
+            if (result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                printf("io_uring_enter failed: %d\n", errno);
+                return false;
+            }
+        }
+
+        std::vector<IoCompletion> completions;
+        std::lock_guard contextsLock(m_contextsMutex);
+
+        unsigned head = *m_cqHead;
+        const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+            handleCqe(cqe.user_data, cqe.res, cqe.flags, completions);
+        }
+
+        __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+        // Still under m_contextsMutex, so dissociate() sees these in the queue
+        std::lock_guard readyLock(m_readyMutex);
+        m_readyQueue.insert(m_readyQueue.end(), completions.begin(), completions.end());
+        return true;
+    }
+
+    // Caller holds m_contextsMutex
+    void handleCqe(const uint64_t data, const int result, const unsigned flags, std::vector<IoCompletion>& completions) {
+        const auto tag = static_cast<Tag>(data & ((1u << TAG_BITS) - 1));
+        const uint64_t id = data >> TAG_BITS;
+
+        switch (tag) {
+            case TAG_WAKEUP:
+                completions.emplace_back();
+                return;
+
+            case TAG_IGNORE:
+                return;
+
+            case TAG_ACCEPT: {
+                IoCompletion completion;
+                completion.operation = IoOperation::Accept;
+                completion.success = result >= 0;
+                completion.acceptedSocket = result >= 0 ? result : INVALID_SOCKET;
+                completions.push_back(completion);
+
+                // Multishot accept stops on errors and CQ overflow; re-arm unless the listener is gone
+                if (!(flags & IORING_CQE_F_MORE) && m_acceptEnabled && result != -EINVAL && result != -EBADF && result != -ECANCELED) {
+                    armAccept();
+                }
+                return;
+            }
+
+            default:
+                break;
+        }
+
+        const auto it = m_contexts.find(id);
+        if (it == m_contexts.end()) {
+            // Late completion for a connection that has already been dissociated
+            if (flags & IORING_CQE_F_BUFFER) {
+                recycleRecvBuffer(static_cast<unsigned short>(flags >> IORING_CQE_BUFFER_SHIFT));
+            }
+
+            if (tag == TAG_SEND) {
+                m_orphanSends.erase(id);
+            }
+
+            if (tag == TAG_SPLICE_IN || tag == TAG_SPLICE_OUT) {
+                if (const auto orphan = m_orphanSplices.find(id); orphan != m_orphanSplices.end()) {
+                    closePipe(orphan->second.pipe);
+                    m_orphanSplices.erase(orphan);
+                }
+            }
+            return;
+        }
+
+        ConnectionContext* context = it->second;
+        std::lock_guard lock(context->ioMutex);
+
+        if (tag == TAG_RECV) {
+            if (!(flags & IORING_CQE_F_MORE)) {
+                context->recvArmed = false;
+            }
+
+            // Out of provided buffers: re-arm once the ring has been refilled
+            if (result == -ENOBUFS) {
+                if (!context->recvInFlight && context->parkedRecvs.empty()) {
+                    std::lock_guard starvedLock(m_starvedMutex);
+                    m_starved.push_back(id);
+                }
+                return;
+            }
+
+            // Our own cancel of a paused connection's recv; re-arm if it has been asked for meanwhile
+            if (result == -ECANCELED) {
+                if (!context->recvArmed && !context->recvInFlight && context->parkedRecvs.empty()) {
+                    context->recvArmed = armRecv(context);
+                }
+                return;
+            }
+
+            if (context->recvInFlight) {
+                context->parkedRecvs.emplace_back(result, flags);
+                if (context->parkedRecvs.size() == MAX_PARKED_RECVS && context->recvArmed) {
+                    cancel(userData(context->ioId, TAG_RECV));
+                }
+            } else {
+                context->recvInFlight = true;
+                context->recvPosted = false;
+                completions.push_back(makeRecvCompletion(context, result, flags));
+            }
+            return;
+        }
+
+        if (tag == TAG_SEND) {
+            if (result >= 0) {
+                context->sendOffset += static_cast<size_t>(result);
+                advanceSendIov(context, static_cast<size_t>(result));
+
+                // Short write: continue with the remainder
+                if (result > 0 && context->sendOffset < context->sendLength && submitSend(context)) {
+                    return;
+                }
+            }
+
+            const bool headerSent = result >= 0 && context->sendOffset == context->sendLength;
+            if (headerSent && context->sendFileRemaining > 0 && submitSplice(context)) {
+                return;
+            }
+
+            completeSend(context, headerSent && context->sendFileRemaining == 0, completions);
+            return;
+        }
+
+        if (tag == TAG_SPLICE_IN || tag == TAG_SPLICE_OUT) {
+            context->spliceInFlight = false;
+
+            // Zero bytes from the file means it shrank under us
+            if (result <= 0) {
+                printf("splice failed: %d\n", result);
+                completeSend(context, false, completions);
+                return;
+            }
+
+            if (tag == TAG_SPLICE_IN) {
+                context->pipeBytes += static_cast<size_t>(result);
+                context->sendFileOffset += static_cast<uint64_t>(result);
+                context->sendFileRemaining -= static_cast<size_t>(result);
+            } else {
+                context->pipeBytes -= static_cast<size_t>(result);
+                context->sendOffset += static_cast<size_t>(result);
+            }
+
+            if (context->pipeBytes == 0 && context->sendFileRemaining == 0) {
+                completeSend(context, true, completions);
+            } else if (!submitSplice(context)) {
+                completeSend(context, false, completions);
+            }
+        }
+    }
+
+    // Caller holds context->ioMutex
+    static void completeSend(ConnectionContext* context, const bool success, std::vector<IoCompletion>& completions) {
+        context->sendPosted = false;
+        context->sendFile.reset();
+        context->sendFileRemaining = 0;
+
+        IoCompletion completion;
+        completion.context = context;
+        completion.operation = IoOperation::Send;
+        completion.success = success;
+        completion.bytesTransferred = context->sendOffset;
+        completions.push_back(completion);
+    }
+
+    int m_ringFd = -1;                    // io_uring instance
+
+    // Submission queue, guarded by m_submitMutex
+    char* m_sqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_sqEntries = 0;
+    unsigned m_sqLocalTail = 0;
+    unsigned m_unsubmitted = 0;           // SQEs published but not yet passed to io_uring_enter
+    std::mutex m_submitMutex;
+
+    // Completion queue, only touched by the reaping thread
+    char* m_cqRing = nullptr;
+    size_t m_cqRingSize = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    io_uring_cqe* m_cqes = nullptr;
+
+    // Provided receive buffers
+    io_uring_buf_ring* m_bufRing = nullptr;
+    size_t m_bufRingSize = 0;
+    char* m_recvBuffers = nullptr;
+    unsigned short m_bufRingTail = 0;
+    std::mutex m_bufRingMutex;
+    std::vector<uint64_t> m_starved;      // Connections whose recv stopped on ENOBUFS
+    std::mutex m_starvedMutex;
+
+    std::unordered_map<uint64_t, OrphanSend> m_orphanSends; // Cancelled sends, guarded by m_contextsMutex
+    std::unordered_map<uint64_t, OrphanSplice> m_orphanSplices; // Splices of dissociated connections, guarded by m_contextsMutex
+
+    bool m_fixedFiles = false;
+
+    SOCKET m_listenSocket = INVALID_SOCKET;
+    std::atomic<bool> m_acceptEnabled = false;
+
+    // Live connections by id; ids are never reused, so late completions cannot hit a new connection
+    std::unordered_map<uint64_t, ConnectionContext*> m_contexts;
+    uint64_t m_nextId = 1;
+    std::mutex m_contextsMutex;
+
+    // Completions waiting for a worker thread
+    std::deque<IoCompletion> m_readyQueue;
+    std::mutex m_readyMutex;
+    std::condition_variable m_readyCondition;
+    bool m_reaping = false;               // A thread is draining the completion queue
+};
+
+#endif //_WIN32
+
+#endif //URINGREACTOR_H
@@ -1,12 +1,66 @@
 #include <iostream>
 
+#include "ChecksumIndex.h"
+#include "CompressionCache.h"
 #include "ConfigHelper.h"
+#include "CryptHelper.h"
+#include "FileMappings.h"
+#include "ListingCache.h"
+#include "MessageProcessor.h"
+#include "PacketHelper.h"
 #include "ServerConfig.h"
+#include "ServerRunner.h"
 
 int main() {
     ConfigHelper config("server.ini");
     ServerConfig serverConfig(config);
     std::cout << serverConfig.toString() << std::endl;
 
+    CryptHelper serverCrypter;
+    PacketHelper packetHelper(serverCrypter);
+
+    ChecksumIndex checksumIndex(serverConfig.filesDir, serverConfig.indexDir, serverConfig.checksumAlgorithm, serverConfig.chunkSize);
+    checksumIndex.start(serverConfig.eagerIndexing);
+
+    ListingCache listingCache(serverConfig.filesDir, packetHelper);
+    if (serverConfig.listCache)
+        listingCache.start();
+
+    CompressionCache compressionCache(serverConfig.compressionCacheSize);
+    FileMappings fileMappings;
+
+    MessageProcessor messageProcessor(serverConfig, packetHelper, checksumIndex, listingCache, compressionCache, fileMappings);
+
+    ServerRunner serverRunner(serverConfig.serverPort, serverConfig.ioThreads, serverConfig.ioEngine);
+    serverRunner.setSharded(serverConfig.sharded);
+
+    ServerRunner::SendOptions sendOptions;
+    sendOptions.batchBytes = serverConfig.sendBatchBytes;
+    sendOptions.noDelay = serverConfig.tcpNoDelay;
+    sendOptions.cork = serverConfig.tcpCork;
+    serverRunner.setSendOptions(sendOptions);
+
+    ServerRunner::QueueLimits queueLimits;
+    queueLimits.connectionBytes = serverConfig.connectionQueueBytes;
+    queueLimits.totalBytes = serverConfig.totalQueueBytes;
+    serverRunner.setQueueLimits(queueLimits);
+
+    ServerRunner::HandlerOptions handlerOptions;
+    handlerOptions.cpuThreads = serverConfig.cpuThreads;
+    handlerOptions.diskThreads = serverConfig.diskThreads;
+    serverRunner.setHandlerOptions(handlerOptions);
+
+    if (!serverRunner.start(messageProcessor.messageHandler)) {
+        std::cout << "Failed to start server!" << std::endl;
+        return 1;
+    }
+
+    // Run until the operator presses Enter
+    std::cout << "Press Enter to stop the server" << std::endl;
+    std::cin.get();
+
+    serverRunner.stop();
+    checksumIndex.stop();
+    listingCache.stop();
     return 0;
 }